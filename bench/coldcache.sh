@@ -0,0 +1,38 @@
+#!/bin/bash
+# Cold-cache throughput of a '<' input redirection, with and without the
+# shell's fadvise(SEQUENTIAL, WILLNEED) hints (MYSHELL_READAHEAD).
+#
+# The input file is evicted from the page cache before every run with
+# dd iflag=nocache (no root needed), then read once by  wc -c < file.
+#
+# Usage: bench/coldcache.sh [size_mb] [runs]     (default 1024 MB, 3 runs)
+
+SIZE_MB=${1:-1024}
+RUNS=${2:-3}
+SHELL_BIN=${SHELL_BIN:-./myshell}
+FILE=${BENCH_FILE:-./coldcache.bin}
+trap 'rm -f "$FILE"' EXIT
+
+head -c $((SIZE_MB * 1024 * 1024)) /dev/urandom >"$FILE"
+sync "$FILE"
+
+evict() {
+    dd if="$FILE" iflag=nocache count=0 status=none
+}
+
+run() {
+    local best=0 start end mbps
+    for ((r = 0; r < RUNS; r++)); do
+        evict
+        start=$(date +%s%N)
+        echo "wc -c < $FILE" | MYSHELL_READAHEAD=$1 "$SHELL_BIN" >/dev/null
+        end=$(date +%s%N)
+        mbps=$(( SIZE_MB * 1000000000 / (end - start) ))
+        (( mbps > best )) && best=$mbps
+    done
+    echo $best
+}
+
+echo "file: $SIZE_MB MB, best of $RUNS cold runs"
+printf 'readahead=0  %6s MB/s\n' "$(run 0)"
+printf 'readahead=1  %6s MB/s\n' "$(run 1)"
@@ -0,0 +1,36 @@
+#!/bin/bash
+# Parse-plus-execute benchmark for command lists (; && ||)
+#
+# Runs the same script of short conditional chains through myshell and dash
+# and reports wall time per line.  External /bin/true and /bin/false are used
+# on purpose so dash does not get to run them as builtins.
+#
+# Usage: bench/lists.sh [lines]     (default 2000)
+
+LINES=${1:-2000}
+SHELL_BIN=${SHELL_BIN:-./myshell}
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+
+for ((i = 0; i < LINES; i++)); do
+    case $((i % 4)) in
+        0) echo "/bin/true && /bin/true || /bin/false" ;;
+        1) echo "/bin/false || /bin/true && /bin/true" ;;
+        2) echo "/bin/false && /bin/true && /bin/true ; /bin/true" ;;
+        3) echo "/bin/true || /bin/false || /bin/false" ;;
+    esac
+done >"$SCRIPT"
+
+run() {
+    local start end
+    start=$(date +%s%N)
+    "$@" <"$SCRIPT" >/dev/null 2>&1
+    end=$(date +%s%N)
+    echo $(( (end - start) / LINES ))
+}
+
+echo "lines: $LINES"
+printf '%-8s %10s ns/line\n' myshell "$(run "$SHELL_BIN")"
+if command -v dash >/dev/null; then
+    printf '%-8s %10s ns/line\n' dash "$(run dash)"
+fi
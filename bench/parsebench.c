@@ -0,0 +1,340 @@
+/* =============================================================================
+ * bench/parsebench.c  –  Parser microbenchmark and allocation profiler
+ *
+ *   parsebench [FILE]
+ *
+ * Runs parse_line() + free_pipeline() over a built-in corpus of realistic and
+ * adversarial lines (plus every line of FILE, if given) with no process
+ * spawning involved, and reports per case:
+ *
+ *   ns/line     wall time of one parse + free
+ *   ns/token    the same divided by the line's token count (argv words,
+ *               two per redirection, one per '|'; reconstructed from the
+ *               parse result so tokenize() stays private)
+ *   mallocs     allocations per line (malloc, calloc, realloc(NULL), strdup)
+ *   frees       releases per line
+ *   peak_bytes  highest live heap use during one parse, by malloc_usable_size
+ *
+ * Only src/parser.c is linked in, and its allocator calls go through
+ * -Wl,--wrap=malloc,... so the counters see exactly what the parser does.
+ * Each case is repeated for at least BENCH_MIN_MS (default 200) ms.
+ * ============================================================================= */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include "parser.h"
+
+/* === Interposed allocator ================================================= */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void  __real_free(void *p);
+
+static int    counting;
+static long   n_mallocs, n_frees;
+static size_t live_bytes, peak_bytes;
+
+static void note_alloc(void *p)
+{
+    if (!counting || p == NULL) return;
+    n_mallocs++;
+    live_bytes += malloc_usable_size(p);
+    if (live_bytes > peak_bytes) peak_bytes = live_bytes;
+}
+
+static void note_free(void *p)
+{
+    if (!counting || p == NULL) return;
+    n_frees++;
+    live_bytes -= malloc_usable_size(p);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *p = __real_malloc(size);
+    note_alloc(p);
+    return p;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *p = __real_calloc(n, size);
+    note_alloc(p);
+    return p;
+}
+
+void *__wrap_realloc(void *old, size_t size)
+{
+    size_t old_sz = old ? malloc_usable_size(old) : 0;
+    void *p = __real_realloc(old, size);
+    if (!counting || p == NULL) return p;
+    if (old == NULL) {
+        note_alloc(p);
+    } else {
+        /* A resize is neither a new block nor a release; only the size moves */
+        live_bytes += malloc_usable_size(p) - old_sz;
+        if (live_bytes > peak_bytes) peak_bytes = live_bytes;
+    }
+    return p;
+}
+
+void __wrap_free(void *p)
+{
+    note_free(p);
+    __real_free(p);
+}
+
+/* glibc's strdup allocates internally and would bypass the wrapper */
+char *__wrap_strdup(const char *s)
+{
+    size_t n = strlen(s) + 1;
+    char *p = __wrap_malloc(n);
+    if (p != NULL) memcpy(p, s, n);
+    return p;
+}
+
+/* === Corpus ================================================================ */
+
+typedef struct {
+    const char *name;
+    char       *line;
+} Case;
+
+static Case  *cases;
+static int    n_cases, cap_cases;
+
+static void add_case(const char *name, char *line)
+{
+    if (n_cases == cap_cases) {
+        cap_cases = cap_cases ? cap_cases * 2 : 32;
+        cases = realloc(cases, (size_t)cap_cases * sizeof(Case));
+        if (cases == NULL) { perror("realloc"); exit(1); }
+    }
+    cases[n_cases].name = name;
+    cases[n_cases].line = line;
+    n_cases++;
+}
+
+/* Growable string used to generate the adversarial lines */
+typedef struct {
+    char  *s;
+    size_t len, cap;
+} Buf;
+
+static void buf_add(Buf *b, const char *text)
+{
+    size_t n = strlen(text);
+    if (b->len + n + 1 > b->cap) {
+        b->cap = (b->len + n + 1) * 2;
+        b->s = realloc(b->s, b->cap);
+        if (b->s == NULL) { perror("realloc"); exit(1); }
+    }
+    memcpy(b->s + b->len, text, n + 1);
+    b->len += n;
+}
+
+static void build_corpus(void)
+{
+    static const char *realistic[][2] = {
+        { "simple",      "ls -la /tmp" },
+        { "pipe3",       "cat input.txt | grep -v foo | sort -u > out.txt" },
+        { "stderr",      "ls -la /tmp/dir 2> err.log" },
+        { "pipe5",       "sort < data.csv | uniq -c | sort -rn | head -20 > top.txt" },
+        { "dup",         "grep -E pattern file1 file2 file3 >> log.txt 2>&1" },
+        { "opts",        "awk -F, -v OFS=: x y z w < in.csv | cut -d: -f1,2 | tr a-z A-Z" },
+        { "procsub",     "diff <(sort a.txt) <(sort b.txt) > delta.txt" },
+        { "herestring",  "tr a-z A-Z <<< hello 2>/dev/null" },
+    };
+    char tmp[64];
+    Buf b;
+
+    for (size_t i = 0; i < sizeof(realistic) / sizeof(realistic[0]); i++)
+        add_case(realistic[i][0], strdup(realistic[i][1]));
+
+    /* thousands of arguments */
+    memset(&b, 0, sizeof(b));
+    buf_add(&b, "echo");
+    for (int i = 0; i < 5000; i++) {
+        snprintf(tmp, sizeof(tmp), " arg%d", i);
+        buf_add(&b, tmp);
+    }
+    add_case("args5000", b.s);
+
+    /* hundreds of pipes */
+    memset(&b, 0, sizeof(b));
+    buf_add(&b, "cat big.txt");
+    for (int i = 0; i < 300; i++) buf_add(&b, " | cat");
+    add_case("pipes300", b.s);
+
+    /* dense redirections */
+    memset(&b, 0, sizeof(b));
+    buf_add(&b, "cmd");
+    for (int i = 0; i < 500; i++) {
+        snprintf(tmp, sizeof(tmp), " < in%d > out%d 2>> err%d 2>&1", i, i, i);
+        buf_add(&b, tmp);
+    }
+    add_case("redirs2000", b.s);
+
+    /* one long word */
+    memset(&b, 0, sizeof(b));
+    buf_add(&b, "echo ");
+    for (int i = 0; i < 1024; i++) buf_add(&b, "abcdefghijklmnopqrstuvwxyz012345abcdefghijklmnopqrstuvwxyz012345");
+    add_case("word64k", b.s);
+
+    /* many process substitutions */
+    memset(&b, 0, sizeof(b));
+    buf_add(&b, "paste");
+    for (int i = 0; i < 100; i++) {
+        snprintf(tmp, sizeof(tmp), " <(cut -f%d data.tsv | sort)", i + 1);
+        buf_add(&b, tmp);
+    }
+    add_case("procsub100", b.s);
+}
+
+static void load_file(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) { perror(path); exit(1); }
+
+    char *line = NULL;
+    size_t lcap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &lcap, f)) >= 0) {
+        if (len > 0 && line[len - 1] == '\n') line[len - 1] = '\0';
+        add_case(path, strdup(line));
+    }
+    free(line);
+    fclose(f);
+}
+
+/* === Measurement =========================================================== */
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long count_tokens(const Pipeline *p)
+{
+    long n = p->n_cmds - 1;
+    for (int i = 0; i < p->n_cmds; i++) {
+        for (char **a = p->cmds[i].argv; a && *a; a++) n++;
+        n += 2L * p->cmds[i].n_redirs;
+    }
+    return n;
+}
+
+typedef struct {
+    double ns_line;
+    long   tokens;
+    long   mallocs, frees;
+    size_t peak;
+    int    ok;
+} Result;
+
+static Result run_case(const char *line, long long min_ns)
+{
+    Result r;
+    Pipeline pl;
+    char err[256];
+    memset(&r, 0, sizeof(r));
+
+    /* One counted pass for the allocation profile */
+    n_mallocs = n_frees = 0;
+    live_bytes = peak_bytes = 0;
+    counting = 1;
+    r.ok = parse_line(line, &pl, err, sizeof(err)) == 0;
+    if (r.ok) {
+        r.tokens = count_tokens(&pl);
+        free_pipeline(&pl);
+    }
+    counting = 0;
+    r.mallocs = n_mallocs;
+    r.frees = n_frees;
+    r.peak = peak_bytes;
+
+    /* Timed passes */
+    long long iters = 0, t0 = now_ns(), elapsed;
+    do {
+        for (int i = 0; i < 16; i++) {
+            if (parse_line(line, &pl, err, sizeof(err)) == 0) free_pipeline(&pl);
+        }
+        iters += 16;
+        elapsed = now_ns() - t0;
+    } while (elapsed < min_ns);
+
+    r.ns_line = (double)elapsed / (double)iters;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 2) {
+        fprintf(stderr, "usage: parsebench [FILE]\n");
+        return 2;
+    }
+
+    const char *ms = getenv("BENCH_MIN_MS");
+    long long min_ns = (ms ? atoll(ms) : 200) * 1000000LL;
+
+    build_corpus();
+    int n_builtin = n_cases;
+    if (argc == 2) load_file(argv[1]);
+
+    printf("%-12s %10s %10s %10s %8s %8s %11s\n",
+           "case", "ns/line", "tokens", "ns/token", "mallocs", "frees", "peak_bytes");
+
+    /* Lines from FILE are aggregated into a single row */
+    double f_ns = 0;
+    long f_tok = 0, f_mal = 0, f_fre = 0, f_lines = 0;
+    size_t f_peak = 0;
+    long long f_min = n_cases > n_builtin ? min_ns / (n_cases - n_builtin) + 1 : 0;
+
+    for (int i = 0; i < n_cases; i++) {
+        Result r = run_case(cases[i].line, i < n_builtin ? min_ns : f_min);
+        if (i >= n_builtin) {
+            if (!r.ok) continue;
+            f_ns += r.ns_line;
+            f_tok += r.tokens;
+            f_mal += r.mallocs;
+            f_fre += r.frees;
+            if (r.peak > f_peak) f_peak = r.peak;
+            f_lines++;
+            continue;
+        }
+        if (!r.ok) {
+            printf("%-12s  (parse error)\n", cases[i].name);
+            continue;
+        }
+        printf("%-12s %10.0f %10ld %10.2f %8ld %8ld %11zu\n",
+               cases[i].name, r.ns_line, r.tokens,
+               r.tokens ? r.ns_line / (double)r.tokens : 0.0,
+               r.mallocs, r.frees, r.peak);
+        if (r.mallocs != r.frees)
+            fprintf(stderr, "parsebench: %s: %ld allocations not freed\n",
+                    cases[i].name, r.mallocs - r.frees);
+    }
+
+    if (f_lines > 0) {
+        printf("%-12s %10.0f %10.1f %10.2f %8.1f %8.1f %11zu   (mean of %ld lines, max peak)\n",
+               "file", f_ns / (double)f_lines, (double)f_tok / (double)f_lines,
+               f_tok ? f_ns / (double)f_tok : 0.0,
+               (double)f_mal / (double)f_lines, (double)f_fre / (double)f_lines,
+               f_peak, f_lines);
+        if (f_mal != f_fre)
+            fprintf(stderr, "parsebench: %s: %ld allocations not freed\n",
+                    argv[1], f_mal - f_fre);
+    }
+
+    for (int i = 0; i < n_cases; i++) free(cases[i].line);
+    free(cases);
+    return 0;
+}
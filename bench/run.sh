@@ -0,0 +1,140 @@
+#!/bin/bash
+# myshell benchmark suite (make bench)
+#
+# Measures, for myshell and for dash / bash on the same machine:
+#   spawn_latency      p50/p99 of one command cycle, from consecutive
+#                      bench/stamp timestamps in a script of stamp lines
+#   pipeline_gbps      GB/s through 2, 4 and 16 'cat' stages fed by
+#                      head -c N /dev/zero
+#   parse_lines_per_s  whole-process parse rate over a corpus in '-n'
+#                      parse-only mode (null for myshell, which has none)
+#   batch_cmds_per_s   commands per second for a script of /bin/true lines
+# plus, measured in-process and so not comparable with the table:
+# myshell's execute_pipeline() latency for "true" and its parse_list() rate
+# over the same corpus.
+#
+# External /bin/true is used everywhere so dash and bash cannot fall back to
+# builtins.  Output is one JSON document on stdout.
+#
+# Knobs: BENCH_SPAWNS (2000)  BENCH_MB (512)  BENCH_LINES (20000)
+#        BENCH_SHELLS ("myshell dash bash")
+
+set -e
+cd "$(dirname "$0")/.."
+
+SPAWNS=${BENCH_SPAWNS:-2000}
+MB=${BENCH_MB:-512}
+LINES=${BENCH_LINES:-20000}
+SHELLS=${BENCH_SHELLS:-"myshell dash bash"}
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+STAMP=$PWD/bench/stamp
+INPROC=$PWD/bench/inproc
+
+now_ns() { date +%s%N; }
+
+shell_cmd() {
+    case $1 in
+        myshell) echo "$PWD/myshell" ;;
+        *)       command -v "$1" ;;
+    esac
+}
+
+# ---- inputs -----------------------------------------------------------------
+
+for ((i = 0; i <= SPAWNS; i++)); do echo "$STAMP"; done >"$TMP/stamps.sh"
+for ((i = 0; i < SPAWNS; i++)); do echo "/bin/true"; done >"$TMP/batch.sh"
+
+for st in 2 4 16; do
+    line="head -c $((MB * 1024 * 1024)) /dev/zero"
+    for ((i = 0; i < st; i++)); do line="$line | cat"; done
+    echo "$line > /dev/null" >"$TMP/pipe$st.sh"
+done
+
+for ((i = 0; i < LINES; i++)); do
+    case $((i % 6)) in
+        0) echo "cat input.txt | grep -v foo | sort -u > out.txt" ;;
+        1) echo "ls -la /tmp/dir$i 2> err.log" ;;
+        2) echo "/bin/true && /bin/echo ok || /bin/false" ;;
+        3) echo "sort < data$i.csv | uniq -c | sort -rn | head -20 > top.txt" ;;
+        4) echo "grep -E pattern file1 file2 file3 >> log.txt 2>&1 ; echo done" ;;
+        5) echo "awk -F, -v OFS=: x y z w < in.csv | cut -d: -f1,2 | tr a-z A-Z" ;;
+    esac
+done >"$TMP/corpus.sh"
+
+# ---- measurements -----------------------------------------------------------
+
+spawn_latency() {   # prints "p50_us p99_us"
+    "$1" <"$TMP/stamps.sh" 2>/dev/null | sed 's/[^0-9]//g' | grep . |
+        awk 'NR > 1 { print $1 - prev } { prev = $1 }' | sort -n |
+        awk '{ d[NR] = $1 } END { printf "%.1f %.1f\n", d[int(NR * 0.50) + 1] / 1000, d[int(NR * 0.99) + 1] / 1000 }'
+}
+
+pipeline_gbps() {
+    local t0 t1
+    t0=$(now_ns)
+    "$1" <"$TMP/pipe$2.sh" >/dev/null 2>&1
+    t1=$(now_ns)
+    awk -v b=$((MB * 1024 * 1024)) -v ns=$((t1 - t0)) 'BEGIN { printf "%.3f\n", b / ns }'
+}
+
+parse_rate() {
+    local t0 t1
+    if [ "$2" = myshell ]; then
+        echo null
+        return
+    fi
+    t0=$(now_ns)
+    "$1" -n "$TMP/corpus.sh"
+    t1=$(now_ns)
+    awk -v n="$LINES" -v ns=$((t1 - t0)) 'BEGIN { printf "%.0f\n", n * 1e9 / ns }'
+}
+
+batch_rate() {
+    local t0 t1
+    t0=$(now_ns)
+    "$1" <"$TMP/batch.sh" >/dev/null 2>&1
+    t1=$(now_ns)
+    awk -v n="$SPAWNS" -v ns=$((t1 - t0)) 'BEGIN { printf "%.0f\n", n * 1e9 / ns }'
+}
+
+# ---- report -----------------------------------------------------------------
+
+printf '{\n'
+printf '  "machine": { "kernel": "%s", "cpus": %s, "date": "%s" },\n' \
+    "$(uname -r)" "$(nproc)" "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+printf '  "params": { "spawns": %s, "pipeline_mb": %s, "corpus_lines": %s },\n' \
+    "$SPAWNS" "$MB" "$LINES"
+
+read -r p50 p99 mean <<<"$("$INPROC" spawn "$SPAWNS")"
+printf '  "myshell_execute_pipeline_us": { "p50": %.1f, "p99": %.1f, "mean": %.1f },\n' \
+    "$(awk -v v="$p50" 'BEGIN { print v / 1000 }')" \
+    "$(awk -v v="$p99" 'BEGIN { print v / 1000 }')" \
+    "$(awk -v v="$mean" 'BEGIN { print v / 1000 }')"
+printf '  "myshell_parse_list_lines_per_s": %s,\n' "$("$INPROC" parse "$TMP/corpus.sh")"
+
+printf '  "shells": {\n'
+first=1
+for sh in $SHELLS; do
+    bin=$(shell_cmd "$sh") || continue
+    [ -x "$bin" ] || continue
+
+    read -r s50 s99 <<<"$(spawn_latency "$bin")"
+    g2=$(pipeline_gbps "$bin" 2)
+    g4=$(pipeline_gbps "$bin" 4)
+    g16=$(pipeline_gbps "$bin" 16)
+    pr=$(parse_rate "$bin" "$sh")
+    br=$(batch_rate "$bin")
+
+    [ $first -eq 1 ] || printf ',\n'
+    first=0
+    printf '    "%s": {\n' "$sh"
+    printf '      "spawn_latency_us": { "p50": %s, "p99": %s },\n' "$s50" "$s99"
+    printf '      "pipeline_gbps": { "2": %s, "4": %s, "16": %s },\n' "$g2" "$g4" "$g16"
+    printf '      "parse_lines_per_s": %s,\n' "$pr"
+    printf '      "batch_cmds_per_s": %s\n' "$br"
+    printf '    }'
+done
+printf '\n  }\n}\n'
@@ -0,0 +1,20 @@
+/* =============================================================================
+ * bench/stamp.c  –  Print CLOCK_MONOTONIC in nanoseconds
+ *
+ * Run once per line of a script, the difference between consecutive stamps
+ * is one full command cycle of the shell running the script (read, parse,
+ * fork, exec, wait), measured the same way for myshell, dash and bash.
+ * ============================================================================= */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+
+int main(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    printf("%lld\n", (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+    return 0;
+}
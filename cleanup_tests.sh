@@ -3,14 +3,27 @@
 
 echo "Cleaning up test files..."
 
+# Stop the FIFO reader if run_tests.txt left it waiting
+if [ -f fifo_reader.pid ]; then
+    kill "$(cat fifo_reader.pid)" 2>/dev/null
+fi
+
 # Remove test output files
 rm -f filtered.txt sorted_output.txt top3.txt
 rm -f out1.txt out2.txt out3.txt out4.txt out5.txt
 rm -f err1.log err2.log err3.log err4.log error_output.txt
 rm -f result.txt sorted.txt test_out.txt final_output.txt
+rm -f copy_out.txt fifo_head.txt memo_out.txt
+rm -f pmap_out.txt pmap_small.txt
+rm -f qsub_out.txt
+rm -f dag_sorted.txt dag_count.txt dag_broken.txt dag_after.txt
 
 # Remove test input files
 rm -f input.txt
 rm -f numbers.txt
+rm -f big.txt test.fifo fifo_reader.pid
+rm -f memo_in.txt
+rm -f test_ok.dag test_fail.dag
+rm -rf test_store
 
 echo "Cleanup complete!"
@@ -0,0 +1,29 @@
+#ifndef BLAKE2B_H
+#define BLAKE2B_H
+
+#include <stddef.h>     // size_t
+#include <stdint.h>     // uint64_t
+
+// BLAKE2b (RFC 7693), unkeyed, streaming.  Names memo's content-addressed
+// blobs and cache keys, where a collision would restore the wrong output.
+#define BLAKE2B_OUT_MAX 64
+
+typedef struct {
+    uint64_t      h[8];         // chained state
+    uint64_t      t[2];         // bytes compressed so far (128-bit counter)
+    unsigned char b[128];       // input block being filled
+    size_t        c;            // bytes in b
+    size_t        outlen;       // digest length in bytes
+} Blake2b;
+
+// Starts a digest of outlen bytes (1..BLAKE2B_OUT_MAX).
+void blake2b_init(Blake2b *s, size_t outlen);
+
+
+void blake2b_update(Blake2b *s, const void *data, size_t n);
+
+
+// Writes the outlen-byte digest to out; s must be re-initialised to reuse it.
+void blake2b_final(Blake2b *s, unsigned char *out);
+
+#endif /* BLAKE2B_H */
@@ -0,0 +1,18 @@
+#ifndef BUILTIN_H
+#define BUILTIN_H
+
+#include "parser.h"
+
+// A builtin command: argv as parsed, returns the exit status.
+typedef int (*BuiltinFn)(char **argv);
+
+// Returns the builtin called name, or NULL if name is not a builtin.
+BuiltinFn find_builtin(const char *name);
+
+
+// Runs p in the shell process if it is a single builtin command (with its
+// redirections applied around the call and undone afterwards).
+// Returns 1 with *status set if it ran, 0 if p is not a lone builtin.
+int try_builtin(const Pipeline *p, int *status);
+
+#endif /* BUILTIN_H */
@@ -0,0 +1,12 @@
+#ifndef DAG_H
+#define DAG_H
+
+// 'dag [-j N] SPECFILE': run pipelines with declared dependencies, ready
+// ones in parallel, skipping those whose outputs are up to date.
+// Spec format and rules: see src/dag.c.
+
+#define DAG_MAX_LINE 8192       // longest spec line
+
+int dag_builtin(char **argv);
+
+#endif /* DAG_H */
@@ -1,12 +1,55 @@
 #ifndef EXEC_H
 #define EXEC_H
 
+#include <sys/types.h>  // pid_t
+
 #include "parser.h"
+#include "perfstat.h"   // PerfCounters
+#include "monitor.h"    // PipeMonitor
+#include "ioacct.h"     // IoAcct
+
+// A started pipeline: one child per command, plus the jobs running its
+// process substitutions.  Filled by start_pipeline(), released by wait_job().
+typedef struct Job {
+    pid_t      *pids;   // child PIDs in command order
+    int        *slots;  // stats_slot() of each child (-1 if none)
+    int         n_pids;
+    PerfCounters *perf; // per-child counters with MYSHELL_PERF=1 (NULL otherwise)
+    IoAcct     *io;     // per-child /proc/<pid>/io with MYSHELL_IOACCT=1 (NULL otherwise)
+    PipeMonitor *mon;   // pipe fill sampler with MYSHELL_MONITOR set (NULL otherwise)
+    struct Job *subs;   // inner jobs of <(...) / >(...) arguments
+    int         n_subs;
+} Job;
 
 int execute_pipeline(const Pipeline *p);
 
 
-int apply_redirections(const Command *cmd);
+int start_pipeline(const Pipeline *p, int in_fd, int out_fd, Job *job);
+
+
+int wait_job(Job *job);
+
+
+int execute_list(const CommandList *l);
+
+
+// Forks a runner that _exit()s with run(ctx), optionally leading its own
+// process group; *pidfd is -1 without pidfd_open().  -1 if fork() failed.
+pid_t fork_runner(int (*run)(void *ctx), void *ctx, int own_pgrp, int *pidfd, const char *who);
+
+
+int try_copy_fastpath(const Pipeline *p, int *status);
+
+
+struct stat;
+int copy_fd(int in, int out, const struct stat *in_st, const struct stat *out_st,
+            int append, int *read_failed);
+
+
+int apply_redirections(const Command *cmd, int readahead);
+
+
+int release_output_cache(const Command *cmd);
 
 
 int create_pipes(int n_pipes, int (*pipe_fds)[2]);
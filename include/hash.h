@@ -0,0 +1,14 @@
+#ifndef HASH_H
+#define HASH_H
+
+// FNV-1a of a string, inlined wherever a table is keyed by one: PATH cache
+// slots, the server's parsed-command templates, the parser's index of
+// output files.
+static inline unsigned long hash_name(const char *s)
+{
+    unsigned long h = 2166136261UL;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619UL;
+    return h;
+}
+
+#endif /* HASH_H */
@@ -0,0 +1,24 @@
+#ifndef IOACCT_H
+#define IOACCT_H
+
+#include <sys/types.h>  // pid_t
+
+// I/O accounting of one pipeline stage from /proc/<pid>/io (MYSHELL_IOACCT=1).
+typedef struct {
+    const char        *name;        // argv[0] of the stage
+    int                valid;       // 0 if /proc/<pid>/io could not be read
+    unsigned long long rchar;       // bytes passed to read()-like syscalls
+    unsigned long long wchar;       // bytes passed to write()-like syscalls
+    unsigned long long read_bytes;  // bytes actually fetched from storage
+    unsigned long long write_bytes; // bytes actually sent to storage
+} IoAcct;
+
+// Reads /proc/<pid>/io into io.  pid must be exited but not yet reaped
+// (waitid(WNOWAIT)) so the numbers are final.  Returns 0 or -1.
+int ioacct_read(pid_t pid, IoAcct *io);
+
+
+// Prints one line per stage of n stages and a pipeline total to stderr.
+void ioacct_report(const IoAcct *io, int n);
+
+#endif /* IOACCT_H */
@@ -0,0 +1,25 @@
+#ifndef IOENG_H
+#define IOENG_H
+
+#include <stddef.h> // size_t
+
+// Engine used to move data that the shell itself relays between fds.
+typedef enum {
+    IO_ENGINE_AUTO,     // io_uring when available, else poll
+    IO_ENGINE_URING,    // io_uring: registered buffers, linked read→write SQEs
+    IO_ENGINE_POLL      // poll() + read()/write() loop (works everywhere)
+} IoEngine;
+
+#define IO_BLOCK_SIZE (128 * 1024)  // default bytes per read/write
+
+// Copies from in_fd to out_fd until EOF, or len bytes if len >= 0.
+// Returns the number of bytes moved, or -1 with errno set.
+long long io_relay(int in_fd, int out_fd, long long len);
+
+
+// Same with an explicit engine and block size; on failure *read_failed
+// (may be NULL) is 1 if reading in_fd failed, 0 if writing out_fd did.
+long long io_relay_ex(int in_fd, int out_fd, long long len,
+                      IoEngine engine, size_t block_size, int *read_failed);
+
+#endif /* IOENG_H */
@@ -0,0 +1,24 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include "parser.h"
+
+// 'memo PIPELINE': reuse the stored result of an earlier identical run.
+// Store layout, key and eviction: see src/memo.c.
+
+// Eviction order once the store exceeds MYSHELL_MEMO_MAX_MB
+#define MEMO_EVICT_LRU  0       // least recently used entry first (default)
+#define MEMO_EVICT_FIFO 1       // oldest entry first
+
+// Environment variables that are part of the key unless MYSHELL_MEMO_ENV says otherwise
+#define MEMO_DEFAULT_ENV "PATH LANG LC_ALL LC_COLLATE LC_CTYPE LC_NUMERIC TZ"
+
+// Returns 1 if p starts with the 'memo' prefix.
+int memo_prefixed(const Pipeline *p);
+
+
+// Runs p without its prefix, restoring stdout and the '>' files from the
+// store instead when the key matches.  Returns the exit status.
+int memo_execute(const Pipeline *p);
+
+#endif /* MEMO_H */
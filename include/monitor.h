@@ -0,0 +1,22 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <sys/types.h>  // pid_t
+
+#include "parser.h"
+
+// Pipe fill-level sampler of one running pipeline (MYSHELL_MONITOR=ms).
+typedef struct PipeMonitor PipeMonitor;
+
+// Starts watching the n_pipes pipes of p (its children are pids); the
+// caller may close its own pipe ends afterwards.  Returns NULL if the
+// monitor cannot run here (nothing is held open in that case).
+PipeMonitor *monitor_start(const Pipeline *p, const pid_t *pids,
+                           int (*pipe_fds)[2], int n_pipes, int period_ms);
+
+
+// Samples until every stage has exited, prints the saturation summary and
+// bottleneck verdict to stderr, and frees m.  Children are left for waitpid().
+void monitor_run(PipeMonitor *m);
+
+#endif /* MONITOR_H */
@@ -0,0 +1,154 @@
+#ifndef MYSHELL_H
+#define MYSHELL_H
+
+// libmyshell – parse and run myshell pipelines from C without /bin/sh -c.
+//
+// Link with -lmyshell (libmyshell.a or libmyshell.so).  The API is
+// reentrant and thread-safe: there is no global state, every object is
+// owned by the caller, and nothing on a library path calls exit().
+//
+//   msh_pipeline *pl;
+//   msh_proc *pr;
+//   char err[128];
+//   int status;
+//
+//   if (msh_parse("sort -u | head -5 > top.txt", NULL, &pl, err, sizeof(err)) != 0) ...
+//   if (msh_spawn(pl, MSH_PIPE_STDIN, &pr) != 0) ...
+//   write(msh_stdin_fd(pr), data, len);
+//   msh_close_stdin(pr);
+//   msh_wait(pr, &status);
+//   msh_proc_free(pr);
+//   msh_pipeline_free(pl);
+
+#include <stddef.h>     // size_t
+#include <sys/types.h>  // pid_t
+
+// The library is built with -fvisibility=hidden: only what is declared
+// here is exported, not the parser and pipe internals it is made of.
+#pragma GCC visibility push(default)
+
+// Memory for parsed pipelines and process handles.  NULL means malloc/free.
+typedef struct {
+    void *(*alloc)(void *ctx, size_t size);
+    void  (*free)(void *ctx, void *ptr);
+    void  *ctx;
+} msh_allocator;
+
+typedef struct msh_pipeline msh_pipeline;   // a parsed pipeline (immutable)
+typedef struct msh_proc     msh_proc;       // a started pipeline
+
+// msh_spawn() flags
+#define MSH_PIPE_STDIN   0x1    // first stage reads from msh_stdin_fd()
+#define MSH_PIPE_STDOUT  0x2    // last stage writes to msh_stdout_fd()
+#define MSH_PIPE_STDERR  0x4    // every stage's stderr goes to msh_stderr_fd()
+#define MSH_READAHEAD    0x8    // fadvise(SEQUENTIAL, WILLNEED) on '<' files
+
+// Parses one pipeline (cmd | cmd ... with redirections).  Lines after the
+// first are here-document bodies for its '<<' redirections.  The result is
+// one block from alloc (which must outlive it).  Returns 0, or -1 with a
+// message in err (and *out NULL).  Process substitution is not supported.
+int msh_parse(const char *text, const msh_allocator *alloc, msh_pipeline **out,
+              char *err, size_t err_sz);
+
+
+void msh_pipeline_free(msh_pipeline *pl);
+
+
+// Number of commands in pl.
+int msh_pipeline_stages(const msh_pipeline *pl);
+
+
+// Starts pl without waiting.  Children get default SIGPIPE handling and an
+// empty signal mask; descriptors of the caller are never inherited except
+// 0, 1, 2 (all library fds are O_CLOEXEC).  Returns 0, or -1 with errno set
+// (no children left running).  The handle uses pl's allocator.
+int msh_spawn(const msh_pipeline *pl, int flags, msh_proc **out);
+
+
+// Parent ends of the MSH_PIPE_* pipes (-1 if not requested or closed).
+// They are O_CLOEXEC and blocking; set O_NONBLOCK for an event loop.
+int msh_stdin_fd(const msh_proc *pr);
+int msh_stdout_fd(const msh_proc *pr);
+int msh_stderr_fd(const msh_proc *pr);
+
+
+// Closes the stdin pipe so the first stage sees EOF.
+void msh_close_stdin(msh_proc *pr);
+
+
+int   msh_stages(const msh_proc *pr);
+pid_t msh_pid(const msh_proc *pr, int stage);
+
+
+// pidfd of a stage (-1 if pidfd_open() is unavailable).  It polls readable
+// once the stage has exited; add it to epoll, then call msh_poll().
+int msh_pidfd(const msh_proc *pr, int stage);
+
+
+// Waits for every stage.  *status is the last stage's exit code, or 128 + signal
+// number if it was killed.  Returns 0, or -1 with errno set.
+int msh_wait(msh_proc *pr, int *status);
+
+
+// Reaps stages that have exited without blocking.  Returns 1 with *status
+// set (as msh_wait()) once every stage has exited, 0 while some still run,
+// -1 on error.
+int msh_poll(msh_proc *pr, int *status);
+
+
+// ---- Output capture (non-blocking) -------------------------------------
+//
+// After msh_spawn(pl, MSH_PIPE_STDOUT | MSH_PIPE_STDERR, &pr):
+//
+//   msh_capture(pr, MSH_STDOUT, buf, sizeof(buf), NULL, NULL);
+//   epoll_ctl(ep, EPOLL_CTL_ADD, msh_stdout_fd(pr), ...);   // + msh_pidfd()
+//   ... on EPOLLIN / EPOLLHUP:  msh_pump(pr, MSH_STDOUT);
+//   ... once both streams are at EOF and the pidfds fire:  msh_poll(pr, &status);
+//   epoll_ctl(ep, EPOLL_CTL_DEL, ...) for each fd, then msh_proc_free(pr);
+//
+// or simply msh_collect(pr, &status) to block until everything is in.
+
+#define MSH_STDOUT 1
+#define MSH_STDERR 2
+
+// Called with every chunk read into the capture buffer (callback mode).
+typedef void (*msh_output_fn)(void *ctx, int stream, const char *data, size_t len);
+
+// Collects stream (MSH_STDOUT / MSH_STDERR; its MSH_PIPE_* flag must have
+// been given) and makes its pipe O_NONBLOCK.  Without fn, output fills
+// buf[0..cap) and whatever does not fit is spliced into a memfd (buf may be
+// NULL with cap 0 to send everything there).  With fn, buf is a staging
+// area and fn gets each chunk; nothing is spilled.  Returns 0 or -1 (errno).
+int msh_capture(msh_proc *pr, int stream, char *buf, size_t cap,
+                msh_output_fn fn, void *ctx);
+
+
+// Drains what is readable on stream without blocking.  Returns 1 at end of
+// stream (then remove the fd from the event loop), 0 if more may come, -1
+// on error.
+int msh_pump(msh_proc *pr, int stream);
+
+
+typedef struct {
+    size_t buffered;            // bytes in the caller's buffer
+    unsigned long long total;   // bytes read so far, buffered + spilled (+ callbacks)
+    int    spill_fd;            // memfd with the overflow (-1 if none); at
+                                // offset 0 once eof, owned by the handle
+    int    eof;
+} msh_output_info;
+
+int msh_output(const msh_proc *pr, int stream, msh_output_info *info);
+
+
+// Blocks until every captured stream is at EOF, then msh_wait()s.
+int msh_collect(msh_proc *pr, int *status);
+
+
+// Closes the handle's descriptors (pipes, pidfds, spill memfds) and frees
+// it; take them out of any epoll set first.  Stages still running are left
+// running and unreaped; wait first.
+void msh_proc_free(msh_proc *pr);
+
+#pragma GCC visibility pop
+
+#endif /* MYSHELL_H */
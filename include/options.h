@@ -0,0 +1,43 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stddef.h>     // size_t
+
+// Shell-wide behaviour switches, read once from the environment at startup.
+typedef struct {
+    int readahead;      // MYSHELL_READAHEAD: fadvise(SEQUENTIAL, WILLNEED) on '<' files (default 1)
+    int dontneed;       // MYSHELL_DONTNEED:  drop '>' / '>>' files from the page cache when done (default 0)
+    int io_engine;      // MYSHELL_IOENGINE: "uring" | "poll" for in-shell relays (default auto, see ioeng.h)
+    int copy_fastpath;  // MYSHELL_COPY_FASTPATH: run 'cat < a > b' in-process in the kernel (default 1)
+    const char *trace_path; // MYSHELL_TRACE: write a Chrome trace-event JSON timeline here (default off)
+    int perf;           // MYSHELL_PERF: perf_event_open() counters per pipeline stage on stderr (default 0)
+    int ioacct;         // MYSHELL_IOACCT: /proc/<pid>/io bytes per pipeline stage on stderr (default 0)
+    int profile;        // -p / MYSHELL_PROFILE=1|folded: per-line profile at exit (PROFILE_*, default off)
+    int path_cache;     // MYSHELL_PATHCACHE: remember where commands were found in PATH (default 1)
+    const char *path_cache_file; // MYSHELL_PATHCACHE_FILE: share those lookups through this mmap()ed file (default off)
+    const char *memo_dir; // MYSHELL_MEMO_DIR: store of 'memo' results (default $XDG_CACHE_HOME/myshell/memo, ~/.cache/...)
+    int memo_max_mb;    // MYSHELL_MEMO_MAX_MB: evict 'memo' entries above this size (default 1024)
+    int memo_evict;     // MYSHELL_MEMO_EVICT: "lru" | "fifo" eviction order (MEMO_EVICT_*, default lru)
+    const char *memo_env; // MYSHELL_MEMO_ENV: variables that are part of a 'memo' key (default MEMO_DEFAULT_ENV)
+    const char *queue_dir; // MYSHELL_QUEUE_DIR: 'qsub' spool (default $XDG_STATE_HOME/myshell/queue, ~/.local/state/...)
+    int queue_max;      // MYSHELL_QUEUE_MAX: queued jobs running at once (default 0 = online CPUs)
+    const char *queue_limits; // MYSHELL_QUEUE_LIMITS: per-queue limits, "name=K,name=K" (default none)
+    int monitor_ms;     // MYSHELL_MONITOR: sample pipe fill levels every N ms, report the bottleneck (default 0 = off)
+} ShellOptions;
+
+extern ShellOptions shell_opts;
+
+
+void options_init(void);
+
+
+// mkdir -p with mode 0700 (path is modified while it runs).
+int mkdir_p(char *path);
+
+
+// dir if set, else $xdg_var/myshell/name, else $HOME/home_dir/myshell/name
+// into buf (not created).  Returns -1 if none is set or it does not fit.
+int options_user_dir(char *buf, size_t sz, const char *dir, const char *xdg_var,
+                     const char *home_dir, const char *name);
+
+#endif /* OPTIONS_H */
@@ -3,19 +3,79 @@
 
 #include <stddef.h> // size_t
 
-// One command segment in a pipeline: e.g.,  grep hello 2> err.log
+// Kind of one redirection action; actions run in command-line order.
+typedef enum {
+    REDIR_IN,           // n<  file : open O_RDONLY onto fd
+    REDIR_OUT,          // n>  file : open O_WRONLY|O_CREAT|O_TRUNC onto fd
+    REDIR_APPEND,       // n>> file : open O_WRONLY|O_CREAT|O_APPEND onto fd
+    REDIR_DUP,          // n>&m     : dup2(m, fd)
+    REDIR_CLOSE,        // n>&-     : close(fd)
+    REDIR_HEREDOC       // n<< DELIM / n<<< word : body onto fd (memfd or pipe)
+} RedirKind;
+
+// One redirection action: e.g.  2> err.log  is { REDIR_OUT, 2, -1, "err.log" }
+typedef struct {
+    RedirKind kind;
+    int       fd;       // target descriptor (0 for '<', 1 for '>', 2 for '2>')
+    int       src_fd;   // REDIR_DUP: descriptor duplicated onto fd (-1 otherwise)
+    char     *path;     // REDIR_IN/OUT/APPEND: file name, REDIR_HEREDOC: delimiter
+    char     *body;     // REDIR_HEREDOC: text fed to fd (NULL until read_heredocs())
+    size_t    body_len; // REDIR_HEREDOC: length of body in bytes
+    int       strip_tabs; // REDIR_HEREDOC from '<<-': leading tabs are removed
+    int       body_fd;  // REDIR_HEREDOC: sealed memfd holding a body over
+                        // HEREDOC_PIPE_MAX, staged by read_heredocs() (-1: none)
+} Redir;
+
+// Here-document bodies up to this size go through a pipe in each command;
+// larger ones are copied once into a sealed memfd that every command reopens.
+#define HEREDOC_PIPE_MAX 65536
+
+typedef struct Pipeline Pipeline;
+
+// Process substitution argument: <(inner) or >(inner)
+// At run time argv[argi] is replaced by /dev/fd/N, the command's end of a
+// pipe connected to the inner pipeline's stdout (<) or stdin (>).
+typedef struct {
+    int       argi;     // index of the substituted word in argv
+    int       is_output; // 1 for '>(...)', 0 for '<(...)'
+    Pipeline *inner;    // the parsed inner pipeline
+} ProcSub;
+
+// One command segment in a pipeline: e.g.,  grep hello > out.log 2>&1
 typedef struct {
-    char **argv;        // NULL-terminated, suitable for execvp()
-    char  *in_file;     // for '<'  (NULL if none)
-    char  *out_file;    // for '>'  (NULL if none)
-    char  *err_file;    // for '2>' (NULL if none)
+    char    **argv;     // NULL-terminated, suitable for execvp()
+    Redir    *redirs;   // redirection actions in order (NULL if none)
+    int       n_redirs; // the number of redirection actions
+    ProcSub  *psubs;    // process substitutions among argv (NULL if none)
+    int       n_psubs;  // the number of process substitutions
 } Command;
 
 // Full pipeline: cmd0 | cmd1 | cmd2 ...
-typedef struct {
+struct Pipeline {
     Command *cmds;      // a pointer to a dynamically allocated array of Command structs
     int      n_cmds;    // the number of commands in the pipeline
-} Pipeline;
+};
+
+// Operator that joins a pipeline to the one before it in a command list.
+typedef enum {
+    LIST_SEQ,           // ';'  always run (also used for the first entry)
+    LIST_AND,           // '&&' run only if the previous status was 0
+    LIST_OR             // '||' run only if the previous status was non-zero
+} ListOp;
+
+// One entry of a command list: the operator in front of it plus its pipeline.
+typedef struct {
+    ListOp   op;
+    Pipeline pl;
+} ListNode;
+
+// Full command line: pl0 ; pl1 && pl2 || pl3 ...
+// '&&' and '||' have equal precedence and associate left, so the flat node
+// array is the whole tree; execute_list() walks it once without re-parsing.
+typedef struct {
+    ListNode *nodes;    // a pointer to a dynamically allocated array of ListNode structs
+    int       n_nodes;  // the number of pipelines in the list
+} CommandList;
 
 
 int parse_line(const char *line, Pipeline *out, char *err, size_t err_sz);
@@ -23,4 +83,29 @@ int parse_line(const char *line, Pipeline *out, char *err, size_t err_sz);
 
 void free_pipeline(Pipeline *p);
 
+
+// Returns the next input line without its newline, or NULL at end of input.
+// The returned buffer only has to stay valid until the next call.
+typedef const char *(*LineReader)(void *ctx);
+
+int read_heredocs(Pipeline *p, LineReader next_line, void *ctx,
+                  char *err, size_t err_sz);
+
+// LineReader over the lines of an in-memory text (a command line sent as one
+// string, then its here-document lines).  Start with { first, NULL, 0 } and
+// free buf when done.
+typedef struct {
+    const char *next;   // start of the next line (NULL at the end)
+    char       *buf;    // the line last returned
+    size_t      cap;
+} TextLines;
+
+const char *text_next_line(void *ctx);
+
+
+int parse_list(const char *line, CommandList *out, char *err, size_t err_sz);
+
+
+void free_list(CommandList *l);
+
 #endif
\ No newline at end of file
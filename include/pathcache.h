@@ -0,0 +1,27 @@
+#ifndef PATHCACHE_H
+#define PATHCACHE_H
+
+// Remembered PATH lookups (like the 'hash' of other shells), so a command
+// run again is exec'd by its full path without searching PATH.  Filled in
+// the shell process before fork(); children inherit it.  A changed PATH
+// empties it.  With pathcache_open() a table shared by all shells through
+// an mmap()ed file backs it.
+
+// Returns the full path of command name found through PATH, or NULL when it
+// contains a '/', is not found, or was found in a relative PATH entry (the
+// caller then falls back to execvp()).  Valid until the next lookup.
+const char *pathcache_lookup(const char *name);
+
+
+void pathcache_clear(void);
+
+
+// Maps the shared table in file (created if missing).  Errors leave the
+// shell with the process table only.
+void pathcache_open(const char *file);
+
+
+// 'hash' builtin: list the remembered commands, or 'hash -r' to forget them.
+int pathcache_builtin(char **argv);
+
+#endif /* PATHCACHE_H */
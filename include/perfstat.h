@@ -0,0 +1,23 @@
+#ifndef PERFSTAT_H
+#define PERFSTAT_H
+
+#include <sys/types.h>  // pid_t
+
+// perf_event_open() counters of one pipeline stage (MYSHELL_PERF=1).
+// Software events always; hardware ones only where a PMU is exposed.
+#define PERF_N_EVENTS 6
+
+typedef struct {
+    const char *name;               // argv[0] of the stage
+    int         fd[PERF_N_EVENTS];  // -1 where the event could not be opened
+} PerfCounters;
+
+// Opens the counters on pid, disabled until its execvp() (enable_on_exec)
+// and inherited by its children.  The child must not have exec'd yet.
+void perf_attach(PerfCounters *pc, pid_t pid, const char *name);
+
+
+// Prints one line per stage of n finished stages to stderr and closes them.
+void perf_report(PerfCounters *pc, int n);
+
+#endif /* PERFSTAT_H */
@@ -0,0 +1,20 @@
+#ifndef PMAP_H
+#define PMAP_H
+
+#include "parser.h"
+
+// 'pmap [-j N] [-m MERGE... --] PIPELINE': run N copies of a pipeline over
+// newline-aligned slices of its '<' file.  See src/pmap.c.
+
+#define PMAP_MAX_JOBS 256       // upper bound for -j
+
+// Returns 1 if p starts with the 'pmap' prefix.
+int pmap_prefixed(const Pipeline *p);
+
+
+// Runs p without its prefix over slices of its input and writes the
+// outputs in input order (or through the merge command).  Returns the
+// exit status.
+int pmap_execute(const Pipeline *p);
+
+#endif /* PMAP_H */
@@ -0,0 +1,43 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT static tracepoints (provider "myshell") for bpftrace / perf probe / stap.
+//
+// With <sys/sdt.h> (systemtap-sdt-dev) available each probe is a single nop
+// plus a note in .note.stapsdt; without it, or with -DMSH_NO_SDT, the
+// macros compile to nothing (arguments are not evaluated).
+//
+//   parse__start  (const char *line)
+//   parse__done   (int n_tokens, int rc, const char *err)   rc 0 = parsed
+//   spawn__start  (int stage, const char *argv0)            before fork()
+//   spawn         (int stage, const char *argv0, int pid)   after fork()
+//   redir         (int kind, int fd, const char *path, int rc)   per action, RedirKind
+//   reap          (int pid, int status, long utime_us, long stime_us)
+//
+// List them with:  readelf -n myshell | grep -A2 stapsdt
+// Example:         bpftrace tools/spawn_latency.bt
+
+#if !defined(MSH_NO_SDT) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define MSH_HAVE_SDT 1
+#  endif
+#endif
+
+#ifdef MSH_HAVE_SDT
+#  define PROBE_PARSE_START(line)             DTRACE_PROBE1(myshell, parse__start, line)
+#  define PROBE_PARSE_DONE(ntok, rc, err)     DTRACE_PROBE3(myshell, parse__done, ntok, rc, err)
+#  define PROBE_SPAWN_START(i, argv0)         DTRACE_PROBE2(myshell, spawn__start, i, argv0)
+#  define PROBE_SPAWN(i, argv0, pid)          DTRACE_PROBE3(myshell, spawn, i, argv0, pid)
+#  define PROBE_REDIR(kind, fd, path, rc)     DTRACE_PROBE4(myshell, redir, kind, fd, path, rc)
+#  define PROBE_REAP(pid, status, utime, stime) DTRACE_PROBE4(myshell, reap, pid, status, utime, stime)
+#else
+#  define PROBE_PARSE_START(line)             ((void)sizeof(line))
+#  define PROBE_PARSE_DONE(ntok, rc, err)     ((void)sizeof(ntok), (void)sizeof(rc), (void)sizeof(err))
+#  define PROBE_SPAWN_START(i, argv0)         ((void)sizeof(i), (void)sizeof(argv0))
+#  define PROBE_SPAWN(i, argv0, pid)          ((void)sizeof(i), (void)sizeof(argv0), (void)sizeof(pid))
+#  define PROBE_REDIR(kind, fd, path, rc)     ((void)sizeof(kind), (void)sizeof(fd), (void)sizeof(path), (void)sizeof(rc))
+#  define PROBE_REAP(pid, status, utime, stime) ((void)sizeof(pid), (void)sizeof(status), (void)sizeof(utime), (void)sizeof(stime))
+#endif
+
+#endif /* PROBES_H */
@@ -0,0 +1,25 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Script line profiler (-p / MYSHELL_PROFILE): wall time, children's CPU
+// time, spawns and the shell's own overhead per input line, reported at exit.
+#define PROFILE_OFF     0
+#define PROFILE_REPORT  1       // sorted table (-p, MYSHELL_PROFILE=1)
+#define PROFILE_FOLDED  2       // folded stacks for flamegraph.pl (MYSHELL_PROFILE=folded)
+
+// Starts attributing to input line lineno, whose text is line.
+void profile_line_begin(int lineno, const char *line);
+
+
+// Adds the parse time of the current line.
+void profile_parse(long long ns);
+
+
+// Ends the current line: everything since profile_line_begin() is charged to it.
+void profile_line_end(void);
+
+
+// Prints the report (or folded stacks) to stderr.
+void profile_report(int mode);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,32 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include "parser.h"
+
+// Persistent job queue: 'qsub PIPELINE' appends to an on-disk spool, a
+// detached scheduler runs the jobs, 'qstat' / 'qwait' read the results.
+// Spool format and scheduling: see src/queue.c.
+
+#define QUEUE_DEFAULT     "default" // queue of jobs submitted without -q
+#define QUEUE_NAME_MAX    32        // longest queue name, including the '\0'
+#define QUEUE_MAX_COMMAND 8192      // longest queued command line
+#define QUEUE_LINGER_MS   2000      // idle scheduler exits after this long
+
+// Returns 1 if p starts with the 'qsub' prefix.
+int queue_prefixed(const Pipeline *p);
+
+
+// 'qsub [-q QUEUE] [-p PRIO] PIPELINE': spools p (without the prefix),
+// starts the scheduler if none is running and prints the job id.
+int queue_submit(const Pipeline *p);
+
+
+// 'qstat [ID...]' builtin: one line per job.
+int queue_stat_builtin(char **argv);
+
+
+// 'qwait [ID...]' builtin: waits for the jobs (default: every job spooled
+// so far).  Returns 0 if all succeeded, else the first failed job's status.
+int queue_wait_builtin(char **argv);
+
+#endif /* QUEUE_H */
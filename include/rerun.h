@@ -0,0 +1,18 @@
+#ifndef RERUN_H
+#define RERUN_H
+
+#include "parser.h"
+
+// 'rerun [-c] [-d MS] PIPELINE': run it, then again whenever one of its
+// input files changes (inotify), until Ctrl-C.  See src/rerun.c.
+
+#define RERUN_DEBOUNCE_MS 200   // quiet time after a change before the next run
+
+// Returns 1 if p starts with the 'rerun' prefix.
+int rerun_prefixed(const Pipeline *p);
+
+
+// Runs the rerun loop for p; returns the status of the last completed run.
+int rerun_execute(const Pipeline *p);
+
+#endif /* RERUN_H */
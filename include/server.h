@@ -0,0 +1,34 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>     // int32_t, int64_t
+
+// myshell --server SOCKET / --client SOCKET: a long-lived shell that runs
+// command lines submitted over a UNIX socket (SOCK_SEQPACKET).
+//
+// Request (one packet):  cwd '\0' command-line ['\n' here-document lines]
+//                        + SCM_RIGHTS { stdin, stdout, stderr }
+// Reply   (one packet):  ServerReply
+
+#define SERVER_MAX_REQUEST 65536
+
+#define SERVER_REPLY_CACHED 0x1     // the parsed command line was reused
+
+typedef struct {
+    int32_t  status;    // exit status of the command line (128 + signal if killed)
+    uint32_t flags;     // SERVER_REPLY_*
+    int64_t  wall_ns;   // request received to runner reaped
+    int64_t  parse_ns;  // parse time (0 when SERVER_REPLY_CACHED)
+} ServerReply;
+
+// Serves until SIGINT / SIGTERM, then removes the socket.  Returns the
+// process exit status.
+int server_main(const char *sock_path);
+
+
+// Submits words (joined by spaces) with this process's stdin, stdout and
+// stderr; with timing set, prints the server's timing to stderr.  Returns
+// the command's exit status (127 if the server is unreachable).
+int client_main(const char *sock_path, int timing, char **words);
+
+#endif /* SERVER_H */
@@ -0,0 +1,104 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <time.h>       // clock_gettime()
+
+// Always-on counters and latency histograms of the shell's own overhead,
+// printed by the 'stats' builtin.  Recording is an increment or a
+// clz + shift + increment, so it is inlined at every call site.
+
+// Log-linear (HDR-style) histogram of nanosecond values: 16 linear
+// sub-buckets per power of two, i.e. about 6% relative precision from 1 ns
+// up to the full 64-bit range.
+#define STATS_SUB_BITS 4
+#define STATS_SUB      (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS  (64 * STATS_SUB)
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long min;
+    unsigned long long max;
+    unsigned long long bucket[STATS_BUCKETS];
+} Histogram;
+
+typedef struct {
+    unsigned long long lines_read;      // command lines read at the prompt
+    unsigned long long parses;          // parse_list() calls
+    unsigned long long pipes_created;   // pipes made by the shell process
+    unsigned long long spawns;          // successful fork()s
+    unsigned long long spawn_failures;  // fork() or execvp() failures
+    unsigned long long slot_overflows;  // children forked with every stats slot in flight (untimed)
+    unsigned long long fds_opened;      // descriptors created by the shell process
+    Histogram parse_ns;                 // parse_list() time
+    Histogram spawn_ns;                 // fork() in the parent to execvp() in the child
+    Histogram prompt_exec_ns;           // line read to the first child's execvp()
+} ShellStats;
+
+extern ShellStats shell_stats;
+
+// Per-child timestamps kept in shared memory (see stats_slot())
+#define STATS_MARK_FORK  0      // parent, just before fork()
+#define STATS_MARK_START 1      // child, first instruction after fork()
+#define STATS_MARK_EXEC  2      // child, just before execvp()
+#define STATS_MARK_FAIL  3      // child, execvp() returned
+#define STATS_MARKS      4
+
+
+static inline long long stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static inline int stats_bucket(unsigned long long v)
+{
+    if (v < STATS_SUB) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    return (e - STATS_SUB_BITS + 1) * STATS_SUB + (int)((v >> (e - STATS_SUB_BITS)) & (STATS_SUB - 1));
+}
+
+static inline void hist_record(Histogram *h, long long ns)
+{
+    unsigned long long v = ns > 0 ? (unsigned long long)ns : 0;
+    h->bucket[stats_bucket(v)]++;
+    if (h->count == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->count++;
+    h->sum += v;
+}
+
+
+// Parent, before fork(): claims a free shared slot, stamps STATS_MARK_FORK
+// and returns its index (-1 if the shared mapping is unavailable or every
+// slot is in flight).  The slot stays claimed until stats_reaped().
+int stats_slot(void);
+
+
+// Child: stamps mark what (STATS_MARK_*) into its slot; no-op for slot -1.
+void stats_mark(int slot, int what);
+
+
+// Reads a stamp of slot (0 if unset or slot is -1).
+long long stats_slot_get(int slot, int what);
+
+
+// Parent, after waitpid(): turns the child's stamps into spawn statistics
+// and frees the slot (also after a failed fork(), with no stamps).
+void stats_reaped(int slot);
+
+
+// Child of fork_runner(): refreshes the cached pid that owns its slots.
+void stats_forked(void);
+
+
+// Prompt loop: a command line was read at time t (starts prompt-to-exec);
+// frees slots leaked by dead owners if a child recently found none free.
+void stats_line_read(long long t);
+
+
+// 'stats [--json | reset]'; returns the builtin's exit status.
+int stats_builtin(char **argv);
+
+#endif /* STATS_H */
@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <poll.h>       // struct pollfd
+#include <sys/types.h>  // pid_t
+
+// Execution trace in Chrome trace-event JSON (opens in Perfetto / about:tracing).
+// Enabled by MYSHELL_TRACE=path; every call below is a no-op while trace_on is 0,
+// and call sites test trace_on first so a disabled trace costs one branch.
+extern int trace_on;
+
+// Opens path (truncating it) and starts the JSON array; 0 or -1 (error printed).
+int trace_init(const char *path);
+
+
+// Terminates the JSON array, flushes and closes the trace file.
+void trace_close(void);
+
+
+// CLOCK_MONOTONIC in nanoseconds.
+long long trace_now(void);
+
+
+// Records a complete span [t0, t1] on the shell's own track (tid 0) or on a
+// child's track (tid = pid); detail (may be NULL) is shown as args.detail.
+void trace_span(const char *name, long long t0, long long t1, pid_t tid,
+                const char *detail);
+
+
+// Writes everything recorded since the last flush with a single write().
+void trace_flush(void);
+
+
+// Parent, after fork(): registers a started child and records the fork span;
+// slot is the child's stats_slot(), whose start / exec stamps trace_reaped() reads.
+void trace_child(pid_t pid, int slot, const char *argv0, long long t0, long long t1);
+
+
+// Parent: watches read_fd (duplicated, the caller keeps its own) for the first
+// byte written by writer; the watch ends when reader exits.
+void trace_pipe(int read_fd, pid_t writer, pid_t reader);
+
+
+// Blocks until every registered child has exited, timestamping exits and the
+// first byte through each watched pipe.  Children are left for waitpid().
+void trace_watch(void);
+
+
+// For a wait loop of its own (the pipe monitor's): trace_nfds() bounds the
+// fds trace_poll_fds() puts in pfd – the pidfds of children still running,
+// then the watched pipes; 0 once no child is left.  After poll(),
+// trace_poll_events() timestamps what fired at now, as trace_watch() would.
+int trace_nfds(void);
+int trace_poll_fds(struct pollfd *pfd, int max);
+void trace_poll_events(const struct pollfd *pfd, int n, long long now);
+
+
+// Parent, after waitpid(): records the child's setup, exec and run events.
+void trace_reaped(pid_t pid, int status);
+
+#endif /* TRACE_H */
@@ -1,5 +1,9 @@
 #!/bin/bash
 # Setup test input files
+#
+# Source this script (. ./setup_tests.sh) before running run_tests.txt:
+# the exports below keep 'memo' and 'qsub' out of the user's own store
+# and job spool.
 
 echo "Setting up test files..."
 
@@ -18,5 +22,39 @@ cat > numbers.txt << 'EOF'
 2
 EOF
 
+# Create big.txt (larger than a pipe buffer: copy fast path, pmap)
+seq 1 200000 > big.txt
+
+# Scratch store for 'memo' and spool for 'qsub', empty on every setup so
+# the first memo run in run_tests.txt is a miss and job ids start at 1
+rm -rf test_store
+mkdir -p test_store
+export MYSHELL_MEMO_DIR="$PWD/test_store/memo"
+export MYSHELL_QUEUE_DIR="$PWD/test_store/queue"
+
+# Create memo_in.txt
+printf 'apple\nbanana\n' > memo_in.txt
+
+# Create dag specs: one whose second run is all up to date, one that fails
+cat > test_ok.dag << 'EOF'
+# name:  deps   : pipeline
+sorted:         : sort < numbers.txt > dag_sorted.txt
+count:   sorted : wc -l < dag_sorted.txt > dag_count.txt
+EOF
+
+cat > test_fail.dag << 'EOF'
+broken:         : ls nonexistent.txt > dag_broken.txt
+after:   broken : cat dag_broken.txt > dag_after.txt
+EOF
+rm -f dag_sorted.txt dag_count.txt dag_broken.txt dag_after.txt
+
+# Create test.fifo with a reader that takes 10 bytes and goes away, so
+# 'cat big.txt > test.fifo' gets EPIPE.  Its pid is kept for
+# cleanup_tests.sh in case run_tests.txt never opens the FIFO.
+rm -f test.fifo
+mkfifo test.fifo
+dd bs=10 count=1 status=none of=fifo_head.txt < test.fifo &
+echo $! > fifo_reader.pid
+
 echo "Test files created:"
-ls -l input.txt numbers.txt
+ls -l input.txt numbers.txt big.txt memo_in.txt test_ok.dag test_fail.dag test.fifo
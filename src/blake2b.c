@@ -0,0 +1,132 @@
+/* =============================================================================
+ * src/blake2b.c  –  BLAKE2b hash (RFC 7693)
+ *
+ * A plain transcription of the RFC's reference code: 12 rounds of the G
+ * mixing function over a 16-word state per 128-byte block, the last block
+ * flagged and zero-padded.  Words are read little-endian byte by byte, so
+ * the digest does not depend on the host's byte order.  No key support:
+ * 'memo' only needs a collision-resistant content hash.
+ * ============================================================================= */
+
+#include <string.h>     /* memcpy(), memset() */
+#include "blake2b.h"
+
+static const uint64_t iv[8] = {
+    0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL,
+    0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+    0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL,
+    0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL
+};
+
+static const unsigned char sigma[12][16] = {
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+static uint64_t rotr(uint64_t x, int r)
+{
+    return (x >> r) | (x << (64 - r));
+}
+
+static uint64_t load64(const unsigned char *p)
+{
+    uint64_t w = 0;
+    for (int i = 7; i >= 0; i--) w = (w << 8) | p[i];
+    return w;
+}
+
+#define G(a, b, c, d, x, y) do {                        \
+        v[a] = v[a] + v[b] + (x); v[d] = rotr(v[d] ^ v[a], 32); \
+        v[c] = v[c] + v[d];       v[b] = rotr(v[b] ^ v[c], 24); \
+        v[a] = v[a] + v[b] + (y); v[d] = rotr(v[d] ^ v[a], 16); \
+        v[c] = v[c] + v[d];       v[b] = rotr(v[b] ^ v[c], 63); \
+    } while (0)
+
+/* Mixes the full block s->b into the state; last flags the final block */
+static void compress(Blake2b *s, int last)
+{
+    uint64_t v[16], m[16];
+
+    for (int i = 0; i < 8; i++) {
+        v[i] = s->h[i];
+        v[i + 8] = iv[i];
+    }
+    v[12] ^= s->t[0];
+    v[13] ^= s->t[1];
+    if (last) v[14] = ~v[14];
+    for (int i = 0; i < 16; i++) m[i] = load64(s->b + 8 * i);
+
+    for (int r = 0; r < 12; r++) {
+        const unsigned char *sg = sigma[r];
+        G(0, 4,  8, 12, m[sg[ 0]], m[sg[ 1]]);
+        G(1, 5,  9, 13, m[sg[ 2]], m[sg[ 3]]);
+        G(2, 6, 10, 14, m[sg[ 4]], m[sg[ 5]]);
+        G(3, 7, 11, 15, m[sg[ 6]], m[sg[ 7]]);
+        G(0, 5, 10, 15, m[sg[ 8]], m[sg[ 9]]);
+        G(1, 6, 11, 12, m[sg[10]], m[sg[11]]);
+        G(2, 7,  8, 13, m[sg[12]], m[sg[13]]);
+        G(3, 4,  9, 14, m[sg[14]], m[sg[15]]);
+    }
+
+    for (int i = 0; i < 8; i++) s->h[i] ^= v[i] ^ v[i + 8];
+}
+
+static void count(Blake2b *s, size_t n)
+{
+    s->t[0] += n;
+    if (s->t[0] < n) s->t[1]++;
+}
+
+
+void blake2b_init(Blake2b *s, size_t outlen)
+{
+    memcpy(s->h, iv, sizeof(iv));
+    s->h[0] ^= 0x01010000ULL ^ (uint64_t)outlen;   /* depth 1, fanout 1, no key */
+    s->t[0] = s->t[1] = 0;
+    s->c = 0;
+    s->outlen = outlen;
+}
+
+
+void blake2b_update(Blake2b *s, const void *data, size_t n)
+{
+    const unsigned char *p = data;
+
+    while (n > 0) {
+        /* A full block is only compressed once more input follows it:
+         * the last one must be flagged in blake2b_final() */
+        if (s->c == sizeof(s->b)) {
+            count(s, s->c);
+            compress(s, 0);
+            s->c = 0;
+        }
+        size_t take = sizeof(s->b) - s->c;
+        if (take > n) take = n;
+        memcpy(s->b + s->c, p, take);
+        s->c += take;
+        p += take;
+        n -= take;
+    }
+}
+
+
+void blake2b_final(Blake2b *s, unsigned char *out)
+{
+    count(s, s->c);
+    memset(s->b + s->c, 0, sizeof(s->b) - s->c);
+    compress(s, 1);
+
+    for (size_t i = 0; i < s->outlen; i++) {
+        out[i] = (unsigned char)(s->h[i / 8] >> (8 * (i % 8)));
+    }
+}
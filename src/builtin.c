@@ -0,0 +1,107 @@
+/* =============================================================================
+ * src/builtin.c  –  Commands implemented inside the shell
+ *
+ * A pipeline consisting of one builtin runs in the shell process itself, so
+ * it sees (and can change) the shell's own state.  Its redirections are
+ * applied with apply_redirections() around the call: every descriptor they
+ * target is saved first and put back afterwards.
+ *
+ * Inside a larger pipeline a builtin runs in its forked child instead of
+ * execvp() (see start_pipeline()), working on the child's copy of the state.
+ *
+ * ('exit' stays in the prompt loop, which it has to leave.)
+ * ============================================================================= */
+
+#define _GNU_SOURCE     /* F_DUPFD_CLOEXEC */
+
+#include <stdio.h>      /* fflush() */
+#include <stdlib.h>     /* malloc(), free() */
+#include <string.h>     /* strcmp() */
+#include <fcntl.h>      /* fcntl() */
+#include <unistd.h>     /* dup2(), close() */
+#include "builtin.h"
+#include "exec.h"       /* apply_redirections() */
+#include "stats.h"      /* stats_builtin() */
+#include "pathcache.h"  /* pathcache_builtin() */
+#include "queue.h"      /* queue_stat_builtin(), queue_wait_builtin() */
+#include "dag.h"        /* dag_builtin() */
+#include "options.h"    /* shell_opts.readahead */
+
+typedef struct {
+    const char *name;
+    BuiltinFn   fn;
+} Builtin;
+
+static const Builtin builtins[] = {
+    { "stats", stats_builtin },
+    { "hash",  pathcache_builtin },
+    { "qstat", queue_stat_builtin },
+    { "qwait", queue_wait_builtin },
+    { "dag",   dag_builtin },
+};
+
+#define N_BUILTINS (int)(sizeof(builtins) / sizeof(builtins[0]))
+
+/* First descriptor used to park the shell's own fds during a redirection */
+#define SAVED_FD_BASE 10
+
+
+BuiltinFn find_builtin(const char *name)
+{
+    if (name == NULL) return NULL;
+
+    for (int i = 0; i < N_BUILTINS; i++) {
+        if (strcmp(builtins[i].name, name) == 0) return builtins[i].fn;
+    }
+    return NULL;
+}
+
+
+int try_builtin(const Pipeline *p, int *status)
+{
+    if (p == NULL || p->n_cmds != 1 || p->cmds[0].n_psubs > 0) return 0;
+
+    const Command *c = &p->cmds[0];
+    BuiltinFn fn = find_builtin(c->argv[0]);
+    if (fn == NULL) return 0;
+
+    if (c->n_redirs == 0) {
+        *status = fn(c->argv);
+        return 1;
+    }
+
+    /* Park every target fd (-1: it was not open) so the shell gets it back */
+    int *saved = malloc((size_t)c->n_redirs * sizeof(int));
+    if (saved == NULL) {
+        *status = 1;
+        return 1;
+    }
+    fflush(NULL);
+    for (int i = 0; i < c->n_redirs; i++) {
+        saved[i] = -1;
+        for (int j = 0; j < i; j++) {
+            if (c->redirs[j].fd == c->redirs[i].fd) { saved[i] = -2; break; }
+        }
+        if (saved[i] == -1) saved[i] = fcntl(c->redirs[i].fd, F_DUPFD_CLOEXEC, SAVED_FD_BASE);
+    }
+
+    if (apply_redirections(c, shell_opts.readahead) < 0) {
+        *status = 1;
+    } else {
+        *status = fn(c->argv);
+    }
+    fflush(NULL);
+
+    /* Restore in reverse so the first save of each fd is the one that sticks */
+    for (int i = c->n_redirs - 1; i >= 0; i--) {
+        if (saved[i] == -2) continue;
+        if (saved[i] >= 0) {
+            dup2(saved[i], c->redirs[i].fd);
+            close(saved[i]);
+        } else {
+            close(c->redirs[i].fd);
+        }
+    }
+    free(saved);
+    return 1;
+}
@@ -0,0 +1,230 @@
+/* =============================================================================
+ * src/copy.c  –  In-process fast path for pure copy pipelines
+ *
+ * A pipeline that only copies one file into another,
+ *
+ *     cat < a > b        cat a > b        cat a >> b
+ *
+ * does not need a child process or a trip through user space.
+ * try_copy_fastpath() recognises these plans after parsing and copies in
+ * the kernel, trying in order:
+ *
+ *   1. ioctl(FICLONE)      – reflink (shared extents) on btrfs, XFS, ...
+ *   2. copy_file_range()   – in-kernel copy (server-side on NFS/CIFS)
+ *   3. sendfile()          – in-kernel copy for other fd combinations
+ *   4. io_relay()          – user-space relay through the shell's I/O engine
+ *                            (io_uring, or poll + read/write)
+ *
+ * Redirections are opened in command-line order with the same flags and the
+ * same error messages as apply_redirections(), and cat's own messages are
+ * reproduced for failures that cat would report, so the fast path is not
+ * observable except by speed.  A reader that goes away early (a FIFO whose
+ * reader exits) ends the copy with status 128 + SIGPIPE, as it ends cat;
+ * SIGPIPE itself is ignored meanwhile so it cannot kill the shell.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // copy_file_range()
+
+#include <stdio.h>      // fprintf(), perror()
+#include <signal.h>     // sigaction(), SIGPIPE
+#include <string.h>     // strcmp(), strerror()
+#include <errno.h>      // errno
+#include <fcntl.h>      // open(), O_* flags
+#include <unistd.h>     // read(), write(), close(), copy_file_range()
+#include <sys/ioctl.h>  // ioctl()
+#include <sys/stat.h>   // fstat(), S_ISREG, S_ISDIR
+#include <sys/sendfile.h> // sendfile()
+#include <linux/fs.h>   // FICLONE
+#include "exec.h"
+#include "ioeng.h"      // io_relay_ex()
+#include "options.h"    // shell_opts.io_engine
+#include "stats.h"      // shell_stats.fds_opened
+
+#define COPY_CHUNK  (1L << 30)      /* bytes per copy_file_range()/sendfile() call */
+
+
+/* -----------------------------------------------------------------------------
+ * is_copy_plan()
+ *
+ * A pure copy plan is a single  cat  with at most one file argument (not an
+ * option), no process substitutions, and redirections that only open files
+ * on stdin / stdout, including at least one output file on stdout.
+ * ----------------------------------------------------------------------------- */
+static int is_copy_plan(const Pipeline *p)
+{
+    if (p->n_cmds != 1) return 0;
+
+    const Command *c = &p->cmds[0];
+    if (strcmp(c->argv[0], "cat") != 0 || c->n_psubs > 0) return 0;
+    if (c->argv[1] != NULL && (c->argv[1][0] == '-' || c->argv[2] != NULL)) return 0;
+
+    int has_in = (c->argv[1] != NULL);
+    int has_out = 0;
+
+    for (int i = 0; i < c->n_redirs; i++) {
+        const Redir *r = &c->redirs[i];
+
+        if (r->kind == REDIR_IN && r->fd == STDIN_FILENO) {
+            has_in = 1;
+        } else if ((r->kind == REDIR_OUT || r->kind == REDIR_APPEND) && r->fd == STDOUT_FILENO) {
+            has_out = 1;
+        } else {
+            return 0;   /* dups, here-documents, other fds: general path */
+        }
+    }
+    return has_in && has_out;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * copy_fd()
+ *
+ * Copies everything from in (current offset) to out (current offset),
+ * trying reflink, copy_file_range(), sendfile() and io_relay() in that
+ * order.  Each in-kernel method advances both offsets, so a later method
+ * simply continues where an earlier one gave up.
+ *
+ * Returns 0 or -1 with errno set; *read_failed tells which side failed.
+ * ----------------------------------------------------------------------------- */
+int copy_fd(int in, int out, const struct stat *in_st, const struct stat *out_st,
+            int append, int *read_failed)
+{
+    *read_failed = 0;
+
+    /* 1. Reflink: only for a whole regular file into a fresh, empty one */
+    if (S_ISREG(in_st->st_mode) && S_ISREG(out_st->st_mode) && !append &&
+        out_st->st_size == 0 && lseek(in, 0, SEEK_CUR) == 0 &&
+        ioctl(out, FICLONE, in) == 0) {
+        return 0;
+    }
+
+    /* 2. copy_file_range(): regular files on (usually) the same filesystem.
+     *    Not allowed on O_APPEND outputs (EBADF), so skip straight on. */
+    if (!append) {
+        for (;;) {
+            ssize_t n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0);
+            if (n == 0) return 0;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                    errno == EOPNOTSUPP || errno == EBADF) break;
+                return -1;  /* real I/O error (ENOSPC, EIO, ...) */
+            }
+        }
+    }
+
+    /* 3. sendfile(): any readable-by-mmap input into any output */
+    for (;;) {
+        ssize_t n = sendfile(out, in, NULL, COPY_CHUNK);
+        if (n == 0) return 0;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL || errno == ENOSYS) break;
+            return -1;
+        }
+    }
+
+    /* 4. Relay through the shell's I/O engine */
+    return io_relay_ex(in, out, -1, shell_opts.io_engine, IO_BLOCK_SIZE, read_failed) < 0 ? -1 : 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * try_copy_fastpath()
+ *
+ * If p is a pure copy plan, performs it in-process and stores the exit
+ * status cat would have produced in *status; returns 1.  Returns 0 (and
+ * does nothing) for any other pipeline.
+ * ----------------------------------------------------------------------------- */
+int try_copy_fastpath(const Pipeline *p, int *status)
+{
+    if (p == NULL || !is_copy_plan(p)) return 0;
+
+    const Command *c = &p->cmds[0];
+    int in = -1, out = -1, append = 0;
+    *status = 1;
+
+    /* Step 1 – Open the redirections in order, last one on each fd wins */
+    for (int i = 0; i < c->n_redirs; i++) {
+        const Redir *r = &c->redirs[i];
+
+        if (r->kind == REDIR_IN) {
+            int fd = open(r->path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                /* The spec requires this exact phrasing for a missing input file */
+                fprintf(stderr, "File not found.\n");
+                goto done;
+            }
+            shell_stats.fds_opened++;
+            if (in >= 0) close(in);
+            in = fd;
+        } else {
+            int flags = O_WRONLY | O_CREAT | O_CLOEXEC |
+                        (r->kind == REDIR_APPEND ? O_APPEND : O_TRUNC);
+            int fd = open(r->path, flags, 0644);
+            if (fd < 0) {
+                perror(r->path);
+                goto done;
+            }
+            shell_stats.fds_opened++;
+            if (out >= 0) close(out);
+            out = fd;
+            append = (r->kind == REDIR_APPEND);
+        }
+    }
+
+    /* Step 2 – cat FILE reads FILE instead of stdin */
+    const char *in_name = "-";
+    if (c->argv[1] != NULL) {
+        in_name = c->argv[1];
+        if (in >= 0) close(in);
+        in = open(in_name, O_RDONLY | O_CLOEXEC);
+        if (in < 0) {
+            fprintf(stderr, "cat: %s: %s\n", in_name, strerror(errno));
+            goto done;
+        }
+        shell_stats.fds_opened++;
+    }
+
+    /* Step 3 – The checks cat itself makes before copying */
+    struct stat in_st, out_st;
+    if (fstat(in, &in_st) < 0 || fstat(out, &out_st) < 0) {
+        fprintf(stderr, "cat: %s: %s\n", in_name, strerror(errno));
+        goto done;
+    }
+    if (S_ISDIR(in_st.st_mode)) {
+        fprintf(stderr, "cat: %s: Is a directory\n", in_name);
+        goto done;
+    }
+    if (S_ISREG(out_st.st_mode) && in_st.st_dev == out_st.st_dev &&
+        in_st.st_ino == out_st.st_ino && lseek(in, 0, SEEK_CUR) < in_st.st_size) {
+        fprintf(stderr, "cat: %s: input file is output file\n", in_name);
+        goto done;
+    }
+
+    /* Step 4 – Copy in the kernel, with EPIPE instead of a SIGPIPE to the shell */
+    struct sigaction ign, old_pipe;
+    int read_failed, rc;
+
+    memset(&ign, 0, sizeof(ign));
+    ign.sa_handler = SIG_IGN;
+    sigemptyset(&ign.sa_mask);
+    sigaction(SIGPIPE, &ign, &old_pipe);
+    rc = copy_fd(in, out, &in_st, &out_st, append, &read_failed);
+    int saved = errno;
+    sigaction(SIGPIPE, &old_pipe, NULL);
+    errno = saved;
+
+    if (rc < 0) {
+        if (!read_failed && errno == EPIPE) *status = 128 + SIGPIPE;   /* cat is killed silently */
+        else if (read_failed) fprintf(stderr, "cat: %s: %s\n", in_name, strerror(errno));
+        else                  fprintf(stderr, "cat: write error: %s\n", strerror(errno));
+        goto done;
+    }
+    *status = 0;
+
+done:
+    if (in >= 0) close(in);
+    if (out >= 0) close(out);
+    return 1;
+}
@@ -0,0 +1,523 @@
+/* =============================================================================
+ * src/dag.c  –  'dag': pipelines with dependencies, run in parallel
+ *
+ *   dag [-j N] etl.dag
+ *
+ *   # name:     deps             : pipeline
+ *   extract:                     : grep -v ^# < raw.csv > clean.csv
+ *   users:      extract          : cut -d, -f1 < clean.csv | sort -u > users.txt
+ *   totals:     extract          : awk -f sum.awk < clean.csv > totals.txt
+ *   report:     users totals     : paste users.txt totals.txt > report.txt
+ *
+ * A script that runs these one after another waits for 'users' before it
+ * starts 'totals', though neither needs the other.  'dag' builds the graph
+ * and starts every node whose dependencies are done, up to N at once
+ * (-j N, default: online CPUs).  Blank lines and '#' lines are ignored.
+ *
+ *   - Each pipeline is read with parse_line() and run by execute_pipeline()
+ *     in a forked runner, exactly as typed at the prompt.  Runners are
+ *     waited for through their pidfds in one poll().
+ *   - Up to date (make rules): a node is skipped when it has outputs ('>'
+ *     and '>>' files), all of them exist, and none of its inputs is newer
+ *     than the oldest one.  Inputs are its '<' files, argv words naming
+ *     regular files and the outputs of its dependencies; a dependency
+ *     without outputs that ran makes it run too.
+ *   - A failed node stops new starts, as in make: running nodes finish,
+ *     the others are reported as not run.  The status of 'dag' is the
+ *     first failed node's status, 0 if none failed.
+ *
+ * Unknown dependencies, duplicate names and cycles are reported before
+ * anything runs.  At the end, stderr gets one line per node (status, start
+ * and duration from the start of 'dag') and the critical path: the chain
+ * of dependencies whose durations add up to the longest time.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // getline()
+
+#include <stdio.h>      // fopen(), getline(), fprintf(), perror()
+#include <stdlib.h>     // malloc(), realloc(), calloc(), free(), atoi()
+#include <string.h>     // strchr(), strcmp(), strtok_r(), strdup(), strspn()
+#include <errno.h>      // errno
+#include <unistd.h>     // close(), sysconf()
+#include <poll.h>       // poll()
+#include <sys/stat.h>   // stat(), S_ISREG
+#include <sys/wait.h>   // waitpid()
+#include "dag.h"
+#include "exec.h"       // execute_pipeline(), fork_runner()
+#include "stats.h"      // stats_now()
+
+#define POLL_TICK_MS 50     /* runner check interval without pidfd_open() */
+
+enum {
+    NODE_WAITING,       /* dependencies not done yet */
+    NODE_RUNNING,
+    NODE_DONE,          /* ran, status 0 */
+    NODE_CURRENT,       /* skipped: outputs up to date */
+    NODE_FAILED,
+    NODE_NOT_RUN        /* not started before a failure */
+};
+
+typedef struct {
+    char     *name;
+    int      *deps;         /* node indices */
+    int       n_deps;
+    int       line;         /* in the spec file */
+    Pipeline  pl;
+    int       state;        /* NODE_* */
+    int       status;
+    pid_t     pid;
+    int       pidfd;
+    long long t_start;      /* ns since the start of 'dag' */
+    long long t_end;
+    long long cp_ns;        /* longest chain of durations ending here */
+    int       cp_prev;      /* dependency on that chain, -1 if none */
+} DagNode;
+
+typedef struct {
+    DagNode *nodes;
+    int      n_nodes;
+} Dag;
+
+
+static void dag_free(Dag *d)
+{
+    for (int i = 0; i < d->n_nodes; i++) {
+        free(d->nodes[i].name);
+        free(d->nodes[i].deps);
+        free_pipeline(&d->nodes[i].pl);
+    }
+    free(d->nodes);
+}
+
+static int find_node(const Dag *d, const char *name)
+{
+    for (int i = 0; i < d->n_nodes; i++) {
+        if (strcmp(d->nodes[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/* Strips leading and trailing blanks in place */
+static char *trim(char *s)
+{
+    s += strspn(s, " \t");
+    char *e = s + strlen(s);
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\n' || e[-1] == '\r')) *--e = '\0';
+    return s;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Spec file
+ * ----------------------------------------------------------------------------- */
+
+/* dep_names[i]: dependencies of node i as written, until every node is known */
+static int add_node(Dag *d, char ***dep_names, const char *path, int lineno, char *line)
+{
+    char *c1 = strchr(line, ':');
+    char *c2 = c1 != NULL ? strchr(c1 + 1, ':') : NULL;
+    char err[256];
+
+    if (c2 == NULL) {
+        fprintf(stderr, "dag: %s:%d: expected 'name: deps : pipeline'\n", path, lineno);
+        return -1;
+    }
+    *c1 = *c2 = '\0';
+    char *name = trim(line), *deps = trim(c1 + 1), *text = trim(c2 + 1);
+
+    if (name[0] == '\0' || strpbrk(name, " \t") != NULL) {
+        fprintf(stderr, "dag: %s:%d: bad node name '%s'\n", path, lineno, name);
+        return -1;
+    }
+    if (find_node(d, name) >= 0) {
+        fprintf(stderr, "dag: %s:%d: duplicate node '%s'\n", path, lineno, name);
+        return -1;
+    }
+
+    DagNode *tmp = realloc(d->nodes, (size_t)(d->n_nodes + 1) * sizeof(DagNode));
+    char **ptmp = realloc(*dep_names, (size_t)(d->n_nodes + 1) * sizeof(char *));
+    if (tmp != NULL) d->nodes = tmp;
+    if (ptmp != NULL) *dep_names = ptmp;
+    if (tmp == NULL || ptmp == NULL) {
+        perror("realloc (dag)");
+        return -1;
+    }
+
+    DagNode *n = &d->nodes[d->n_nodes];
+    memset(n, 0, sizeof(*n));
+    n->line = lineno;
+    n->pidfd = -1;
+    n->cp_prev = -1;
+    if (parse_line(text, &n->pl, err, sizeof(err)) != 0) {
+        fprintf(stderr, "dag: %s:%d: %s\n", path, lineno, err);
+        return -1;
+    }
+    for (int i = 0; i < n->pl.n_cmds; i++) {
+        for (int j = 0; j < n->pl.cmds[i].n_redirs; j++) {
+            if (n->pl.cmds[i].redirs[j].kind != REDIR_HEREDOC) continue;
+            fprintf(stderr, "dag: %s:%d: here-documents are not supported\n", path, lineno);
+            free_pipeline(&n->pl);
+            return -1;
+        }
+    }
+    n->name = strdup(name);
+    (*dep_names)[d->n_nodes] = strdup(deps);
+    d->n_nodes++;
+    if (n->name == NULL || (*dep_names)[d->n_nodes - 1] == NULL) {
+        perror("strdup (dag)");
+        return -1;
+    }
+    return 0;
+}
+
+static int resolve_deps(Dag *d, char **dep_names, const char *path)
+{
+    for (int i = 0; i < d->n_nodes; i++) {
+        DagNode *n = &d->nodes[i];
+        char *save = NULL;
+
+        n->deps = malloc((strlen(dep_names[i]) / 2 + 1) * sizeof(int));
+        if (n->deps == NULL) {
+            perror("malloc (dag)");
+            return -1;
+        }
+        for (char *w = strtok_r(dep_names[i], " \t", &save); w != NULL; w = strtok_r(NULL, " \t", &save)) {
+            int k = find_node(d, w);
+            if (k < 0) {
+                fprintf(stderr, "dag: %s:%d: '%s' depends on unknown node '%s'\n", path, n->line, n->name, w);
+                return -1;
+            }
+            n->deps[n->n_deps++] = k;
+        }
+    }
+    return 0;
+}
+
+/* Depth-first search for a cycle; mark: 0 new, 1 on the stack, 2 done */
+static int find_cycle(const Dag *d, int i, char *mark, const char *path)
+{
+    if (mark[i] == 2) return 0;
+    if (mark[i] == 1) {
+        fprintf(stderr, "dag: %s:%d: dependency cycle through '%s'\n", path, d->nodes[i].line, d->nodes[i].name);
+        return -1;
+    }
+    mark[i] = 1;
+    for (int k = 0; k < d->nodes[i].n_deps; k++) {
+        if (find_cycle(d, d->nodes[i].deps[k], mark, path) < 0) return -1;
+    }
+    mark[i] = 2;
+    return 0;
+}
+
+static int load_spec(Dag *d, const char *path)
+{
+    char **dep_names = NULL;
+    char *line = NULL;
+    size_t cap = 0;
+    int lineno = 0, rc = -1;
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "dag: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (getline(&line, &cap, f) >= 0) {
+        char *s = trim(line);
+        lineno++;
+        if (s[0] == '\0' || s[0] == '#') continue;
+        if (strlen(s) >= DAG_MAX_LINE) {
+            fprintf(stderr, "dag: %s:%d: line too long\n", path, lineno);
+            goto out;
+        }
+        if (add_node(d, &dep_names, path, lineno, s) < 0) goto out;
+    }
+    if (resolve_deps(d, dep_names, path) < 0) goto out;
+
+    char *mark = calloc((size_t)d->n_nodes + 1, 1);
+    if (mark == NULL) goto out;
+    rc = 0;
+    for (int i = 0; i < d->n_nodes && rc == 0; i++) rc = find_cycle(d, i, mark, path);
+    free(mark);
+
+out:
+    for (int i = 0; i < d->n_nodes; i++) free(dep_names[i]);
+    free(dep_names);
+    free(line);
+    fclose(f);
+    return rc;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Up-to-date check
+ * ----------------------------------------------------------------------------- */
+
+static long long mtime_ns(const struct stat *st)
+{
+    return (long long)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static int is_output(const Redir *r)
+{
+    return r->kind == REDIR_OUT || r->kind == REDIR_APPEND;
+}
+
+/* Oldest output of n; 0 if n has an output that is missing, -1 if it has none */
+static long long oldest_output(const DagNode *n)
+{
+    long long oldest = -1;
+    struct stat st;
+
+    for (int i = 0; i < n->pl.n_cmds; i++) {
+        for (int j = 0; j < n->pl.cmds[i].n_redirs; j++) {
+            const Redir *r = &n->pl.cmds[i].redirs[j];
+            if (!is_output(r)) continue;
+            if (stat(r->path, &st) < 0) return 0;
+            if (oldest < 0 || mtime_ns(&st) < oldest) oldest = mtime_ns(&st);
+        }
+    }
+    return oldest;
+}
+
+/* Is any output of n newer than t? */
+static int outputs_newer(const DagNode *n, long long t)
+{
+    struct stat st;
+
+    for (int i = 0; i < n->pl.n_cmds; i++) {
+        for (int j = 0; j < n->pl.cmds[i].n_redirs; j++) {
+            const Redir *r = &n->pl.cmds[i].redirs[j];
+            if (is_output(r) && stat(r->path, &st) == 0 && mtime_ns(&st) > t) return 1;
+        }
+    }
+    return 0;
+}
+
+static int up_to_date(const Dag *d, const DagNode *n)
+{
+    long long oldest = oldest_output(n);
+    struct stat st;
+
+    if (oldest <= 0) return 0;
+
+    for (int i = 0; i < n->pl.n_cmds; i++) {
+        const Command *c = &n->pl.cmds[i];
+        for (int k = 1; c->argv[k] != NULL; k++) {
+            if (stat(c->argv[k], &st) == 0 && S_ISREG(st.st_mode) && mtime_ns(&st) > oldest) return 0;
+        }
+        for (int j = 0; j < c->n_redirs; j++) {
+            if (c->redirs[j].kind == REDIR_IN && (stat(c->redirs[j].path, &st) < 0 || mtime_ns(&st) > oldest)) return 0;
+        }
+    }
+    for (int k = 0; k < n->n_deps; k++) {
+        const DagNode *dep = &d->nodes[n->deps[k]];
+        if (dep->state == NODE_DONE && oldest_output(dep) < 0) return 0;    /* ran, no outputs */
+        if (outputs_newer(dep, oldest)) return 0;
+    }
+    return 1;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Execution
+ * ----------------------------------------------------------------------------- */
+
+/* Body of a node's runner; it stays in the shell's process group, like a
+ * pipeline typed at the prompt */
+static int run_node(void *ctx)
+{
+    return execute_pipeline(&((DagNode *)ctx)->pl);
+}
+
+static int start_node(DagNode *n, long long t0)
+{
+    pid_t pid = fork_runner(run_node, n, 0, &n->pidfd, "dag: fork");
+    if (pid < 0) return -1;
+
+    n->pid = pid;
+    n->state = NODE_RUNNING;
+    n->t_start = stats_now() - t0;
+    return 0;
+}
+
+/* Longest chain of durations ending at node i (its dependencies are final) */
+static void set_critical(Dag *d, int i)
+{
+    DagNode *n = &d->nodes[i];
+
+    n->cp_ns = n->t_end - n->t_start;
+    n->cp_prev = -1;
+    for (int k = 0; k < n->n_deps; k++) {
+        const DagNode *dep = &d->nodes[n->deps[k]];
+        if (n->cp_prev < 0 || dep->cp_ns > d->nodes[n->cp_prev].cp_ns) n->cp_prev = n->deps[k];
+    }
+    if (n->cp_prev >= 0) n->cp_ns += d->nodes[n->cp_prev].cp_ns;
+}
+
+/* Reaps finished runners; returns the first failed status seen, or 0 */
+static int reap_nodes(Dag *d, long long t0)
+{
+    int failed = 0;
+
+    for (int i = 0; i < d->n_nodes; i++) {
+        DagNode *n = &d->nodes[i];
+        int ws;
+
+        if (n->state != NODE_RUNNING || waitpid(n->pid, &ws, WNOHANG) != n->pid) continue;
+        if (n->pidfd >= 0) close(n->pidfd);
+        n->pidfd = -1;
+        n->t_end = stats_now() - t0;
+        n->status = WIFEXITED(ws) ? WEXITSTATUS(ws) : 128 + WTERMSIG(ws);
+        n->state = n->status == 0 ? NODE_DONE : NODE_FAILED;
+        set_critical(d, i);
+        if (n->status != 0 && failed == 0) failed = n->status;
+    }
+    return failed;
+}
+
+/* Starts (or skips) every node whose dependencies are done, up to max
+ * running, or after a failure marks the waiting ones not run.  Returns the
+ * number running. */
+static int start_ready(Dag *d, int max_jobs, int stopping, long long t0)
+{
+    int running = 0, progress = 1;
+
+    for (int i = 0; i < d->n_nodes; i++) running += d->nodes[i].state == NODE_RUNNING;
+
+    while (progress) {
+        progress = 0;
+        for (int i = 0; i < d->n_nodes; i++) {
+            DagNode *n = &d->nodes[i];
+            int ready = 1;
+
+            if (n->state != NODE_WAITING) continue;
+            if (stopping) {
+                n->state = NODE_NOT_RUN;
+                continue;
+            }
+            for (int k = 0; k < n->n_deps; k++) {
+                int st = d->nodes[n->deps[k]].state;
+                if (st != NODE_DONE && st != NODE_CURRENT) ready = 0;
+            }
+
+            if (ready && up_to_date(d, n)) {
+                n->state = NODE_CURRENT;
+                n->t_start = n->t_end = stats_now() - t0;
+                set_critical(d, i);
+                progress = 1;
+            } else if (ready && running < max_jobs) {
+                if (start_node(n, t0) < 0) return running;
+                running++;
+            }
+        }
+    }
+    return running;
+}
+
+/* Prints the chain ending at node i, first node first */
+static void print_chain(const Dag *d, int i)
+{
+    if (d->nodes[i].cp_prev >= 0) {
+        print_chain(d, d->nodes[i].cp_prev);
+        fprintf(stderr, " ->");
+    }
+    fprintf(stderr, " %s", d->nodes[i].name);
+}
+
+static void report(const Dag *d, long long wall)
+{
+    static const char *state_name[] = { "waiting", "running", "ok", "current", "failed", "not run" };
+    long long busy = 0;
+    int last = -1;
+
+    fprintf(stderr, "%-16s %8s %9s %9s\n", "NODE", "STATUS", "START", "TIME");
+    for (int i = 0; i < d->n_nodes; i++) {
+        const DagNode *n = &d->nodes[i];
+        char st[16];
+
+        if (n->state == NODE_FAILED) snprintf(st, sizeof(st), "%d", n->status);
+        else snprintf(st, sizeof(st), "%s", state_name[n->state]);
+        if (n->state == NODE_NOT_RUN) {
+            fprintf(stderr, "%-16s %8s %9s %9s\n", n->name, st, "-", "-");
+            continue;
+        }
+        fprintf(stderr, "%-16s %8s %8.3fs %8.3fs\n", n->name, st, n->t_start / 1e9, (n->t_end - n->t_start) / 1e9);
+        busy += n->t_end - n->t_start;
+        if (last < 0 || n->cp_ns > d->nodes[last].cp_ns) last = i;
+    }
+
+    fprintf(stderr, "dag: %.3fs wall, %.3fs in nodes (%.1fx)", wall / 1e9, busy / 1e9, wall > 0 ? (double)busy / wall : 0.0);
+    if (last >= 0) {
+        fprintf(stderr, "; critical path %.3fs:", d->nodes[last].cp_ns / 1e9);
+        print_chain(d, last);
+    }
+    fprintf(stderr, "\n");
+}
+
+
+int dag_builtin(char **argv)
+{
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_jobs = ncpu > 0 ? (int)ncpu : 1;
+    int k = 1;
+
+    if (argv[k] != NULL && strcmp(argv[k], "-j") == 0 && argv[k + 1] != NULL) {
+        max_jobs = atoi(argv[k + 1]);
+        k += 2;
+    }
+    if (argv[k] == NULL || argv[k + 1] != NULL || max_jobs < 1) {
+        fprintf(stderr, "usage: dag [-j N] specfile\n");
+        return 2;
+    }
+
+    Dag d = { NULL, 0 };
+    if (load_spec(&d, argv[k]) < 0) {
+        dag_free(&d);
+        return 2;
+    }
+
+    long long t0 = stats_now();
+    struct pollfd *pfd = malloc((size_t)max_jobs * sizeof(struct pollfd));
+    int status = 0;
+
+    if (pfd == NULL) {
+        perror("malloc (dag)");
+        dag_free(&d);
+        return 1;
+    }
+
+    for (;;) {
+        int running = start_ready(&d, max_jobs, status != 0, t0);
+        if (running == 0) break;
+
+        int np = 0, timeout = -1;
+        for (int i = 0; i < d.n_nodes && np < max_jobs; i++) {
+            if (d.nodes[i].state != NODE_RUNNING) continue;
+            if (d.nodes[i].pidfd >= 0) pfd[np++] = (struct pollfd){ d.nodes[i].pidfd, POLLIN, 0 };
+            else timeout = POLL_TICK_MS;    /* no pidfd_open(): check now and then */
+        }
+        if (poll(pfd, (nfds_t)np, timeout) < 0 && errno != EINTR) {
+            perror("dag: poll");
+            break;
+        }
+
+        int failed = reap_nodes(&d, t0);
+        if (status == 0) status = failed;
+    }
+
+    /* Only after a poll() error: wait for whatever is still running */
+    for (int i = 0; i < d.n_nodes; i++) {
+        if (d.nodes[i].state != NODE_RUNNING) continue;
+        waitpid(d.nodes[i].pid, NULL, 0);
+        if (d.nodes[i].pidfd >= 0) close(d.nodes[i].pidfd);
+        d.nodes[i].state = NODE_FAILED;
+        d.nodes[i].t_end = stats_now() - t0;
+        if (status == 0) status = 1;
+    }
+
+    report(&d, stats_now() - t0);
+    free(pfd);
+    dag_free(&d);
+    return status;
+}
@@ -5,6 +5,39 @@
  *     b. Calls apply_redirections()       – overrides with explicit < > 2> files
  *     c. Calls execvp()                   – replaces itself with the real program
  *
+ * Pure copy plans (cat < a > b, cat a > b) skip the fork entirely and are
+ * done in-process by try_copy_fastpath() (src/copy.c).
+ *
+ * execute_pipeline() is start_pipeline() followed by wait_job(); the split
+ * lets process substitutions <(...) / >(...) run their inner pipelines
+ * concurrently with the command that reads or writes /dev/fd/N.
+ *
+ * Command lists (pl0 ; pl1 && pl2 || pl3) are run by execute_list(), which
+ * walks the parsed CommandList once and short-circuits on the exit code
+ * returned by execute_pipeline().
+ *
+ * Every fork stamps a shared stats slot (src/stats.c) that the child
+ * completes at execvp(), giving the spawn latency histograms of 'stats'.
+ * Commands are exec'd by the full path remembered in src/pathcache.c when
+ * there is one, skipping execvp()'s walk over PATH.
+ *
+ * Single commands naming a builtin (src/builtin.c) run in the shell itself;
+ * inside a pipeline a builtin runs in its forked child instead of execvp().
+ *
+ * With MYSHELL_PERF=1 each child waits on a sync pipe after fork() until the
+ * parent has attached perf_event_open() counters to it (src/perfstat.c);
+ * wait_job() prints them per stage.
+ *
+ * With MYSHELL_IOACCT=1 wait_job() reaps in two steps, waitid(WNOWAIT) then
+ * wait4(), reading each stage's /proc/<pid>/io in between (src/ioacct.c).
+ *
+ * With MYSHELL_MONITOR=ms the parent samples the fill level of every pipe
+ * while it waits and names the bottleneck stage (src/monitor.c).
+ *
+ * With MYSHELL_TRACE set, pipe creation, every fork, each child's setup /
+ * exec / run and the first byte through each pipe are recorded by the
+ * trace_*() hooks (src/trace.c); with it unset each hook is one branch.
+ *
  * Error handling (runtime, after successful parse):
  *   "File not found."                      – open() failed for an input file
  *                                            (printed inside apply_redirections)
@@ -12,17 +45,162 @@
  *   "Command not found in pipe sequence."  – execvp() failed, multiple commands
  * ============================================================================= */
 
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE     // pipe2(), O_CLOEXEC
 
-#include <stdio.h>      // perror(), fprintf()
-#include <stdlib.h>     // malloc(), free(), exit()
-#include <unistd.h>     // fork(), execvp(), dup2(), close()
-#include <sys/wait.h>   // waitpid(), WIFEXITED, WEXITSTATUS
+#include <stdio.h>      // perror(), fprintf(), snprintf()
+#include <stdlib.h>     // malloc(), free()
+#include <string.h>     // memcpy()
+#include <unistd.h>     // fork(), execvp(), dup2(), close(), _exit(), setpgid(), syscall()
+#include <fcntl.h>      // fcntl(), O_CLOEXEC
+#include <errno.h>      // errno, EINTR
+#include <sys/wait.h>   // waitpid(), wait4(), WIFEXITED, WEXITSTATUS
+#include <sys/resource.h> // struct rusage
+#include <sys/syscall.h> // SYS_pidfd_open
 #include "exec.h"       
+#include "options.h"    // shell_opts.dontneed, shell_opts.copy_fastpath
+#include "trace.h"      // trace_on, trace_*()
+#include "stats.h"      // shell_stats, stats_slot(), stats_mark(), stats_forked()
+#include "builtin.h"    // try_builtin(), find_builtin()
+#include "probes.h"     // PROBE_SPAWN_START, PROBE_SPAWN, PROBE_REAP
+#include "pathcache.h"  // pathcache_lookup()
+#include "memo.h"       // memo_prefixed(), memo_execute()
+#include "rerun.h"      // rerun_prefixed(), rerun_execute()
+#include "pmap.h"       // pmap_prefixed(), pmap_execute()
+#include "queue.h"      // queue_prefixed(), queue_submit()
 
+#define SUBST_PATH_LEN 32   /* room for "/dev/fd/<int>" */
 
-int execute_pipeline(const Pipeline *p)
+
+/* -----------------------------------------------------------------------------
+ * Process-substitution state of one command in the pipeline being started:
+ * argv with every <(...) / >(...) word replaced by "/dev/fd/N", and the
+ * descriptors N the command has to inherit across execvp().
+ * ----------------------------------------------------------------------------- */
+typedef struct {
+    char **argv;        /* substituted argv (NULL if the command has none)  */
+    int   *fds;         /* outer pipe ends, one per ProcSub (-1 = unused)   */
+    char  *paths;       /* n_psubs strings of SUBST_PATH_LEN bytes          */
+    int    n_fds;
+} SubstArgs;
+
+
+/* Closes the outer pipe ends and frees the substitution state of n_cmds commands */
+static void free_subst(SubstArgs *subst, int n_cmds)
+{
+    if (subst == NULL) return;
+
+    for (int i = 0; i < n_cmds; i++) {
+        for (int j = 0; j < subst[i].n_fds; j++) {
+            if (subst[i].fds[j] >= 0) close(subst[i].fds[j]);
+        }
+        free(subst[i].argv);
+        free(subst[i].fds);
+        free(subst[i].paths);
+    }
+    free(subst);
+}
+
+
+/* Appends a started inner job to job->subs so wait_job() reaps it */
+static int job_add_sub(Job *job, const Job *sub)
+{
+    Job *tmp = realloc(job->subs, (size_t)(job->n_subs + 1) * sizeof(Job));
+    if (tmp == NULL) return -1;
+    job->subs = tmp;
+    job->subs[job->n_subs++] = *sub;
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * start_substitutions()
+ *
+ * For every ProcSub of cmd, creates a pipe (O_CLOEXEC on both ends), starts
+ * the inner pipeline with start_pipeline() connected to one end, and keeps
+ * the other end for the outer command:
+ *
+ *   <(inner) : inner stdout → pipe → /dev/fd/N read by the command
+ *   >(inner) : command writes /dev/fd/N → pipe → inner stdin
+ *
+ * The inner jobs are recorded in job->subs.  Returns 0 or -1 (error printed).
+ * ----------------------------------------------------------------------------- */
+static int start_substitutions(const Command *cmd, SubstArgs *sa, Job *job)
+{
+    int argc = 0;
+    while (cmd->argv[argc] != NULL) argc++;
+
+    sa->argv  = malloc((size_t)(argc + 1) * sizeof(char *));
+    sa->fds   = malloc((size_t)cmd->n_psubs * sizeof(int));
+    sa->paths = malloc((size_t)cmd->n_psubs * SUBST_PATH_LEN);
+    if (sa->argv == NULL || sa->fds == NULL || sa->paths == NULL) {
+        perror("malloc (process substitution)");
+        return -1;
+    }
+    memcpy(sa->argv, cmd->argv, (size_t)(argc + 1) * sizeof(char *));
+
+    for (int j = 0; j < cmd->n_psubs; j++) {
+        const ProcSub *ps = &cmd->psubs[j];
+
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) < 0) {
+            perror("pipe");
+            return -1;
+        }
+        shell_stats.pipes_created++;
+        shell_stats.fds_opened += 2;
+
+        int inner_end = ps->is_output ? fds[0] : fds[1];
+        int outer_end = ps->is_output ? fds[1] : fds[0];
+
+        Job sub;
+        int rc = start_pipeline(ps->inner,
+                                ps->is_output ? inner_end : -1,
+                                ps->is_output ? -1 : inner_end,
+                                &sub);
+        close(inner_end);               /* only the inner job needs it now */
+        if (rc < 0) {
+            close(outer_end);
+            return -1;
+        }
+        if (job_add_sub(job, &sub) < 0) {
+            perror("malloc (process substitution)");
+            close(outer_end);
+            (void)wait_job(&sub);
+            return -1;
+        }
+
+        char *path = sa->paths + (size_t)j * SUBST_PATH_LEN;
+        snprintf(path, SUBST_PATH_LEN, "/dev/fd/%d", outer_end);
+        sa->argv[ps->argi] = path;
+        sa->fds[sa->n_fds++] = outer_end;
+    }
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * start_pipeline()
+ *
+ * Forks one child per command of p and returns without waiting.  If in_fd /
+ * out_fd are >= 0 they become the stdin of the first / stdout of the last
+ * command (before its own redirections); they should be O_CLOEXEC so no
+ * other child keeps them open past execvp().
+ *
+ * On success job holds every child PID (and any process-substitution jobs)
+ * and must be passed to wait_job().  On failure, children already started
+ * are reaped and -1 is returned.
+ * ----------------------------------------------------------------------------- */
+int start_pipeline(const Pipeline *p, int in_fd, int out_fd, Job *job)
 {
+    job->pids   = NULL;
+    job->slots  = NULL;
+    job->n_pids = 0;
+    job->perf   = NULL;
+    job->io     = NULL;
+    job->mon    = NULL;
+    job->subs   = NULL;
+    job->n_subs = 0;
+
     /* Guard against NULL or empty pipeline */
     if (p == NULL || p->n_cmds == 0) return 0;
 
@@ -30,7 +208,33 @@ int execute_pipeline(const Pipeline *p)
     int n_pipes = n_cmds - 1;   /* one pipe per adjacent command pair */
 
     /* ------------------------------------------------------------------
-     * Step 1 – Create n_pipes anonymous pipes.
+     * Step 1 – Start process substitutions.
+     *
+     * This happens before the pipeline's own pipes exist, so the inner
+     * children never inherit (and hold open) the outer pipe ends.
+     * ------------------------------------------------------------------ */
+    SubstArgs *subst = NULL;
+
+    for (int i = 0; i < n_cmds; i++) {
+        if (p->cmds[i].n_psubs == 0) continue;
+
+        if (subst == NULL) {
+            subst = calloc((size_t)n_cmds, sizeof(SubstArgs));
+            if (subst == NULL) {
+                perror("malloc (process substitution)");
+                (void)wait_job(job);
+                return -1;
+            }
+        }
+        if (start_substitutions(&p->cmds[i], &subst[i], job) < 0) {
+            free_subst(subst, n_cmds);
+            (void)wait_job(job);
+            return -1;
+        }
+    }
+
+    /* ------------------------------------------------------------------
+     * Step 2 – Create n_pipes anonymous pipes.
      *
      * We allocate the pipe array on the heap so the function supports
      * arbitrarily long pipelines (not capped by stack size).
@@ -42,43 +246,82 @@ int execute_pipeline(const Pipeline *p)
         pipe_fds = malloc((size_t)n_pipes * sizeof(int[2]));
         if (pipe_fds == NULL) {
             perror("malloc (pipe_fds)");
+            free_subst(subst, n_cmds);
+            (void)wait_job(job);
             return -1;
         }
 
         /* create_pipes() opens all n_pipes pipes; on failure it cleans up
          * any that were partially opened and prints an error. */
+        long long t0 = trace_on ? trace_now() : 0;
         if (create_pipes(n_pipes, pipe_fds) < 0) {
             free(pipe_fds);
+            free_subst(subst, n_cmds);
+            (void)wait_job(job);
             return -1;
         }
+        if (trace_on) trace_span("pipes", t0, trace_now(), 0, NULL);
+        shell_stats.pipes_created += (unsigned long long)n_pipes;
+        shell_stats.fds_opened    += 2ULL * (unsigned long long)n_pipes;
     }
 
     /* ------------------------------------------------------------------
-     * Allocate PID array so we can wait for every child in Step 4.
+     * Allocate PID array so wait_job() can wait for every child.
      * ------------------------------------------------------------------ */
-    pid_t *pids = malloc((size_t)n_cmds * sizeof(pid_t));
-    if (pids == NULL) {
+    job->pids  = malloc((size_t)n_cmds * sizeof(pid_t));
+    job->slots = malloc((size_t)n_cmds * sizeof(int));
+    if (job->pids == NULL || job->slots == NULL) {
         perror("malloc (pids)");
         if (pipe_fds) { close_all_pipes(n_pipes, pipe_fds); free(pipe_fds); }
+        free_subst(subst, n_cmds);
+        (void)wait_job(job);
         return -1;
     }
 
+    if (shell_opts.perf) {
+        job->perf = malloc((size_t)n_cmds * sizeof(PerfCounters));
+        if (job->perf == NULL) perror("malloc (perf)");
+    }
+    if (shell_opts.ioacct) {
+        job->io = calloc((size_t)n_cmds, sizeof(IoAcct));
+        if (job->io == NULL) perror("malloc (ioacct)");
+    }
+
     /* ------------------------------------------------------------------
-     * Step 2 – Fork one child per command.
+     * Step 3 – Fork one child per command.
      * ------------------------------------------------------------------ */
     for (int i = 0; i < n_cmds; i++) {
 
+        int       slot = stats_slot();
+        long long t0   = trace_on ? trace_now() : 0;
+
+        /* Counters are attached while the child waits on this pipe */
+        int sync[2] = { -1, -1 };
+        if (job->perf != NULL && pipe2(sync, O_CLOEXEC) < 0) {
+            perror("pipe (perf)");
+            sync[0] = sync[1] = -1;
+        }
+
+        /* Full path looked up here, so the parent keeps what it learned */
+        const char *exe = NULL;
+        if (shell_opts.path_cache && find_builtin(p->cmds[i].argv[0]) == NULL) {
+            exe = pathcache_lookup(p->cmds[i].argv[0]);
+        }
+
+        PROBE_SPAWN_START(i, p->cmds[i].argv[0]);
         pid_t pid = fork();
 
         if (pid < 0) {
+            shell_stats.spawn_failures++;
+            stats_reaped(slot);             /* frees the slot: no child stamped it */
+            if (sync[0] >= 0) { close(sync[0]); close(sync[1]); }
             /* fork() itself failed (e.g. EAGAIN, ENOMEM).
              * Close all open pipe ends so nothing leaks, then wait for
              * any children already spawned to avoid zombie processes. */
             perror("fork");
-            if (pipe_fds) close_all_pipes(n_pipes, pipe_fds);
-            for (int j = 0; j < i; j++) waitpid(pids[j], NULL, 0);
-            free(pids);
-            if (pipe_fds) free(pipe_fds);
+            if (pipe_fds) { close_all_pipes(n_pipes, pipe_fds); free(pipe_fds); }
+            free_subst(subst, n_cmds);
+            (void)wait_job(job);
             return -1;
         }
 
@@ -86,20 +329,58 @@ int execute_pipeline(const Pipeline *p)
             /* ============================================================
              * CHILD PROCESS
              * ============================================================ */
+            stats_mark(slot, STATS_MARK_START);
+
+            // Wait until the parent has attached the perf counters
+            if (sync[0] >= 0) {
+                char c;
+                close(sync[1]);
+                while (read(sync[0], &c, 1) < 0 && errno == EINTR) ;
+                close(sync[0]);
+            }
+
+            // Caller-supplied ends (process substitution)
+            if (i == 0 && in_fd >= 0 && dup2(in_fd, STDIN_FILENO) < 0) {
+                perror("dup2: stdin");
+            }
+            if (i == n_cmds - 1 && out_fd >= 0 && dup2(out_fd, STDOUT_FILENO) < 0) {
+                perror("dup2: stdout");
+            }
 
             // Pipe connections
             if (n_pipes > 0) {
                 connect_pipes_for_child(i, n_cmds, n_pipes, pipe_fds);
             }
 
+            // Keep this command's /dev/fd/N ends open across execvp()
+            char **argv = p->cmds[i].argv;
+            if (subst != NULL && subst[i].argv != NULL) {
+                for (int j = 0; j < subst[i].n_fds; j++) {
+                    fcntl(subst[i].fds[j], F_SETFD, 0);
+                }
+                argv = subst[i].argv;
+            }
+
             // Redirections
-            if (apply_redirections(&p->cmds[i]) < 0) {
+            if (apply_redirections(&p->cmds[i], shell_opts.readahead) < 0) {
                 /* apply_redirections already printed the error message */
-                exit(1);
+                _exit(1);
+            }
+
+            // Builtins run right here, in the child
+            BuiltinFn builtin = find_builtin(argv[0]);
+            if (builtin != NULL) {
+                stats_mark(slot, STATS_MARK_EXEC);
+                int rc = builtin(argv);
+                fflush(NULL);
+                _exit(rc);
             }
 
             // Execution
-            execvp(p->cmds[i].argv[0], p->cmds[i].argv);
+            stats_mark(slot, STATS_MARK_EXEC);
+            if (exe != NULL) execv(exe, argv);
+            execvp(argv[0], argv);
+            stats_mark(slot, STATS_MARK_FAIL);
 
             if (n_cmds == 1) {
                 // Single command case
@@ -110,34 +391,100 @@ int execute_pipeline(const Pipeline *p)
             }
 
             // Conventional exit code for “command not found.”
-            exit(127);
+            _exit(127);
         }
 
         /* ==============================================================
          * PARENT PROCESS – record child PID and continue forking
          * ============================================================== */
-        pids[i] = pid;
+        if (job->perf != NULL) {
+            PerfCounters *pc = &job->perf[job->n_pids];
+            if (sync[0] >= 0) {
+                close(sync[0]);
+                perf_attach(pc, pid, p->cmds[i].argv[0]);
+                close(sync[1]);             /* EOF releases the child */
+            } else {
+                pc->name = p->cmds[i].argv[0];
+                for (int k = 0; k < PERF_N_EVENTS; k++) pc->fd[k] = -1;
+            }
+        }
+        if (job->io != NULL) job->io[job->n_pids].name = p->cmds[i].argv[0];
+        job->slots[job->n_pids]  = slot;
+        job->pids[job->n_pids++] = pid;
+        shell_stats.spawns++;
+        PROBE_SPAWN(i, p->cmds[i].argv[0], (int)pid);
+        if (trace_on) trace_child(pid, slot, p->cmds[i].argv[0], t0, trace_now());
+    }
+
+    /* Monitored: sample the pipes' fill levels while the job runs */
+    if (shell_opts.monitor_ms > 0 && n_pipes > 0) {
+        job->mon = monitor_start(p, job->pids, pipe_fds, n_pipes, shell_opts.monitor_ms);
+    }
+
+    /* Traced: watch each pipe for its first byte until the reader exits */
+    if (trace_on) {
+        for (int k = 0; k < n_pipes; k++) {
+            trace_pipe(pipe_fds[k][0], job->pids[k], job->pids[k + 1]);
+        }
     }
 
     /* ------------------------------------------------------------------
-     * Step 3 – Parent closes all pipe ends.
+     * Step 4 – Parent closes all pipe ends and substitution ends.
      * ------------------------------------------------------------------ */
     if (pipe_fds) {
         close_all_pipes(n_pipes, pipe_fds);
         free(pipe_fds);         /* heap memory no longer needed */
     }
+    free_subst(subst, n_cmds);
 
-    /* ------------------------------------------------------------------
-     * Step 4 – Wait for all child processes.
-     * ------------------------------------------------------------------ */
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * wait_job()
+ *
+ * Waits for every child of a started job, then reaps its process-
+ * substitution jobs (which finish once the main commands closed their
+ * /dev/fd ends).  Frees the job's arrays.
+ *
+ * Returns the exit code of the last command (1 if it was killed by a signal).
+ * ----------------------------------------------------------------------------- */
+int wait_job(Job *job)
+{
     int last_exit = 0;
 
-    for (int i = 0; i < n_cmds; i++) {
+    /* Monitored: sample until every stage exited (then report) */
+    if (job->mon != NULL) {
+        monitor_run(job->mon);
+        job->mon = NULL;
+    }
+
+    /* Traced: see exits (and first bytes) in the order they happen; a
+     * monitor already stamped those of its own stages */
+    if (trace_on) trace_watch();
+
+    for (int i = 0; i < job->n_pids; i++) {
         int status;
-        waitpid(pids[i], &status, 0);   /* block until child i exits */
+
+        /* I/O accounting: read /proc/<pid>/io while the child is a zombie */
+        if (job->io != NULL) {
+            siginfo_t si;
+            while (waitid(P_PID, (id_t)job->pids[i], &si, WEXITED | WNOWAIT) < 0 &&
+                   errno == EINTR) ;
+            (void)ioacct_read(job->pids[i], &job->io[i]);
+        }
+
+        struct rusage ru;
+        wait4(job->pids[i], &status, 0, &ru);   /* block until child i exits */
+        PROBE_REAP((int)job->pids[i], status,
+                   ru.ru_utime.tv_sec * 1000000L + ru.ru_utime.tv_usec,
+                   ru.ru_stime.tv_sec * 1000000L + ru.ru_stime.tv_usec);
+        if (trace_on) trace_reaped(job->pids[i], status);   /* reads the slot... */
+        stats_reaped(job->slots[i]);                        /* ...before it is freed */
 
         /* Capture the numeric exit code of the last command */
-        if (i == n_cmds - 1) {
+        if (i == job->n_pids - 1) {
             if (WIFEXITED(status)) {
                 last_exit = WEXITSTATUS(status);
             } else {
@@ -147,6 +494,145 @@ int execute_pipeline(const Pipeline *p)
         }
     }
 
-    free(pids);
+    if (job->perf != NULL) perf_report(job->perf, job->n_pids);
+    if (job->io != NULL && job->n_pids > 0) ioacct_report(job->io, job->n_pids);
+
+    for (int i = 0; i < job->n_subs; i++) {
+        (void)wait_job(&job->subs[i]);
+    }
+
+    free(job->pids);
+    free(job->slots);
+    free(job->perf);
+    free(job->io);
+    free(job->subs);
+    job->pids   = NULL;
+    job->slots  = NULL;
+    job->n_pids = 0;
+    job->perf   = NULL;
+    job->io     = NULL;
+    job->subs   = NULL;
+    job->n_subs = 0;
+
     return last_exit;
 }
+
+
+int execute_pipeline(const Pipeline *p)
+{
+    int status;
+    long long t0 = trace_on ? trace_now() : 0;
+
+    /* memo ... : restore a stored result of the same pipeline and inputs */
+    if (memo_prefixed(p)) return memo_execute(p);
+
+    /* rerun ... : run again whenever the pipeline's input files change */
+    if (rerun_prefixed(p)) return rerun_execute(p);
+
+    /* pmap ... < file : N copies over newline-aligned slices of file */
+    if (pmap_prefixed(p)) return pmap_execute(p);
+
+    /* qsub ... : spool the pipeline for the background scheduler */
+    if (queue_prefixed(p)) return queue_submit(p);
+
+    /* A lone builtin runs in the shell process */
+    if (try_builtin(p, &status)) return status;
+
+    /* cat < a > b  and  cat a > b  are copied in-process by the kernel */
+    if (shell_opts.copy_fastpath && try_copy_fastpath(p, &status)) {
+        if (trace_on) trace_span("copy_fastpath", t0, trace_now(), 0, p->cmds[0].argv[0]);
+    } else {
+        Job job;
+
+        if (start_pipeline(p, -1, -1, &job) < 0) return -1;
+        long long t1 = trace_on ? trace_now() : 0;
+        status = wait_job(&job);
+        if (trace_on) {
+            trace_span("spawn", t0, t1, 0, p->cmds[0].argv[0]);
+            trace_span("wait", t1, trace_now(), 0, p->cmds[0].argv[0]);
+        }
+    }
+
+    /* One-shot output files should not stay in the page cache */
+    if (shell_opts.dontneed) {
+        for (int i = 0; i < p->n_cmds; i++) {
+            shell_stats.fds_opened += (unsigned long long)release_output_cache(&p->cmds[i]);
+        }
+    }
+
+    return status;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * execute_list()
+ *
+ * Runs every pipeline of a parsed command list in order:
+ *
+ *   ;   always run the next pipeline
+ *   &&  run it only if the previous status is 0
+ *   ||  run it only if the previous status is non-zero
+ *
+ * A skipped pipeline leaves the status unchanged, so  false && a || b  runs b
+ * (POSIX and-or list semantics).  Internal failures of execute_pipeline()
+ * (-1, e.g. fork failed) count as status 1 for short-circuiting.
+ *
+ * Returns the status of the last pipeline that ran.
+ * ----------------------------------------------------------------------------- */
+int execute_list(const CommandList *l)
+{
+    if (l == NULL) return 0;
+
+    int status = 0;
+
+    for (int i = 0; i < l->n_nodes; i++) {
+        const ListNode *n = &l->nodes[i];
+
+        if (n->op == LIST_AND && status != 0) continue;
+        if (n->op == LIST_OR  && status == 0) continue;
+
+        status = execute_pipeline(&n->pl);
+        if (status < 0) status = 1;
+    }
+
+    return status;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * fork_runner()
+ *
+ * A runner is a fork of the shell that calls run(ctx) (its setup, then
+ * execute_pipeline() or execute_list()) and _exit()s with that status, 1 for
+ * an internal failure.  With own_pgrp the runner leads a new process group,
+ * set on both sides of the fork so that kill(-pid) reaches the whole
+ * pipeline at once.
+ *
+ * *pidfd is the runner's pidfd, -1 without pidfd_open(); callers then poll
+ * waitpid(WNOHANG).  Returns the pid, or -1 if fork() failed (reported as
+ * "<who>: ...").
+ * ----------------------------------------------------------------------------- */
+pid_t fork_runner(int (*run)(void *ctx), void *ctx, int own_pgrp, int *pidfd, const char *who)
+{
+    *pidfd = -1;
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror(who);
+        return -1;
+    }
+    if (pid == 0) {
+        stats_forked();
+        if (own_pgrp) setpgid(0, 0);
+        int status = run(ctx);
+        fflush(NULL);
+        trace_flush();
+        _exit(status < 0 ? 1 : status & 0xff);
+    }
+    if (own_pgrp) setpgid(pid, pid);   /* whichever of parent and child gets there first */
+
+#ifdef SYS_pidfd_open
+    *pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#endif
+    return pid;
+}
@@ -0,0 +1,500 @@
+/* =============================================================================
+ * src/ioeng.c  –  I/O engine for data the shell moves itself
+ *
+ * io_relay() copies between two descriptors for the shell's own data movers
+ * (the user-space fallback of the copy fast path, and any other relay the
+ * shell runs in-process).  Two engines:
+ *
+ *   io_uring (default when the kernel allows it)
+ *     - one ring per relay, so the engine is reentrant and keeps no state
+ *     - buffers registered once with IORING_REGISTER_BUFFERS and used with
+ *       READ_FIXED / WRITE_FIXED (plain READ / WRITE if registration fails,
+ *       e.g. RLIMIT_MEMLOCK)
+ *     - seekable → seekable: batches of IO_URING_DEPTH linked read→write
+ *       pairs at explicit offsets, one io_uring_enter() per batch
+ *     - otherwise (pipes, sockets, ttys): two buffers in flight, the next
+ *       read is submitted together with the previous block's write
+ *
+ *   poll (fallback)
+ *     - poll() for readiness, then read() / write(); also used when either
+ *       fd is O_NONBLOCK, where io_uring would just return -EAGAIN
+ *
+ * Both engines leave the fd offsets where read()/write() would have.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // syscall(), posix_memalign()
+
+#include <stdlib.h>     // posix_memalign(), free()
+#include <string.h>     // memset()
+#include <errno.h>      // errno, EINTR, EAGAIN, ECANCELED
+#include <fcntl.h>      // fcntl(), O_NONBLOCK, O_APPEND
+#include <poll.h>       // poll()
+#include <unistd.h>     // read(), write(), pwrite(), lseek(), syscall()
+#include <sys/mman.h>   // mmap(), munmap()
+#include <sys/stat.h>   // fstat(), S_ISREG, S_ISBLK
+#include <sys/syscall.h>// __NR_io_uring_*
+#include <sys/uio.h>    // struct iovec
+#include <linux/io_uring.h>
+#include "ioeng.h"
+
+#define IO_URING_DEPTH 8    /* linked read→write pairs per batch (seekable path) */
+
+
+/* ================ Minimal io_uring ring (no liburing) ================ */
+
+typedef struct {
+    int       fd;
+    unsigned  features;
+    unsigned  sq_entries;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+
+    unsigned  sqe_tail;     /* local tail: SQEs handed out so far */
+    unsigned  submitted;    /* SQEs already published to the kernel */
+
+    void     *sq_ptr, *cq_ptr;
+    size_t    sq_sz, cq_sz, sqes_sz;
+
+    int       fixed;        /* buffers registered? */
+} Ring;
+
+
+static void ring_exit(Ring *r)
+{
+    if (r->sqes) munmap(r->sqes, r->sqes_sz);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_sz);
+    if (r->sq_ptr) munmap(r->sq_ptr, r->sq_sz);
+    if (r->fd >= 0) close(r->fd);
+}
+
+
+static int ring_init(Ring *r, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) return -1;
+
+    r->features   = p.features;
+    r->sq_entries = p.sq_entries;
+    r->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_sz > r->sq_sz) r->sq_sz = r->cq_sz;
+        r->cq_sz = r->sq_sz;
+    }
+
+    r->sq_ptr = mmap(NULL, r->sq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) { r->sq_ptr = NULL; goto fail; }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) { r->cq_ptr = NULL; goto fail; }
+    }
+
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) { r->sqes = NULL; goto fail; }
+
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    r->sqe_tail = r->submitted = *r->sq_tail;
+    return 0;
+
+fail:
+    ring_exit(r);
+    return -1;
+}
+
+
+/* Hands out the next free SQE (zeroed), or NULL if the SQ ring is full */
+static struct io_uring_sqe *ring_get_sqe(Ring *r)
+{
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sqe_tail - head >= r->sq_entries) return NULL;
+
+    unsigned idx = r->sqe_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sqe_tail++;
+    return sqe;
+}
+
+
+/* Publishes pending SQEs and waits until at least wait_nr CQEs are ready */
+static int ring_submit_and_wait(Ring *r, unsigned wait_nr)
+{
+    unsigned to_submit = r->sqe_tail - r->submitted;
+    __atomic_store_n(r->sq_tail, r->sqe_tail, __ATOMIC_RELEASE);
+    r->submitted = r->sqe_tail;
+
+    for (;;) {
+        long rc = syscall(__NR_io_uring_enter, r->fd, to_submit, wait_nr,
+                          wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (rc >= 0) return 0;
+        if (errno != EINTR) return -1;
+        to_submit = 0;  /* already consumed by the first call */
+    }
+}
+
+
+/* Pops one completion; returns 0 if none is ready */
+static int ring_pop_cqe(Ring *r, unsigned long long *user_data, int *res)
+{
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+
+    struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+    *user_data = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+
+static void prep_rw(Ring *r, struct io_uring_sqe *sqe, int is_write, int fd,
+                    char *buf, unsigned len, long long off, int buf_index,
+                    unsigned long long user_data)
+{
+    if (r->fixed) {
+        sqe->opcode = is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = (unsigned short)buf_index;
+    } else {
+        sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)(unsigned long)buf;
+    sqe->len = len;
+    sqe->off = (unsigned long long)off;   /* -1 = current file position */
+    sqe->user_data = user_data;
+}
+
+
+/* Writes len bytes at off (or the current position if off < 0) synchronously */
+static int write_rest(int fd, const char *buf, size_t len, long long off)
+{
+    while (len > 0) {
+        ssize_t n = (off >= 0) ? pwrite(fd, buf, len, off) : write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        if (off >= 0) off += n;
+    }
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * uring_relay_linked()
+ *
+ * Seekable → seekable.  Each batch submits up to IO_URING_DEPTH pairs
+ *
+ *     READ(buf k, in_off + k*bs)  --IOSQE_IO_LINK-->  WRITE(buf k, out_off + k*bs)
+ *
+ * with a single io_uring_enter().  A short read (end of file) breaks the
+ * link, so the kernel cancels that pair's write; the bytes that were read
+ * are then written synchronously and the relay ends.
+ * ----------------------------------------------------------------------------- */
+static long long uring_relay_linked(Ring *r, int in, int out, long long len,
+                                    char **bufs, int nbufs, size_t bs,
+                                    long long in_off, long long out_off, int *read_failed)
+{
+    long long total = 0;
+    int eof = 0;
+
+    while (!eof && (len < 0 || total < len)) {
+        int   n = 0;
+        unsigned want[IO_URING_DEPTH];
+
+        for (; n < nbufs; n++) {
+            long long left = (len < 0) ? (long long)bs : len - total - (long long)n * (long long)bs;
+            if (left <= 0) break;
+            want[n] = (unsigned)(left < (long long)bs ? left : (long long)bs);
+
+            long long at = total + (long long)n * (long long)bs;
+            struct io_uring_sqe *rd = ring_get_sqe(r);
+            struct io_uring_sqe *wr = ring_get_sqe(r);
+            prep_rw(r, rd, 0, in,  bufs[n], want[n], in_off + at,  n, (unsigned long long)n << 1);
+            rd->flags |= IOSQE_IO_LINK;
+            prep_rw(r, wr, 1, out, bufs[n], want[n], out_off + at, n, ((unsigned long long)n << 1) | 1);
+        }
+
+        if (ring_submit_and_wait(r, (unsigned)(2 * n)) < 0) return -1;
+
+        int rres[IO_URING_DEPTH], wres[IO_URING_DEPTH];
+        for (int got = 0; got < 2 * n; ) {
+            unsigned long long ud;
+            int res;
+            if (!ring_pop_cqe(r, &ud, &res)) {
+                if (ring_submit_and_wait(r, 1) < 0) return -1;
+                continue;
+            }
+            if (ud & 1) wres[ud >> 1] = res;
+            else        rres[ud >> 1] = res;
+            got++;
+        }
+
+        /* Settle the pairs in file order */
+        for (int k = 0; k < n && !eof; k++) {
+            if (rres[k] < 0) { errno = -rres[k]; *read_failed = 1; return -1; }
+
+            int done = wres[k] > 0 ? wres[k] : 0;
+            if (wres[k] < 0 && wres[k] != -ECANCELED) { errno = -wres[k]; return -1; }
+            if (done < rres[k] &&
+                write_rest(out, bufs[k] + done, (size_t)(rres[k] - done),
+                           out_off + total + done) < 0) {
+                return -1;
+            }
+
+            total += rres[k];
+            if ((unsigned)rres[k] < want[k]) eof = 1;
+        }
+    }
+
+    /* Leave both offsets where read()/write() would have */
+    lseek(in,  in_off  + total, SEEK_SET);
+    lseek(out, out_off + total, SEEK_SET);
+    return total;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * uring_relay_stream()
+ *
+ * Any fd types, current file positions (IORING_FEAT_RW_CUR_POS).  Two
+ * buffers alternate: while block i is being written, block i+1 is read, and
+ * both SQEs go to the kernel in one io_uring_enter().  Writes stay strictly
+ * in read order; a short write is resubmitted for the remainder.
+ * ----------------------------------------------------------------------------- */
+enum { BUF_FREE, BUF_READING, BUF_FILLED, BUF_WRITING };
+
+static long long uring_relay_stream(Ring *r, int in, int out, long long len,
+                                    char **bufs, size_t bs, int *read_failed)
+{
+    int    state[2] = { BUF_FREE, BUF_FREE };
+    size_t fill[2] = { 0, 0 }, woff[2] = { 0, 0 };
+    int    next_r = 0, next_w = 0, eof = 0;
+    long long read_total = 0, total = 0;
+
+    for (;;) {
+        int in_flight = (state[0] == BUF_READING || state[0] == BUF_WRITING ||
+                         state[1] == BUF_READING || state[1] == BUF_WRITING);
+        int reading = (state[0] == BUF_READING || state[1] == BUF_READING);
+        int writing = (state[0] == BUF_WRITING || state[1] == BUF_WRITING);
+
+        if (!eof && !reading && state[next_r] == BUF_FREE && (len < 0 || read_total < len)) {
+            long long left = (len < 0) ? (long long)bs : len - read_total;
+            unsigned want = (unsigned)(left < (long long)bs ? left : (long long)bs);
+            prep_rw(r, ring_get_sqe(r), 0, in, bufs[next_r], want, -1, next_r,
+                    (unsigned long long)next_r << 1);
+            state[next_r] = BUF_READING;
+            in_flight = 1;
+        }
+        if (!writing && state[next_w] == BUF_FILLED) {
+            prep_rw(r, ring_get_sqe(r), 1, out, bufs[next_w] + woff[next_w],
+                    (unsigned)(fill[next_w] - woff[next_w]), -1, next_w,
+                    ((unsigned long long)next_w << 1) | 1);
+            state[next_w] = BUF_WRITING;
+            in_flight = 1;
+        }
+        if (!in_flight) break;
+
+        if (ring_submit_and_wait(r, 1) < 0) return -1;
+
+        unsigned long long ud;
+        int res;
+        while (ring_pop_cqe(r, &ud, &res)) {
+            int b = (int)(ud >> 1);
+
+            if (res < 0) {
+                errno = -res;
+                *read_failed = ((ud & 1) == 0);
+                return -1;
+            }
+
+            if ((ud & 1) == 0) {            /* read finished */
+                if (res == 0) {
+                    eof = 1;
+                    state[b] = BUF_FREE;
+                } else {
+                    fill[b] = (size_t)res;
+                    woff[b] = 0;
+                    read_total += res;
+                    state[b] = BUF_FILLED;
+                    next_r ^= 1;
+                }
+            } else {                        /* write finished */
+                woff[b] += (size_t)res;
+                if (woff[b] < fill[b]) {
+                    state[b] = BUF_FILLED;  /* resubmit the rest */
+                } else {
+                    total += (long long)fill[b];
+                    state[b] = BUF_FREE;
+                    next_w ^= 1;
+                }
+            }
+        }
+    }
+    return total;
+}
+
+
+/* Returns 1 if fd is a regular file / block device and can be addressed by offset */
+static int is_seekable(int fd, long long *off)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !(S_ISREG(st.st_mode) || S_ISBLK(st.st_mode))) return 0;
+    *off = lseek(fd, 0, SEEK_CUR);
+    return *off >= 0;
+}
+
+
+/* Returns bytes moved, -1 with errno set, or -2 if io_uring cannot be used */
+static long long uring_relay(int in, int out, long long len, size_t bs, int *read_failed)
+{
+    Ring r;
+    if (ring_init(&r, 2 * IO_URING_DEPTH) < 0) return -2;
+    if (!(r.features & IORING_FEAT_RW_CUR_POS)) { ring_exit(&r); return -2; }
+
+    long long in_off = -1, out_off = -1;
+    int linked = is_seekable(in, &in_off) && is_seekable(out, &out_off) &&
+                 !(fcntl(out, F_GETFL) & O_APPEND);
+    int nbufs = linked ? IO_URING_DEPTH : 2;
+
+    char *bufs[IO_URING_DEPTH] = { 0 };
+    struct iovec iov[IO_URING_DEPTH];
+    long long total = -1;
+
+    for (int i = 0; i < nbufs; i++) {
+        if (posix_memalign((void **)&bufs[i], 4096, bs) != 0) {
+            errno = ENOMEM;
+            goto out;
+        }
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len  = bs;
+    }
+
+    /* Pinning can fail under a small RLIMIT_MEMLOCK; unregistered buffers still work */
+    r.fixed = (syscall(__NR_io_uring_register, r.fd, IORING_REGISTER_BUFFERS, iov, nbufs) == 0);
+
+    total = linked ? uring_relay_linked(&r, in, out, len, bufs, nbufs, bs, in_off, out_off, read_failed)
+                   : uring_relay_stream(&r, in, out, len, bufs, bs, read_failed);
+
+out:
+    for (int i = 0; i < nbufs; i++) free(bufs[i]);
+    ring_exit(&r);
+    return total;
+}
+
+
+/* ================ poll() fallback ================ */
+
+/* Waits until fd is ready for events (POLLIN / POLLOUT) */
+static int wait_ready(int fd, short events)
+{
+    struct pollfd pfd = { .fd = fd, .events = events, .revents = 0 };
+    for (;;) {
+        int rc = poll(&pfd, 1, -1);
+        if (rc >= 0) return 0;
+        if (errno != EINTR) return -1;
+    }
+}
+
+
+static long long poll_relay(int in, int out, long long len, size_t bs, int *read_failed)
+{
+    char *buf = malloc(bs);
+    if (buf == NULL) return -1;
+
+    long long total = 0;
+
+    while (len < 0 || total < len) {
+        size_t want = (len < 0 || len - total > (long long)bs) ? bs : (size_t)(len - total);
+
+        if (wait_ready(in, POLLIN) < 0) goto read_fail;
+        ssize_t n = read(in, buf, want);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            goto read_fail;
+        }
+
+        for (ssize_t off = 0; off < n; ) {
+            if (wait_ready(out, POLLOUT) < 0) goto fail;
+            ssize_t w = write(out, buf + off, (size_t)(n - off));
+            if (w < 0) {
+                if (errno == EINTR || errno == EAGAIN) continue;
+                goto fail;
+            }
+            off += w;
+        }
+        total += n;
+    }
+
+    free(buf);
+    return total;
+
+read_fail:
+    *read_failed = 1;
+fail:
+    free(buf);
+    return -1;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * io_relay_ex()
+ *
+ * Copies from in_fd to out_fd until EOF (len < 0) or len bytes, with the
+ * given engine and block size.  IO_ENGINE_AUTO and IO_ENGINE_URING fall back
+ * to poll when io_uring is unavailable (ENOSYS, disabled by sysctl or
+ * seccomp) or when an fd is non-blocking.
+ *
+ * Returns the number of bytes moved, or -1 with errno set; then
+ * *read_failed (if not NULL) tells whether reading in_fd or writing out_fd
+ * failed.
+ * ----------------------------------------------------------------------------- */
+long long io_relay_ex(int in_fd, int out_fd, long long len,
+                      IoEngine engine, size_t block_size, int *read_failed)
+{
+    int dummy;
+    if (read_failed == NULL) read_failed = &dummy;
+    *read_failed = 0;
+
+    if (block_size == 0) block_size = IO_BLOCK_SIZE;
+
+    if (engine != IO_ENGINE_POLL &&
+        !(fcntl(in_fd, F_GETFL) & O_NONBLOCK) && !(fcntl(out_fd, F_GETFL) & O_NONBLOCK)) {
+        long long n = uring_relay(in_fd, out_fd, len, block_size, read_failed);
+        if (n != -2) return n;
+    }
+    return poll_relay(in_fd, out_fd, len, block_size, read_failed);
+}
+
+
+long long io_relay(int in_fd, int out_fd, long long len)
+{
+    return io_relay_ex(in_fd, out_fd, len, IO_ENGINE_AUTO, IO_BLOCK_SIZE, NULL);
+}
@@ -7,18 +7,89 @@
 
 #include "parser.h"
 #include "exec.h"
+#include "options.h"
+#include "trace.h"
+#include "stats.h"
+#include "profile.h"
+#include "server.h"
+#include "pathcache.h"
 
-int main(void) {
+// Input state shared by the prompt loop and the here-document reader.
+typedef struct {
+    char   *buf;
+    size_t  cap;
+} LineInput;
+
+// Lines read from stdin so far (command lines and here-document lines),
+// i.e. the line number of the last line read in a script.
+static int input_lineno = 0;
+
+// LineReader for read_heredocs(): prompt with "> " and return the next
+// stdin line without its newline (NULL at EOF).
+static const char *next_heredoc_line(void *ctx) {
+    LineInput *in = ctx;
+
+    printf("> ");
+    fflush(stdout);
+
+    ssize_t nread = getline(&in->buf, &in->cap, stdin);
+    if (nread < 0) return NULL;
+    input_lineno++;
+    if (nread > 0 && in->buf[nread - 1] == '\n') in->buf[nread - 1] = '\0';
+    return in->buf;
+}
+
+int main(int argc, char **argv) {
     char *line = NULL;
     size_t cap = 0;
+    LineInput heredoc_in = { NULL, 0 };
+    const char *server_sock = NULL;
+
+    options_init();
+
+    // Command-line flags (override the environment)
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0) {
+            if (shell_opts.profile == PROFILE_OFF) shell_opts.profile = PROFILE_REPORT;
+        } else if (strcmp(argv[i], "--server") == 0 && i + 2 == argc) {
+            server_sock = argv[++i];
+        } else if (strcmp(argv[i], "--client") == 0 && i + 2 < argc &&
+                   argv[i + 2 + (strcmp(argv[i + 2], "-t") == 0)] != NULL) {
+            int timing = strcmp(argv[i + 2], "-t") == 0;
+            return client_main(argv[i + 1], timing, &argv[i + 2 + timing]);
+        } else {
+            fprintf(stderr, "usage: %s [-p] | --server SOCKET | --client SOCKET [-t] command...\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (shell_opts.trace_path != NULL) (void)trace_init(shell_opts.trace_path);
+    if (shell_opts.path_cache && shell_opts.path_cache_file != NULL) {
+        pathcache_open(shell_opts.path_cache_file);
+    }
+
+    // The server's runners resolve commands through the same shared cache
+    if (server_sock != NULL) {
+        int rc = server_main(server_sock);
+        trace_close();
+        return rc;
+    }
 
     while (1) {
+        // One trace write per command line (no-op unless MYSHELL_TRACE is set)
+        trace_flush();
+        if (shell_opts.profile) profile_line_end();
+
         // Prompt
         printf("$ ");
         fflush(stdout);
 
         // Read line (EOF/Ctrl-D => exit)
+        long long t0 = trace_on ? trace_now() : 0;
         ssize_t nread = getline(&line, &cap, stdin);
+        long long t1 = stats_now();
+        if (trace_on) trace_span("getline", t0, t1, 0, NULL);
+        if (nread >= 0) input_lineno++;
         if (nread < 0) {
             printf("\n");
             break;
@@ -38,33 +109,62 @@ int main(void) {
             }
         }
         if (only_ws) continue;
+        stats_line_read(t1);
 
         // Built-in: exit
         if (strcmp(line, "exit") == 0) {
             break;
         }
 
-        // Parse
-        Pipeline pl;
+        // Parse the whole line (pipelines joined by ; && ||) once
+        CommandList cl;
         char errbuf[256];
 
-        int rc = parse_line(line, &pl, errbuf, sizeof(errbuf));
+        if (shell_opts.profile) profile_line_begin(input_lineno, line);
+
+        t0 = stats_now();
+        int rc = parse_list(line, &cl, errbuf, sizeof(errbuf));
+        t1 = stats_now();
+        shell_stats.parses++;
+        hist_record(&shell_stats.parse_ns, t1 - t0);
+        if (shell_opts.profile) profile_parse(t1 - t0);
+        if (trace_on) trace_span("parse_line", t0, t1, 0, line);
         if (rc != 0) {
             // Print syntax/validation error if provided
             if (errbuf[0] != '\0') {
                 fprintf(stderr, "%s\n", errbuf);
             }
-            free_pipeline(&pl);
+            free_list(&cl);
+            continue;
+        }
+
+        // Here-document bodies follow the command line on stdin
+        for (int i = 0; i < cl.n_nodes; i++) {
+            rc = read_heredocs(&cl.nodes[i].pl, next_heredoc_line, &heredoc_in,
+                               errbuf, sizeof(errbuf));
+            if (rc != 0) break;
+        }
+        if (rc != 0) {
+            fprintf(stderr, "%s\n", errbuf);
+            free_list(&cl);
             continue;
         }
 
-        // Execute (validated) pipeline
-        (void)execute_pipeline(&pl);
+        // Execute (validated) command list
+        t0 = trace_on ? trace_now() : 0;
+        (void)execute_list(&cl);
+        if (trace_on) trace_span("command", t0, trace_now(), 0, line);
 
         // Cleanup
-        free_pipeline(&pl);
+        free_list(&cl);
     }
 
+    if (shell_opts.profile) {
+        profile_line_end();
+        profile_report(shell_opts.profile);
+    }
+    trace_close();
     free(line);
+    free(heredoc_in.buf);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,890 @@
+/* =============================================================================
+ * src/memo.c  –  'memo' prefix: reuse results of deterministic pipelines
+ *
+ *   memo sort < big.txt > sorted.txt
+ *   memo grep -c ERROR app.log
+ *
+ * runs the pipeline once and stores its stdout and its '>' output files;
+ * later runs with the same key restore them instead of running anything.
+ * Only successful runs (status 0) are stored.  Stderr is not stored.
+ *
+ * Key (256-bit BLAKE2b) of:
+ *   - the current directory and the variables named by MYSHELL_MEMO_ENV
+ *   - every command's argv; for argv[0] the identity (dev, inode, size,
+ *     mtime) of the program found through PATH, so an upgrade invalidates
+ *   - every redirection (kind, fds, path, here-document body)
+ *   - a fingerprint of every input file: '<' files and argv words naming
+ *     existing regular files or directories
+ *
+ * A file's fingerprint is the hash of its content.  It is remembered per
+ * (device, inode) together with size, mtime and ctime, so an unchanged
+ * 50 GB input is hashed once, not on every run (like git's index).  A
+ * directory's is the hash of its sorted entry names, each with its type,
+ * size and mtime: one level, what 'ls d' sees, not the files' content.
+ *
+ * Stdin that is not redirected is not part of the key: 'memo' asserts
+ * the pipeline only reads what it names.  Pipelines with '>>' outputs,
+ * process substitutions or builtins, and those reading a '<' input that is
+ * not a regular file, just run normally.
+ *
+ * Store (MYSHELL_MEMO_DIR, else $XDG_CACHE_HOME/myshell/memo, else
+ * ~/.cache/myshell/memo):
+ *
+ *   objects/<hash>   content-addressed blobs (stdout, output files)
+ *   entries/<key>    manifest: status, outputs and the blobs that hold them
+ *   files/<dev>-<ino> remembered fingerprints
+ *
+ * Blobs and manifests are written under a temporary name and rename()d,
+ * so a concurrent shell sees either nothing or a complete entry.
+ * Restores go through copy_fd() (reflink where the filesystem can).
+ *
+ * Eviction: once the entries reference more than MYSHELL_MEMO_MAX_MB
+ * (0 = unlimited), entries are dropped least recently used first
+ * (MYSHELL_MEMO_EVICT=lru, a hit touches the manifest) or oldest first
+ * (fifo), then blobs no entry references are deleted.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // pipe2(), mkostemp(), O_CLOEXEC
+
+#include <stdio.h>      // fprintf(), snprintf(), fopen(), fgets()
+#include <stdlib.h>     // malloc(), free(), getenv(), qsort(), bsearch()
+#include <string.h>     // strcmp(), strlen(), memcpy(), strdup()
+#include <stdint.h>     // uint64_t
+#include <errno.h>      // errno
+#include <fcntl.h>      // open(), O_* flags
+#include <unistd.h>     // read(), write(), close(), getcwd(), unlink(), rename()
+#include <dirent.h>     // opendir(), readdir(), dirfd()
+#include <time.h>       // time()
+#include <limits.h>     // PATH_MAX
+#include <sys/stat.h>   // stat(), fstat(), fstatat(), utimensat()
+#include "memo.h"
+#include "exec.h"       // start_pipeline(), wait_job(), execute_pipeline(), copy_fd()
+#include "options.h"    // shell_opts.memo_*, options_user_dir(), mkdir_p()
+#include "builtin.h"    // find_builtin()
+#include "pathcache.h"  // pathcache_lookup()
+#include "blake2b.h"    // blake2b_*()
+
+#define HASH_BYTES  32              /* BLAKE2b-256 */
+#define HEX_LEN     (2 * HASH_BYTES)
+#define MEMO_CHUNK  (1 << 20)       /* bytes per read() while hashing / relaying */
+#define STALE_TMP_S (24 * 3600)     /* leftover temporaries older than this are removed */
+
+
+/* -----------------------------------------------------------------------------
+ * 256-bit BLAKE2b over everything that makes up a key or a blob
+ * ----------------------------------------------------------------------------- */
+
+typedef Blake2b MemoHash;
+
+static void mh_init(MemoHash *s)
+{
+    blake2b_init(s, HASH_BYTES);
+}
+
+static void mh_update(MemoHash *s, const void *data, size_t n)
+{
+    blake2b_update(s, data, n);
+}
+
+static void mh_str(MemoHash *s, const char *str)
+{
+    mh_update(s, str, strlen(str) + 1);
+}
+
+static void mh_u64(MemoHash *s, uint64_t v)
+{
+    mh_update(s, &v, sizeof(v));
+}
+
+static void mh_final(MemoHash *s, char hex[HEX_LEN + 1])
+{
+    static const char digits[] = "0123456789abcdef";
+    unsigned char out[HASH_BYTES];
+
+    blake2b_final(s, out);
+    for (int i = 0; i < HASH_BYTES; i++) {
+        hex[2 * i] = digits[out[i] >> 4];
+        hex[2 * i + 1] = digits[out[i] & 15];
+    }
+    hex[HEX_LEN] = '\0';
+}
+
+/* Hashes fd from its current offset to EOF */
+static int hash_fd(int fd, MemoHash *h)
+{
+    char *buf = malloc(MEMO_CHUNK);
+    ssize_t n;
+
+    if (buf == NULL) return -1;
+    while ((n = read(fd, buf, MEMO_CHUNK)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(buf);
+            return -1;
+        }
+        mh_update(h, buf, (size_t)n);
+    }
+    free(buf);
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Store
+ * ----------------------------------------------------------------------------- */
+
+static char store[PATH_MAX / 2]; /* root directory, "" until store_init() */
+
+static int store_init(void)
+{
+    static const char *subdirs[] = { "objects", "entries", "files" };
+    char path[PATH_MAX];
+
+    if (store[0] != '\0') return 0;
+
+    if (options_user_dir(store, sizeof(store), shell_opts.memo_dir, "XDG_CACHE_HOME", ".cache", "memo") < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s/%s", store, subdirs[i]);
+        if (mkdir_p(path) < 0) {
+            fprintf(stderr, "memo: %s: %s\n", path, strerror(errno));
+            store[0] = '\0';
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Opens a new temporary file in dir ("objects", "entries", "files") */
+static int store_tmp(const char *dir, char *path, size_t sz)
+{
+    snprintf(path, sz, "%s/%s/.tmp.XXXXXX", store, dir);
+    return mkostemp(path, O_CLOEXEC);
+}
+
+/* Moves tmp to objects/<hex> unless that blob already exists */
+static void store_blob(const char *tmp, const char *hex)
+{
+    char path[PATH_MAX];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/objects/%s", store, hex);
+    if (stat(path, &st) == 0 || rename(tmp, path) < 0) unlink(tmp);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Input fingerprints
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+    int64_t size;
+    int64_t mtime_ns;
+    int64_t ctime_ns;
+    char    hex[HEX_LEN + 1];
+} FileRecord;
+
+static int64_t ts_ns(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+/* Content hash of the regular file path (st: its stat), remembered per inode */
+static int fingerprint(const char *path, const struct stat *st, char hex[HEX_LEN + 1])
+{
+    char rec_path[PATH_MAX], tmp[PATH_MAX];
+    FileRecord rec;
+    MemoHash h;
+
+    snprintf(rec_path, sizeof(rec_path), "%s/files/%llx-%llx", store,
+             (unsigned long long)st->st_dev, (unsigned long long)st->st_ino);
+
+    int fd = open(rec_path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ssize_t n = read(fd, &rec, sizeof(rec));
+        close(fd);
+        if (n == (ssize_t)sizeof(rec) && rec.size == (int64_t)st->st_size &&
+            rec.mtime_ns == ts_ns(&st->st_mtim) && rec.ctime_ns == ts_ns(&st->st_ctim) &&
+            rec.hex[HEX_LEN] == '\0') {
+            memcpy(hex, rec.hex, HEX_LEN + 1);
+            return 0;
+        }
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    mh_init(&h);
+    int rc = hash_fd(fd, &h);
+    close(fd);
+    if (rc < 0) return -1;
+    mh_final(&h, hex);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.size = (int64_t)st->st_size;
+    rec.mtime_ns = ts_ns(&st->st_mtim);
+    rec.ctime_ns = ts_ns(&st->st_ctim);
+    memcpy(rec.hex, hex, HEX_LEN + 1);
+    fd = store_tmp("files", tmp, sizeof(tmp));
+    if (fd >= 0) {
+        int ok = write(fd, &rec, sizeof(rec)) == (ssize_t)sizeof(rec);
+        close(fd);
+        if (!ok || rename(tmp, rec_path) < 0) unlink(tmp);
+    }
+    return 0;
+}
+
+
+static int by_name(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Hash of the directory path's listing: sorted names, each with lstat() data */
+static int fingerprint_dir(const char *path, char hex[HEX_LEN + 1])
+{
+    char **names = NULL;
+    int n = 0, cap = 0, rc = -1;
+    MemoHash h;
+
+    DIR *d = opendir(path);
+    if (d == NULL) return -1;
+    for (struct dirent *e; (e = readdir(d)) != NULL; ) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 64;
+            char **tmp = realloc(names, (size_t)cap * sizeof(char *));
+            if (tmp == NULL) goto out;
+            names = tmp;
+        }
+        if ((names[n] = strdup(e->d_name)) == NULL) goto out;
+        n++;
+    }
+    qsort(names, (size_t)n, sizeof(char *), by_name);
+
+    mh_init(&h);
+    mh_str(&h, "dir");
+    for (int i = 0; i < n; i++) {
+        struct stat st;
+        mh_str(&h, names[i]);
+        if (fstatat(dirfd(d), names[i], &st, AT_SYMLINK_NOFOLLOW) < 0) continue;
+        mh_u64(&h, (uint64_t)st.st_mode);
+        mh_u64(&h, (uint64_t)st.st_size);
+        mh_u64(&h, (uint64_t)ts_ns(&st.st_mtim));
+    }
+    mh_final(&h, hex);
+    rc = 0;
+
+out:
+    for (int i = 0; i < n; i++) free(names[i]);
+    free(names);
+    closedir(d);
+    return rc;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Key
+ *
+ * Returns 0 with key set, -1 if p cannot be memoized (*why says why, NULL
+ * when the normal run will report the problem itself).
+ * ----------------------------------------------------------------------------- */
+static int build_key(const Pipeline *p, char key[HEX_LEN + 1], const char **why)
+{
+    char cwd[PATH_MAX], hex[HEX_LEN + 1];
+    struct stat st;
+    MemoHash h;
+
+    *why = NULL;
+    mh_init(&h);
+    mh_str(&h, "memo 2");
+    if (getcwd(cwd, sizeof(cwd)) == NULL) return -1;
+    mh_str(&h, cwd);
+
+    /* Selected environment, names separated by spaces or commas */
+    for (const char *s = shell_opts.memo_env; *s; ) {
+        size_t n = strcspn(s, " ,");
+        if (n > 0 && n < 128) {
+            char name[128];
+            memcpy(name, s, n);
+            name[n] = '\0';
+            const char *v = getenv(name);
+            mh_str(&h, name);
+            mh_str(&h, v ? v : "\001unset");
+        }
+        s += n;
+        s += strspn(s, " ,");
+    }
+
+    for (int i = 0; i < p->n_cmds; i++) {
+        const Command *c = &p->cmds[i];
+
+        if (c->n_psubs > 0) {
+            *why = "process substitution";
+            return -1;
+        }
+        if (find_builtin(c->argv[0]) != NULL) {
+            *why = "builtin";
+            return -1;
+        }
+        mh_str(&h, "|");
+
+        /* The program itself: where PATH finds it, and which version */
+        const char *exe = strchr(c->argv[0], '/') ? c->argv[0] : pathcache_lookup(c->argv[0]);
+        if (exe != NULL && stat(exe, &st) == 0) {
+            mh_str(&h, exe);
+            mh_u64(&h, (uint64_t)st.st_dev);
+            mh_u64(&h, (uint64_t)st.st_ino);
+            mh_u64(&h, (uint64_t)st.st_size);
+            mh_u64(&h, (uint64_t)ts_ns(&st.st_mtim));
+        }
+
+        for (int k = 0; c->argv[k] != NULL; k++) {
+            mh_str(&h, c->argv[k]);
+            if (k == 0 || stat(c->argv[k], &st) < 0) continue;
+            if (S_ISREG(st.st_mode)) {
+                if (fingerprint(c->argv[k], &st, hex) < 0) return -1;
+                mh_str(&h, hex);
+            } else if (S_ISDIR(st.st_mode)) {
+                if (fingerprint_dir(c->argv[k], hex) < 0) return -1;
+                mh_str(&h, hex);
+            }
+        }
+
+        for (int j = 0; j < c->n_redirs; j++) {
+            const Redir *r = &c->redirs[j];
+
+            mh_u64(&h, (uint64_t)r->kind);
+            mh_u64(&h, (uint64_t)(int64_t)r->fd);
+            mh_u64(&h, (uint64_t)(int64_t)r->src_fd);
+            mh_str(&h, r->path ? r->path : "");
+            if (r->body != NULL) mh_update(&h, r->body, r->body_len);
+
+            if (r->kind == REDIR_APPEND) {
+                *why = "'>>' output";
+                return -1;
+            }
+            if (r->kind == REDIR_IN) {
+                if (stat(r->path, &st) < 0) return -1;
+                if (!S_ISREG(st.st_mode)) {
+                    *why = "input is not a regular file";
+                    return -1;
+                }
+                if (fingerprint(r->path, &st, hex) < 0) return -1;
+                mh_str(&h, hex);
+            }
+        }
+    }
+
+    mh_final(&h, key);
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Manifests
+ *
+ *   memo 2
+ *   created <ns>
+ *   status <n>
+ *   bytes <n>                  total size of the blobs below
+ *   stdout <hash> <len>
+ *   file <hash|-> <len> <path> '-': not a regular file, only opened
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+    char       hex[HEX_LEN + 1];
+    long long  len;
+    char      *path;            /* NULL: stdout */
+} MemoOutput;
+
+typedef struct {
+    int         status;
+    long long   created;
+    long long   bytes;
+    MemoOutput *out;
+    int         n_out;
+} Manifest;
+
+static void free_manifest(Manifest *m)
+{
+    for (int i = 0; i < m->n_out; i++) free(m->out[i].path);
+    free(m->out);
+    m->out = NULL;
+    m->n_out = 0;
+}
+
+static int add_output(Manifest *m, const char *hex, long long len, const char *path)
+{
+    MemoOutput *tmp = realloc(m->out, (size_t)(m->n_out + 1) * sizeof(MemoOutput));
+    if (tmp == NULL) return -1;
+    m->out = tmp;
+
+    MemoOutput *o = &m->out[m->n_out];
+    snprintf(o->hex, sizeof(o->hex), "%s", hex);
+    o->len = len;
+    o->path = NULL;
+    if (path != NULL && (o->path = strdup(path)) == NULL) return -1;
+    m->n_out++;
+    return 0;
+}
+
+/* A blob name, or "-" for an output that is not a regular file */
+static int valid_hex(const char *hex)
+{
+    return strcmp(hex, "-") == 0 || strlen(hex) == HEX_LEN;
+}
+
+static int read_manifest(const char *path, Manifest *m)
+{
+    char line[PATH_MAX + 128], hex[HEX_LEN + 2];
+    long long len;
+    int n, ok = 0;
+
+    memset(m, 0, sizeof(*m));
+    FILE *f = fopen(path, "re");
+    if (f == NULL) return -1;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (strcmp(line, "memo 2") == 0) ok = 1;
+        else if (sscanf(line, "created %lld", &m->created) == 1) {}
+        else if (sscanf(line, "status %d", &m->status) == 1) {}
+        else if (sscanf(line, "bytes %lld", &m->bytes) == 1) {}
+        else if (sscanf(line, "stdout %65s %lld", hex, &len) == 2) {
+            if (!valid_hex(hex) || add_output(m, hex, len, NULL) < 0) ok = 0;
+        } else if (sscanf(line, "file %65s %lld %n", hex, &len, &n) == 2) {
+            if (!valid_hex(hex) || add_output(m, hex, len, line + n) < 0) ok = 0;
+        }
+    }
+    fclose(f);
+
+    if (!ok) {
+        free_manifest(m);
+        return -1;
+    }
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Hit: restore the outputs of m
+ * ----------------------------------------------------------------------------- */
+static int restore(const Manifest *m)
+{
+    char path[PATH_MAX];
+    int *blob = malloc((size_t)(m->n_out ? m->n_out : 1) * sizeof(int));
+    int rc = -1, i;
+
+    if (blob == NULL) return -1;
+
+    /* Every blob must still be there, at its recorded size, before
+     * anything is touched */
+    for (i = 0; i < m->n_out; i++) {
+        struct stat st;
+
+        blob[i] = -1;
+        if (strcmp(m->out[i].hex, "-") == 0) continue;
+        snprintf(path, sizeof(path), "%s/objects/%s", store, m->out[i].hex);
+        blob[i] = open(path, O_RDONLY | O_CLOEXEC);
+        if (blob[i] < 0) goto out;
+        if (fstat(blob[i], &st) < 0 || st.st_size != (off_t)m->out[i].len) {
+            unlink(path);                       /* damaged: the rerun stores it anew */
+            i++;                                /* close this one too */
+            goto out;
+        }
+    }
+
+    fflush(stdout);
+    for (i = 0; i < m->n_out; i++) {
+        const MemoOutput *o = &m->out[i];
+        struct stat in_st, out_st;
+        int read_failed;
+
+        if (o->path == NULL) {
+            /* stdout may be a file mid-way: no reflink, keep its offset */
+            if (fstat(blob[i], &in_st) < 0 || fstat(STDOUT_FILENO, &out_st) < 0 ||
+                copy_fd(blob[i], STDOUT_FILENO, &in_st, &out_st, 1, &read_failed) < 0) {
+                perror("memo: stdout");
+            }
+            continue;
+        }
+
+        int fd = open(o->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            perror(o->path);
+            continue;
+        }
+        if (blob[i] >= 0 && (fstat(blob[i], &in_st) < 0 || fstat(fd, &out_st) < 0 ||
+                             copy_fd(blob[i], fd, &in_st, &out_st, 0, &read_failed) < 0)) {
+            perror(o->path);
+        }
+        close(fd);
+    }
+    rc = 0;
+
+out:
+    for (int k = 0; k < i && k < m->n_out; k++) {
+        if (blob[k] >= 0) close(blob[k]);
+    }
+    free(blob);
+    return rc;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Miss: run p with stdout relayed to ours and into a blob
+ * ----------------------------------------------------------------------------- */
+
+static int write_all(int fd, const char *buf, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(fd, buf, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        buf += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Returns the exit status; *blob_fd is closed (-1) if the copy failed */
+static int run_capture(const Pipeline *p, int *blob_fd, MemoHash *h, long long *len)
+{
+    int pfd[2];
+    Job job;
+    int out_ok = 1;
+
+    if (pipe2(pfd, O_CLOEXEC) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    fflush(stdout);
+    if (start_pipeline(p, -1, pfd[1], &job) < 0) {
+        close(pfd[0]);
+        close(pfd[1]);
+        return -1;
+    }
+    close(pfd[1]);
+
+    char *buf = malloc(MEMO_CHUNK);
+    ssize_t n;
+    *len = 0;
+    while (buf != NULL && (n = read(pfd[0], buf, MEMO_CHUNK)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (out_ok && write_all(STDOUT_FILENO, buf, (size_t)n) < 0) out_ok = 0;
+        if (*blob_fd >= 0 && write_all(*blob_fd, buf, (size_t)n) < 0) {
+            close(*blob_fd);
+            *blob_fd = -1;
+        }
+        mh_update(h, buf, (size_t)n);
+        *len += n;
+    }
+    free(buf);
+    close(pfd[0]);
+
+    int status = wait_job(&job);
+    if (!out_ok && *blob_fd >= 0) {
+        close(*blob_fd);
+        *blob_fd = -1;
+    }
+    return status;
+}
+
+/* Copies the regular file path into a blob; hex "-" if it is not one */
+static int store_output(const char *path, char hex[HEX_LEN + 1], long long *len)
+{
+    char tmp[PATH_MAX];
+    struct stat st, tst;
+    MemoHash h;
+    int read_failed;
+
+    strcpy(hex, "-");
+    *len = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+
+    mh_init(&h);
+    if (hash_fd(fd, &h) < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+        close(fd);
+        return -1;
+    }
+    mh_final(&h, hex);
+    *len = (long long)st.st_size;
+
+    int out = store_tmp("objects", tmp, sizeof(tmp));
+    int rc = -1;
+    if (out >= 0 && fstat(out, &tst) == 0 && copy_fd(fd, out, &st, &tst, 0, &read_failed) == 0) {
+        rc = 0;
+    }
+    if (out >= 0) close(out);
+    close(fd);
+    if (rc == 0) store_blob(tmp, hex);
+    else if (out >= 0) unlink(tmp);
+    return rc;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Eviction
+ * ----------------------------------------------------------------------------- */
+
+typedef struct {
+    char      name[HEX_LEN + 1];
+    long long when;             /* LRU: manifest mtime, FIFO: created */
+    long long bytes;
+} EntryInfo;
+
+static int by_when(const void *a, const void *b)
+{
+    const EntryInfo *x = a, *y = b;
+    return (x->when > y->when) - (x->when < y->when);
+}
+
+static int by_hex(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+/* Deletes blobs that no remaining entry references (and stale temporaries) */
+static void collect_blobs(const EntryInfo *keep, int n_keep)
+{
+    char (*live)[HEX_LEN + 1] = NULL;
+    int n_live = 0, cap = 0;
+    char path[PATH_MAX];
+    Manifest m;
+
+    for (int i = 0; i < n_keep; i++) {
+        snprintf(path, sizeof(path), "%s/entries/%s", store, keep[i].name);
+        if (read_manifest(path, &m) < 0) continue;
+        for (int k = 0; k < m.n_out; k++) {
+            if (n_live == cap) {
+                cap = cap ? 2 * cap : 64;
+                void *tmp = realloc(live, (size_t)cap * sizeof(*live));
+                if (tmp == NULL) {
+                    free_manifest(&m);
+                    free(live);
+                    return;
+                }
+                live = tmp;
+            }
+            memcpy(live[n_live++], m.out[k].hex, HEX_LEN + 1);
+        }
+        free_manifest(&m);
+    }
+    qsort(live, (size_t)n_live, sizeof(*live), by_hex);
+
+    snprintf(path, sizeof(path), "%s/objects", store);
+    DIR *d = opendir(path);
+    if (d == NULL) {
+        free(live);
+        return;
+    }
+    time_t now = time(NULL);
+    for (struct dirent *e; (e = readdir(d)) != NULL; ) {
+        struct stat st;
+        if (e->d_name[0] == '.' && strncmp(e->d_name, ".tmp.", 5) != 0) continue;
+        snprintf(path, sizeof(path), "%s/objects/%s", store, e->d_name);
+        if (e->d_name[0] == '.') {
+            if (stat(path, &st) == 0 && now - st.st_mtime > STALE_TMP_S) unlink(path);
+        } else if (live == NULL || bsearch(e->d_name, live, (size_t)n_live, sizeof(*live), by_hex) == NULL) {
+            unlink(path);
+        }
+    }
+    closedir(d);
+    free(live);
+}
+
+static void evict(void)
+{
+    long long max = (long long)shell_opts.memo_max_mb << 20;
+    EntryInfo *ents = NULL;
+    int n = 0, cap = 0;
+    long long total = 0;
+    char path[PATH_MAX];
+
+    if (max <= 0) return;
+
+    snprintf(path, sizeof(path), "%s/entries", store);
+    DIR *d = opendir(path);
+    if (d == NULL) return;
+    for (struct dirent *e; (e = readdir(d)) != NULL; ) {
+        struct stat st;
+        Manifest m;
+
+        if (e->d_name[0] == '.' || strlen(e->d_name) != HEX_LEN) continue;
+        snprintf(path, sizeof(path), "%s/entries/%s", store, e->d_name);
+        if (stat(path, &st) < 0 || read_manifest(path, &m) < 0) continue;
+        if (n == cap) {
+            cap = cap ? 2 * cap : 64;
+            EntryInfo *tmp = realloc(ents, (size_t)cap * sizeof(EntryInfo));
+            if (tmp == NULL) {
+                free_manifest(&m);
+                break;
+            }
+            ents = tmp;
+        }
+        memcpy(ents[n].name, e->d_name, HEX_LEN + 1);
+        ents[n].when = shell_opts.memo_evict == MEMO_EVICT_FIFO ? m.created : (long long)ts_ns(&st.st_mtim);
+        ents[n].bytes = m.bytes;
+        total += m.bytes;
+        n++;
+        free_manifest(&m);
+    }
+    closedir(d);
+
+    if (total > max) {
+        int first = 0;
+        qsort(ents, (size_t)n, sizeof(EntryInfo), by_when);
+        while (first < n && total > max) {
+            snprintf(path, sizeof(path), "%s/entries/%s", store, ents[first].name);
+            unlink(path);
+            total -= ents[first].bytes;
+            first++;
+        }
+        collect_blobs(ents + first, n - first);
+    }
+    free(ents);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Entry points
+ * ----------------------------------------------------------------------------- */
+
+int memo_prefixed(const Pipeline *p)
+{
+    return p != NULL && p->n_cmds > 0 && strcmp(p->cmds[0].argv[0], "memo") == 0;
+}
+
+
+/* Stores a successful run under key: stdout blob from tmp, then every '>' file */
+static void store_entry(const Pipeline *p, const char *key, const char *stdout_tmp,
+                        const char *stdout_hex, long long stdout_len)
+{
+    char path[PATH_MAX], tmp[PATH_MAX], hex[HEX_LEN + 1];
+    long long len, bytes = stdout_len;
+    Manifest m;
+
+    memset(&m, 0, sizeof(m));
+    store_blob(stdout_tmp, stdout_hex);
+    if (add_output(&m, stdout_hex, stdout_len, NULL) < 0) goto out;
+
+    /* Output files in order; a path written twice is stored once (its final content) */
+    for (int i = 0; i < p->n_cmds; i++) {
+        const Command *c = &p->cmds[i];
+        for (int j = 0; j < c->n_redirs; j++) {
+            const Redir *r = &c->redirs[j];
+            int seen = 0;
+
+            if (r->kind != REDIR_OUT) continue;
+            if (strchr(r->path, '\n') != NULL) goto out;
+            for (int k = 0; k < m.n_out; k++) {
+                if (m.out[k].path != NULL && strcmp(m.out[k].path, r->path) == 0) seen = 1;
+            }
+            if (seen) continue;
+            if (store_output(r->path, hex, &len) < 0 || add_output(&m, hex, len, r->path) < 0) goto out;
+            bytes += len;
+        }
+    }
+
+    int fd = store_tmp("entries", tmp, sizeof(tmp));
+    if (fd < 0) goto out;
+    FILE *f = fdopen(fd, "w");
+    if (f == NULL) {
+        close(fd);
+        unlink(tmp);
+        goto out;
+    }
+    fprintf(f, "memo 2\ncreated %lld\nstatus 0\nbytes %lld\n", (long long)time(NULL) * 1000000000LL, bytes);
+    for (int k = 0; k < m.n_out; k++) {
+        if (m.out[k].path == NULL) fprintf(f, "stdout %s %lld\n", m.out[k].hex, m.out[k].len);
+        else fprintf(f, "file %s %lld %s\n", m.out[k].hex, m.out[k].len, m.out[k].path);
+    }
+    snprintf(path, sizeof(path), "%s/entries/%s", store, key);
+    if (fclose(f) != 0 || rename(tmp, path) < 0) unlink(tmp);
+
+    evict();
+
+out:
+    free_manifest(&m);
+}
+
+
+int memo_execute(const Pipeline *p)
+{
+    char key[HEX_LEN + 1], path[PATH_MAX], tmp[PATH_MAX], hex[HEX_LEN + 1];
+    const char *why = NULL;
+    Manifest m;
+    int status;
+
+    if (p->cmds[0].argv[1] == NULL) {
+        fprintf(stderr, "usage: memo command [args...] [| command ...]\n");
+        return 2;
+    }
+
+    /* The same pipeline without the prefix */
+    Pipeline stripped = { malloc((size_t)p->n_cmds * sizeof(Command)), p->n_cmds };
+    if (stripped.cmds == NULL) {
+        perror("malloc (memo)");
+        return -1;
+    }
+    memcpy(stripped.cmds, p->cmds, (size_t)p->n_cmds * sizeof(Command));
+    stripped.cmds[0].argv = p->cmds[0].argv + 1;
+
+    if (store_init() < 0) why = "no store directory";
+    if (why != NULL || build_key(&stripped, key, &why) < 0) {
+        if (why != NULL) fprintf(stderr, "memo: not cached (%s)\n", why);
+        status = execute_pipeline(&stripped);
+        free(stripped.cmds);
+        return status;
+    }
+
+    /* Hit */
+    snprintf(path, sizeof(path), "%s/entries/%s", store, key);
+    if (read_manifest(path, &m) == 0) {
+        int rc = restore(&m);
+        status = m.status;
+        free_manifest(&m);
+        if (rc == 0) {
+            utimensat(AT_FDCWD, path, NULL, 0);     /* recently used */
+            free(stripped.cmds);
+            return status;
+        }
+        unlink(path);                               /* a blob is gone */
+    }
+
+    /* Miss: run it, keeping a copy of stdout */
+    MemoHash h;
+    long long len;
+    int blob = store_tmp("objects", tmp, sizeof(tmp));
+    int have_tmp = blob >= 0;
+
+    mh_init(&h);
+    status = run_capture(&stripped, &blob, &h, &len);
+    if (blob >= 0) {
+        close(blob);
+        if (status == 0) {
+            mh_final(&h, hex);
+            store_entry(&stripped, key, tmp, hex, len);
+        } else {
+            unlink(tmp);
+        }
+    } else if (have_tmp) {
+        unlink(tmp);
+    }
+
+    free(stripped.cmds);
+    return status;
+}
@@ -0,0 +1,260 @@
+/* =============================================================================
+ * src/monitor.c  –  Pipe bottleneck detector (MYSHELL_MONITOR=ms)
+ *
+ * In a pipeline limited by one slow stage, the pipe in front of that stage
+ * stays full and the pipe behind it stays empty.  With MYSHELL_MONITOR set
+ * to a period in milliseconds, the shell samples the fill level of every
+ * pipe of a running pipeline with ioctl(FIONREAD) on each timer tick and,
+ * when the pipeline ends, prints per pipe the mean fill and how often it was
+ * full or empty, followed by a verdict:
+ *
+ *   monitor: 42 samples every 10 ms
+ *     pipe 0 (cat -> gzip): mean fill  97%, full  93%, empty   0%
+ *     pipe 1 (gzip -> wc):  mean fill   1%, full   0%, empty  88%
+ *   monitor: stage 1 (gzip) is the bottleneck
+ *
+ * Design notes:
+ *   - The data path is untouched: the shell only holds CLOEXEC duplicates
+ *     of the read ends and never reads from them.
+ *   - A duplicate read end is a reader reference, which would keep a writer
+ *     from ever getting SIGPIPE/EPIPE.  Each one is therefore closed the
+ *     moment its real reader stage exits, detected through a pidfd in the
+ *     same poll() as the timerfd.  Without pidfd_open() the monitor is off.
+ *   - With MYSHELL_TRACE set too, the trace's pidfds and pipes are polled in
+ *     the same loop, so its exit and first-byte times are not held back
+ *     until the monitor is done.
+ *   - A stage is scored by  fill(input) * (1 - fill(output)) ; the first
+ *     stage counts as having a full input and the last an empty output.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     /* syscall(), F_DUPFD_CLOEXEC, F_GETPIPE_SZ */
+
+#include <stdio.h>      /* fprintf() */
+#include <stdlib.h>     /* calloc(), free() */
+#include <errno.h>      /* errno, EINTR */
+#include <fcntl.h>      /* fcntl() */
+#include <poll.h>       /* poll() */
+#include <unistd.h>     /* close(), read(), syscall() */
+#include <sys/ioctl.h>  /* ioctl(), FIONREAD */
+#include <sys/syscall.h> /* SYS_pidfd_open */
+#include <sys/timerfd.h> /* timerfd_create(), timerfd_settime() */
+#include "monitor.h"
+#include "trace.h"      /* trace_on, trace_poll_fds(), trace_poll_events() */
+
+/* Fill level counted as "full": less than one page of room left */
+#define FULL_SLACK 4096
+
+typedef struct {
+    int       fd;           /* duplicate read end, -1 once dropped */
+    int       cap;          /* pipe capacity in bytes */
+    long      samples;
+    long      n_full;
+    long      n_empty;
+    double    sum_fill;     /* sum of fill fractions */
+} MonPipe;
+
+struct PipeMonitor {
+    const Pipeline *p;
+    int       n_stages;
+    int      *pidfds;       /* per stage, -1 once it exited */
+    MonPipe  *pipes;        /* pipes[k] connects stage k to stage k+1 */
+    int       n_pipes;
+    int       timer;
+    int       period_ms;
+    long      ticks;
+};
+
+
+static void monitor_free(PipeMonitor *m)
+{
+    for (int k = 0; k < m->n_pipes; k++) {
+        if (m->pipes[k].fd >= 0) close(m->pipes[k].fd);
+    }
+    for (int i = 0; i < m->n_stages; i++) {
+        if (m->pidfds[i] >= 0) close(m->pidfds[i]);
+    }
+    if (m->timer >= 0) close(m->timer);
+    free(m->pipes);
+    free(m->pidfds);
+    free(m);
+}
+
+
+PipeMonitor *monitor_start(const Pipeline *p, const pid_t *pids,
+                           int (*pipe_fds)[2], int n_pipes, int period_ms)
+{
+#ifndef SYS_pidfd_open
+    (void)p; (void)pids; (void)pipe_fds; (void)n_pipes; (void)period_ms;
+    return NULL;
+#else
+    if (n_pipes <= 0 || period_ms <= 0) return NULL;
+
+    PipeMonitor *m = calloc(1, sizeof(PipeMonitor));
+    if (m == NULL) return NULL;
+    m->p         = p;
+    m->n_stages  = n_pipes + 1;
+    m->n_pipes   = n_pipes;
+    m->period_ms = period_ms;
+    m->pidfds    = malloc((size_t)m->n_stages * sizeof(int));
+    m->pipes     = calloc((size_t)n_pipes, sizeof(MonPipe));
+    m->timer     = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (m->pidfds == NULL || m->pipes == NULL) {
+        m->n_stages = 0;
+        m->n_pipes  = 0;
+        monitor_free(m);
+        return NULL;
+    }
+    for (int i = 0; i < m->n_stages; i++) m->pidfds[i] = -1;
+    for (int k = 0; k < n_pipes; k++) m->pipes[k].fd = -1;
+    if (m->timer < 0) {
+        monitor_free(m);
+        return NULL;
+    }
+
+    /* Every reader must be watchable before any read end is held */
+    for (int i = 0; i < m->n_stages; i++) {
+        m->pidfds[i] = (int)syscall(SYS_pidfd_open, pids[i], 0);
+        if (m->pidfds[i] < 0) {
+            monitor_free(m);
+            return NULL;
+        }
+    }
+    for (int k = 0; k < n_pipes; k++) {
+        m->pipes[k].fd  = fcntl(pipe_fds[k][0], F_DUPFD_CLOEXEC, 0);
+        m->pipes[k].cap = fcntl(pipe_fds[k][0], F_GETPIPE_SZ);
+        if (m->pipes[k].cap <= 0) m->pipes[k].cap = 65536;
+    }
+
+    struct itimerspec its;
+    its.it_interval.tv_sec  = period_ms / 1000;
+    its.it_interval.tv_nsec = (long)(period_ms % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    if (timerfd_settime(m->timer, 0, &its, NULL) < 0) {
+        monitor_free(m);
+        return NULL;
+    }
+    return m;
+#endif
+}
+
+
+/* One tick: record the fill level of every pipe still watched */
+static void sample(PipeMonitor *m)
+{
+    m->ticks++;
+    for (int k = 0; k < m->n_pipes; k++) {
+        MonPipe *mp = &m->pipes[k];
+        int n;
+        if (mp->fd < 0 || ioctl(mp->fd, FIONREAD, &n) < 0) continue;
+
+        mp->samples++;
+        mp->sum_fill += (double)n / (double)mp->cap;
+        if (n == 0) mp->n_empty++;
+        if (n >= mp->cap - FULL_SLACK) mp->n_full++;
+    }
+}
+
+
+static double mean_fill(const MonPipe *mp)
+{
+    return mp->samples ? mp->sum_fill / (double)mp->samples : 0.0;
+}
+
+static double pct(long part, long whole)
+{
+    return whole ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+
+static void report(const PipeMonitor *m)
+{
+    const Command *c = m->p->cmds;
+
+    if (m->ticks == 0) {
+        fprintf(stderr, "monitor: pipeline ended before the first %d ms sample\n",
+                m->period_ms);
+        return;
+    }
+
+    fprintf(stderr, "monitor: %ld samples every %d ms\n", m->ticks, m->period_ms);
+    for (int k = 0; k < m->n_pipes; k++) {
+        const MonPipe *mp = &m->pipes[k];
+        fprintf(stderr, "  pipe %d (%s -> %s): mean fill %3.0f%%, full %3.0f%%, empty %3.0f%%\n",
+                k, c[k].argv[0], c[k + 1].argv[0], 100.0 * mean_fill(mp),
+                pct(mp->n_full, mp->samples), pct(mp->n_empty, mp->samples));
+    }
+
+    int best = -1;
+    double best_score = 0.0;
+    for (int i = 0; i < m->n_stages; i++) {
+        double in  = i > 0 ? mean_fill(&m->pipes[i - 1]) : 1.0;
+        double out = i < m->n_pipes ? mean_fill(&m->pipes[i]) : 0.0;
+        double score = in * (1.0 - out);
+        if (score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    if (best < 0 || best_score < 0.25) {
+        fprintf(stderr, "monitor: no stage dominated (pipes neither full nor starved)\n");
+    } else {
+        fprintf(stderr, "monitor: stage %d (%s) is the bottleneck\n", best, c[best].argv[0]);
+    }
+}
+
+
+void monitor_run(PipeMonitor *m)
+{
+    if (m == NULL) return;
+
+    /* Room for the trace's fds too: one poll() timestamps exits for both */
+    int n_trace = trace_nfds();
+    struct pollfd *pfd = malloc((size_t)(m->n_stages + 1 + n_trace) * sizeof(struct pollfd));
+    int *stage = malloc((size_t)(m->n_stages + 1) * sizeof(int));
+
+    while (pfd != NULL && stage != NULL) {
+        int n = 0;
+
+        pfd[n].fd = m->timer;
+        pfd[n].events = POLLIN;
+        stage[n++] = -1;
+        for (int i = 0; i < m->n_stages; i++) {
+            if (m->pidfds[i] < 0) continue;
+            pfd[n].fd = m->pidfds[i];
+            pfd[n].events = POLLIN;
+            stage[n++] = i;
+        }
+        if (n == 1) break;                  /* every stage has exited */
+        int nt = trace_on ? trace_poll_fds(pfd + n, n_trace) : 0;
+
+        if (poll(pfd, (nfds_t)(n + nt), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (nt > 0) trace_poll_events(pfd + n, nt, trace_now());
+
+        if (pfd[0].revents & POLLIN) {
+            unsigned long long expirations;
+            if (read(m->timer, &expirations, sizeof(expirations)) > 0) sample(m);
+        }
+
+        for (int j = 1; j < n; j++) {
+            if (!(pfd[j].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL))) continue;
+            int i = stage[j];
+            close(m->pidfds[i]);
+            m->pidfds[i] = -1;
+
+            /* Its input pipe has no reader left: drop our reference */
+            if (i > 0 && m->pipes[i - 1].fd >= 0) {
+                close(m->pipes[i - 1].fd);
+                m->pipes[i - 1].fd = -1;
+            }
+        }
+    }
+
+    free(pfd);
+    free(stage);
+    report(m);
+    monitor_free(m);
+}
@@ -0,0 +1,641 @@
+/* =============================================================================
+ * src/msh.c  –  libmyshell: parse and spawn pipelines from other programs
+ *
+ * The public API of include/myshell.h, built with the parser, pipe and
+ * redirection code into libmyshell.a / libmyshell.so (make lib).  It lets
+ * a daemon run "sort -u < in | head -5 > out" directly instead of paying
+ * for /bin/sh -c through system() or popen().
+ *
+ * Reentrancy and thread safety:
+ *   - No global or static state.  msh_parse() builds a private Pipeline and
+ *     copies it into one block from the caller's allocator; a msh_proc is
+ *     one more block from the same allocator.
+ *   - Every descriptor the library creates is O_CLOEXEC from the start
+ *     (pipe2()), so a fork() in another thread never inherits a pipe end
+ *     and keeps a reader from seeing EOF.  Children get their ends through
+ *     dup2(), which clears the flag on the target only.
+ *   - Nothing calls exit(); a child that cannot exec leaves with _exit(127)
+ *     after a single write() to its stderr.
+ *
+ * The shell's own executor (src/exec.c) is not part of the library: it
+ * feeds the global statistics, tracing and profiling of the interactive
+ * shell.  msh_spawn() is the same fork / connect / redirect / exec sequence
+ * without those hooks.
+ *
+ * Scratch memory while parsing still comes from malloc(); only the result
+ * lives in the caller's allocator.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // pipe2(), O_CLOEXEC, splice(), memfd_create()
+
+#include <stdlib.h>     // malloc(), free()
+#include <string.h>     // memcpy(), strlen(), strchr()
+#include <stdio.h>      // snprintf()
+#include <unistd.h>     // fork(), execvp(), dup2(), close(), _exit(), write()
+#include <fcntl.h>      // fcntl(), O_CLOEXEC
+#include <signal.h>     // signal(), sigprocmask(), kill()
+#include <errno.h>      // errno, EINTR
+#include <sys/wait.h>   // waitid(), waitpid()
+#include <sys/syscall.h> // SYS_pidfd_open
+#include <sys/mman.h>   // memfd_create(), MFD_CLOEXEC
+#include <poll.h>       // poll()
+#include "myshell.h"
+#include "exec.h"       // apply_redirections(), connect_pipes_for_child()
+
+#ifndef P_PIDFD
+#define P_PIDFD 3       // waitid() on a pidfd (Linux 5.4)
+#endif
+
+struct msh_pipeline {
+    msh_allocator alloc;
+    Pipeline      pl;       // points into the rest of the block
+};
+
+typedef struct {
+    pid_t pid;
+    int   pidfd;
+    int   reaped;
+    int   status;           // exit code, or 128 + signal
+} Stage;
+
+/* Output of one stream being collected by msh_capture() / msh_pump() */
+typedef struct {
+    int           active;
+    char         *buf;      // caller's buffer
+    size_t        cap;
+    size_t        len;      // bytes in buf (0 in callback mode)
+    msh_output_fn fn;       // callback mode: every chunk read into buf
+    void         *ctx;
+    int           spill_fd; // memfd for what buf cannot hold (-1 until needed)
+    unsigned long long total;
+    int           eof;
+} Capture;
+
+struct msh_proc {
+    msh_allocator alloc;
+    int   in_fd, out_fd, err_fd;
+    Capture cap[2];         // MSH_STDOUT, MSH_STDERR
+    int   n_stages;
+    Stage stages[];
+};
+
+
+static void *default_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return malloc(size);
+}
+
+static void default_free(void *ctx, void *ptr)
+{
+    (void)ctx;
+    free(ptr);
+}
+
+static const msh_allocator default_allocator = { default_alloc, default_free, NULL };
+
+
+/* -----------------------------------------------------------------------------
+ * Parsing
+ * ----------------------------------------------------------------------------- */
+
+#define ALIGN_PTR(n) (((n) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+static size_t str_size(const char *s)
+{
+    return s ? strlen(s) + 1 : 0;
+}
+
+/* Bytes needed to hold p in one block (header included) */
+static size_t block_size(const Pipeline *p)
+{
+    size_t fixed = ALIGN_PTR(sizeof(struct msh_pipeline));
+    size_t strings = 0;
+
+    fixed += ALIGN_PTR((size_t)p->n_cmds * sizeof(Command));
+    for (int i = 0; i < p->n_cmds; i++) {
+        const Command *c = &p->cmds[i];
+        int argc = 0;
+
+        while (c->argv[argc] != NULL) strings += str_size(c->argv[argc++]);
+        fixed += (size_t)(argc + 1) * sizeof(char *);
+        fixed += ALIGN_PTR((size_t)c->n_redirs * sizeof(Redir));
+        for (int j = 0; j < c->n_redirs; j++) {
+            strings += str_size(c->redirs[j].path);
+            if (c->redirs[j].body) strings += c->redirs[j].body_len + 1;
+        }
+    }
+    return fixed + strings;
+}
+
+/* Bump allocation inside the block; strings go last so pointers stay aligned */
+static char *copy_str(char **cursor, const char *s, size_t len)
+{
+    char *d = *cursor;
+    memcpy(d, s, len);
+    d[len] = '\0';
+    *cursor += len + 1;
+    return d;
+}
+
+/* Copies p into dst; staged here-document memfds move to the copy */
+static void copy_pipeline(struct msh_pipeline *dst, Pipeline *p)
+{
+    char *base = (char *)dst;
+    size_t off = ALIGN_PTR(sizeof(struct msh_pipeline));
+    size_t strings = off + ALIGN_PTR((size_t)p->n_cmds * sizeof(Command));
+    char *cursor;
+
+    /* First pass: where the fixed-size arrays end */
+    for (int i = 0; i < p->n_cmds; i++) {
+        const Command *c = &p->cmds[i];
+        int argc = 0;
+        while (c->argv[argc] != NULL) argc++;
+        strings += (size_t)(argc + 1) * sizeof(char *);
+        strings += ALIGN_PTR((size_t)c->n_redirs * sizeof(Redir));
+    }
+    cursor = base + strings;
+
+    dst->pl.n_cmds = p->n_cmds;
+    dst->pl.cmds = (Command *)(base + off);
+    off += ALIGN_PTR((size_t)p->n_cmds * sizeof(Command));
+
+    for (int i = 0; i < p->n_cmds; i++) {
+        Command *c = &p->cmds[i];
+        Command *d = &dst->pl.cmds[i];
+        int argc = 0;
+
+        while (c->argv[argc] != NULL) argc++;
+        d->argv = (char **)(base + off);
+        off += (size_t)(argc + 1) * sizeof(char *);
+        for (int k = 0; k < argc; k++) d->argv[k] = copy_str(&cursor, c->argv[k], strlen(c->argv[k]));
+        d->argv[argc] = NULL;
+
+        d->n_redirs = c->n_redirs;
+        d->redirs = c->n_redirs ? (Redir *)(base + off) : NULL;
+        off += ALIGN_PTR((size_t)c->n_redirs * sizeof(Redir));
+        for (int j = 0; j < c->n_redirs; j++) {
+            Redir *r = &c->redirs[j];
+            d->redirs[j] = *r;
+            d->redirs[j].path = r->path ? copy_str(&cursor, r->path, strlen(r->path)) : NULL;
+            d->redirs[j].body = r->body ? copy_str(&cursor, r->body, r->body_len) : NULL;
+            r->body_fd = -1;
+        }
+
+        d->psubs = NULL;
+        d->n_psubs = 0;
+    }
+}
+
+
+int msh_parse(const char *text, const msh_allocator *alloc, msh_pipeline **out,
+              char *err, size_t err_sz)
+{
+    Pipeline p;
+    TextLines lines = { NULL, NULL, 0 };
+    char *first;
+    int rc = -1;
+
+    *out = NULL;
+    if (alloc == NULL) alloc = &default_allocator;
+    if (text == NULL) {
+        snprintf(err, err_sz, "No command.");
+        return -1;
+    }
+
+    /* parse_line() takes one line; the rest are here-document bodies */
+    const char *nl = strchr(text, '\n');
+    size_t len = nl ? (size_t)(nl - text) : strlen(text);
+    first = malloc(len + 1);
+    if (first == NULL) {
+        snprintf(err, err_sz, "Out of memory.");
+        return -1;
+    }
+    memcpy(first, text, len);
+    first[len] = '\0';
+
+    if (parse_line(first, &p, err, err_sz) != 0) {
+        free(first);
+        return -1;
+    }
+    free(first);
+
+    for (int i = 0; i < p.n_cmds; i++) {
+        if (p.cmds[i].n_psubs > 0) {
+            snprintf(err, err_sz, "Process substitution is not supported.");
+            goto out;
+        }
+    }
+
+    lines.next = (nl && nl[1] != '\0') ? nl + 1 : NULL;
+    if (read_heredocs(&p, text_next_line, &lines, err, err_sz) != 0) goto out;
+    if (lines.next != NULL) {
+        snprintf(err, err_sz, "Unexpected text after the pipeline.");
+        goto out;
+    }
+
+    struct msh_pipeline *pl = alloc->alloc(alloc->ctx, block_size(&p));
+    if (pl == NULL) {
+        snprintf(err, err_sz, "Out of memory.");
+        goto out;
+    }
+    pl->alloc = *alloc;
+    copy_pipeline(pl, &p);
+    *out = pl;
+    rc = 0;
+
+out:
+    free(lines.buf);
+    free_pipeline(&p);
+    return rc;
+}
+
+
+void msh_pipeline_free(msh_pipeline *pl)
+{
+    if (pl == NULL) return;
+    for (int i = 0; i < pl->pl.n_cmds; i++) {
+        for (int j = 0; j < pl->pl.cmds[i].n_redirs; j++) {
+            if (pl->pl.cmds[i].redirs[j].body_fd >= 0) close(pl->pl.cmds[i].redirs[j].body_fd);
+        }
+    }
+    pl->alloc.free(pl->alloc.ctx, pl);
+}
+
+
+int msh_pipeline_stages(const msh_pipeline *pl)
+{
+    return pl->pl.n_cmds;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Spawning
+ * ----------------------------------------------------------------------------- */
+
+static void close_fd(int *fd)
+{
+    if (*fd >= 0) close(*fd);
+    *fd = -1;
+}
+
+/* dup2() that also clears O_CLOEXEC when fd already is target */
+static void child_dup(int fd, int target)
+{
+    if (fd == target) fcntl(fd, F_SETFD, 0);
+    else dup2(fd, target);
+}
+
+/* Everything here runs between fork() and exec in a possibly threaded
+ * process, so it sticks to async-signal-safe calls and _exit();
+ * apply_redirections() reports errors with write(2) only. */
+static void child_exec(const Command *c, int idx, int n, int (*pipes)[2],
+                       const int in[2], const int out[2], const int errp[2], int flags)
+{
+    sigset_t none;
+    static const char msg[] = "Command not found.\n";
+
+    if (idx == 0 && in[0] >= 0)      child_dup(in[0], STDIN_FILENO);
+    if (idx == n - 1 && out[1] >= 0) child_dup(out[1], STDOUT_FILENO);
+    if (errp[1] >= 0)                child_dup(errp[1], STDERR_FILENO);
+    connect_pipes_for_child(idx, n, n - 1, pipes);
+
+    signal(SIGPIPE, SIG_DFL);
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+
+    if (apply_redirections(c, flags & MSH_READAHEAD) < 0) _exit(1);
+    execvp(c->argv[0], c->argv);
+    if (write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0) { /* nothing left to report to */ }
+    _exit(127);
+}
+
+static int open_pipe(int want, int fds[2])
+{
+    fds[0] = fds[1] = -1;
+    return want ? pipe2(fds, O_CLOEXEC) : 0;
+}
+
+static int exit_code(const siginfo_t *si)
+{
+    return si->si_code == CLD_EXITED ? si->si_status : 128 + si->si_status;
+}
+
+
+int msh_spawn(const msh_pipeline *mpl, int flags, msh_proc **out)
+{
+    const Pipeline *p = &mpl->pl;
+    int n = p->n_cmds;
+    int in[2], outp[2], errp[2];
+    int (*pipes)[2] = NULL;
+    int made = 0;
+    int saved;
+
+    *out = NULL;
+    if (n < 1) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    msh_proc *pr = mpl->alloc.alloc(mpl->alloc.ctx, sizeof(msh_proc) + (size_t)n * sizeof(Stage));
+    if (pr == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    pr->alloc = mpl->alloc;
+    pr->n_stages = n;
+    pr->in_fd = pr->out_fd = pr->err_fd = -1;
+    memset(pr->cap, 0, sizeof(pr->cap));
+    pr->cap[0].spill_fd = pr->cap[1].spill_fd = -1;
+    for (int i = 0; i < n; i++) {
+        pr->stages[i] = (Stage){ -1, -1, 1, 0 };
+    }
+
+    in[0] = in[1] = outp[0] = outp[1] = errp[0] = errp[1] = -1;
+    if (open_pipe(flags & MSH_PIPE_STDIN, in) < 0 ||
+        open_pipe(flags & MSH_PIPE_STDOUT, outp) < 0 ||
+        open_pipe(flags & MSH_PIPE_STDERR, errp) < 0) goto fail;
+
+    if (n > 1) {
+        pipes = malloc((size_t)(n - 1) * sizeof(*pipes));
+        if (pipes == NULL) goto fail;
+        for (; made < n - 1; made++) {
+            if (pipe2(pipes[made], O_CLOEXEC) < 0) goto fail;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        pid_t pid = fork();
+        if (pid < 0) goto fail;
+        if (pid == 0) child_exec(&p->cmds[i], i, n, pipes, in, outp, errp, flags);
+
+        pr->stages[i].pid = pid;
+        pr->stages[i].reaped = 0;
+#ifdef SYS_pidfd_open
+        pr->stages[i].pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#endif
+    }
+
+    close_all_pipes(made, pipes);
+    free(pipes);
+    close_fd(&in[0]);
+    close_fd(&outp[1]);
+    close_fd(&errp[1]);
+    pr->in_fd = in[1];
+    pr->out_fd = outp[0];
+    pr->err_fd = errp[0];
+    *out = pr;
+    return 0;
+
+fail:
+    saved = errno;
+    if (pipes != NULL) close_all_pipes(made, pipes);
+    free(pipes);
+    for (int k = 0; k < 2; k++) {
+        close_fd(&in[k]);
+        close_fd(&outp[k]);
+        close_fd(&errp[k]);
+    }
+    /* No half-started pipelines: stop and reap what did start */
+    for (int i = 0; i < n; i++) {
+        if (pr->stages[i].pid > 0) {
+            kill(pr->stages[i].pid, SIGKILL);
+            while (waitpid(pr->stages[i].pid, NULL, 0) < 0 && errno == EINTR) {}
+        }
+        close_fd(&pr->stages[i].pidfd);
+    }
+    pr->alloc.free(pr->alloc.ctx, pr);
+    errno = saved;
+    return -1;
+}
+
+
+int msh_stdin_fd(const msh_proc *pr)  { return pr->in_fd; }
+int msh_stdout_fd(const msh_proc *pr) { return pr->out_fd; }
+int msh_stderr_fd(const msh_proc *pr) { return pr->err_fd; }
+
+void msh_close_stdin(msh_proc *pr)
+{
+    close_fd(&pr->in_fd);
+}
+
+int msh_stages(const msh_proc *pr) { return pr->n_stages; }
+
+pid_t msh_pid(const msh_proc *pr, int stage)
+{
+    return (stage >= 0 && stage < pr->n_stages) ? pr->stages[stage].pid : -1;
+}
+
+int msh_pidfd(const msh_proc *pr, int stage)
+{
+    return (stage >= 0 && stage < pr->n_stages) ? pr->stages[stage].pidfd : -1;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Waiting
+ *
+ * Each stage is reaped by its own pidfd (or pid), never with waitpid(-1),
+ * so children of other threads or libraries are left alone.
+ * ----------------------------------------------------------------------------- */
+
+/* Returns 1 once s is reaped, 0 if it still runs (WNOHANG), -1 on error */
+static int reap_stage(Stage *s, int options)
+{
+    siginfo_t si;
+    int rc;
+
+    if (s->reaped) return 1;
+
+    do {
+        si.si_pid = 0;
+        if (s->pidfd >= 0) rc = waitid((idtype_t)P_PIDFD, (id_t)s->pidfd, &si, WEXITED | options);
+        else               rc = waitid(P_PID, (id_t)s->pid, &si, WEXITED | options);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0) return -1;
+    if (si.si_pid == 0) return 0;
+
+    s->status = exit_code(&si);
+    s->reaped = 1;
+    return 1;
+}
+
+static int wait_stages(msh_proc *pr, int *status, int options)
+{
+    int done = 1;
+
+    for (int i = 0; i < pr->n_stages; i++) {
+        int rc = reap_stage(&pr->stages[i], options);
+        if (rc < 0) return -1;
+        if (rc == 0) done = 0;
+    }
+    if (done && status != NULL) *status = pr->stages[pr->n_stages - 1].status;
+    return done;
+}
+
+
+int msh_wait(msh_proc *pr, int *status)
+{
+    return wait_stages(pr, status, 0) < 0 ? -1 : 0;
+}
+
+
+int msh_poll(msh_proc *pr, int *status)
+{
+    return wait_stages(pr, status, WNOHANG);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Output capture
+ *
+ * A captured stream's pipe is made O_NONBLOCK and drained by msh_pump()
+ * whenever the caller's event loop reports it readable.  Bytes go into the
+ * caller's buffer first; once it is full (accumulate mode) the rest is
+ * splice()d from the pipe straight into a memfd, so a large output never
+ * passes through user space or the caller's allocator.  In callback mode
+ * the buffer is only a staging area handed to fn after every read().
+ * ----------------------------------------------------------------------------- */
+
+#define SPILL_CHUNK (1 << 20)   /* bytes per splice() into the memfd */
+
+static int *stream_fd(msh_proc *pr, int stream)
+{
+    return stream == MSH_STDOUT ? &pr->out_fd : &pr->err_fd;
+}
+
+
+int msh_capture(msh_proc *pr, int stream, char *buf, size_t cap,
+                msh_output_fn fn, void *ctx)
+{
+    if ((stream != MSH_STDOUT && stream != MSH_STDERR) ||
+        (buf == NULL) != (cap == 0) || (fn != NULL && buf == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = *stream_fd(pr, stream);
+    if (fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) return -1;
+
+    Capture *c = &pr->cap[stream - 1];
+    c->active = 1;
+    c->buf = buf;
+    c->cap = cap;
+    c->len = 0;
+    c->fn = fn;
+    c->ctx = ctx;
+    return 0;
+}
+
+
+int msh_pump(msh_proc *pr, int stream)
+{
+    if (stream != MSH_STDOUT && stream != MSH_STDERR) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Capture *c = &pr->cap[stream - 1];
+    int *fd = stream_fd(pr, stream);
+    ssize_t n;
+
+    if (!c->active) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (c->eof) return 1;
+
+    for (;;) {
+        if (c->fn != NULL) {
+            n = read(*fd, c->buf, c->cap);
+            if (n > 0) c->fn(c->ctx, stream, c->buf, (size_t)n);
+        } else if (c->len < c->cap) {
+            n = read(*fd, c->buf + c->len, c->cap - c->len);
+            if (n > 0) c->len += (size_t)n;
+        } else {
+            if (c->spill_fd < 0) {
+                c->spill_fd = memfd_create("msh-capture", MFD_CLOEXEC);
+                if (c->spill_fd < 0) return -1;
+            }
+            n = splice(*fd, NULL, c->spill_fd, NULL, SPILL_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        }
+
+        if (n > 0) {
+            c->total += (unsigned long long)n;
+            continue;
+        }
+        if (n == 0) break;
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN) return 0;
+        return -1;
+    }
+
+    /* End of stream.  The pipe stays open until msh_proc_free(): a closed fd
+     * is only dropped from an epoll set once no other process (e.g. a child
+     * between fork() and exec) shares it, so the caller removes it first. */
+    if (c->spill_fd >= 0) lseek(c->spill_fd, 0, SEEK_SET);
+    c->eof = 1;
+    return 1;
+}
+
+
+int msh_output(const msh_proc *pr, int stream, msh_output_info *info)
+{
+    if (stream != MSH_STDOUT && stream != MSH_STDERR) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const Capture *c = &pr->cap[stream - 1];
+    info->buffered = c->len;
+    info->total = c->total;
+    info->spill_fd = c->spill_fd;
+    info->eof = c->eof;
+    return 0;
+}
+
+
+int msh_collect(msh_proc *pr, int *status)
+{
+    for (;;) {
+        struct pollfd pfd[2];
+        int streams[2];
+        int n = 0;
+
+        for (int s = MSH_STDOUT; s <= MSH_STDERR; s++) {
+            if (!pr->cap[s - 1].active || pr->cap[s - 1].eof) continue;
+            pfd[n].fd = *stream_fd(pr, s);
+            pfd[n].events = POLLIN;
+            streams[n++] = s;
+        }
+        if (n == 0) break;
+
+        if (poll(pfd, (nfds_t)n, -1) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (pfd[i].revents != 0 && msh_pump(pr, streams[i]) < 0) return -1;
+        }
+    }
+    return msh_wait(pr, status);
+}
+
+
+void msh_proc_free(msh_proc *pr)
+{
+    if (pr == NULL) return;
+
+    close_fd(&pr->in_fd);
+    close_fd(&pr->out_fd);
+    close_fd(&pr->err_fd);
+    close_fd(&pr->cap[0].spill_fd);
+    close_fd(&pr->cap[1].spill_fd);
+    for (int i = 0; i < pr->n_stages; i++) close_fd(&pr->stages[i].pidfd);
+    pr->alloc.free(pr->alloc.ctx, pr);
+}
@@ -0,0 +1,142 @@
+/* =============================================================================
+ * src/options.c  –  Shell options from the environment
+ *
+ * Every option is a MYSHELL_* environment variable read once by
+ * options_init() at startup.  Boolean options accept "0" / "1", numeric ones
+ * a decimal number; an unset or empty variable keeps the default.
+ *
+ * options_user_dir() resolves the per-user directories of 'memo' and 'qsub'
+ * (option, else XDG base directory, else under $HOME) the same way.
+ * ============================================================================= */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>      // snprintf()
+#include <stdlib.h>     // getenv()
+#include <string.h>     // strcmp(), strlen()
+#include <errno.h>      // errno, EEXIST
+#include <sys/stat.h>   // mkdir()
+#include "options.h"
+#include "ioeng.h"      // IO_ENGINE_*
+#include "profile.h"    // PROFILE_*
+#include "memo.h"       // MEMO_EVICT_*, MEMO_DEFAULT_ENV
+
+ShellOptions shell_opts = {
+    .readahead = 1,
+    .dontneed  = 0,
+    .io_engine = IO_ENGINE_AUTO,
+    .copy_fastpath = 1,
+    .trace_path = NULL,
+    .perf = 0,
+    .ioacct = 0,
+    .profile = PROFILE_OFF,
+    .path_cache = 1,
+    .path_cache_file = NULL,
+    .memo_dir = NULL,
+    .memo_max_mb = 1024,
+    .memo_evict = MEMO_EVICT_LRU,
+    .memo_env = MEMO_DEFAULT_ENV,
+    .queue_dir = NULL,
+    .queue_max = 0,
+    .queue_limits = NULL,
+    .monitor_ms = 0,
+};
+
+
+/* Returns the boolean value of environment variable name, or def if unset/empty */
+static int env_flag(const char *name, int def)
+{
+    const char *v = getenv(name);
+    if (v == NULL || v[0] == '\0') return def;
+    return v[0] != '0';
+}
+
+
+/* Returns the non-negative integer value of environment variable name, or def */
+static int env_int(const char *name, int def)
+{
+    const char *v = getenv(name);
+    if (v == NULL || v[0] == '\0') return def;
+    int n = atoi(v);
+    return n >= 0 ? n : def;
+}
+
+
+void options_init(void)
+{
+    shell_opts.readahead = env_flag("MYSHELL_READAHEAD", shell_opts.readahead);
+    shell_opts.dontneed  = env_flag("MYSHELL_DONTNEED",  shell_opts.dontneed);
+    const char *engine = getenv("MYSHELL_IOENGINE");
+    if (engine != NULL) {
+        if (strcmp(engine, "uring") == 0)     shell_opts.io_engine = IO_ENGINE_URING;
+        else if (strcmp(engine, "poll") == 0) shell_opts.io_engine = IO_ENGINE_POLL;
+    }
+
+    shell_opts.copy_fastpath = env_flag("MYSHELL_COPY_FASTPATH", shell_opts.copy_fastpath);
+    shell_opts.perf          = env_flag("MYSHELL_PERF", shell_opts.perf);
+    shell_opts.ioacct        = env_flag("MYSHELL_IOACCT", shell_opts.ioacct);
+    shell_opts.path_cache    = env_flag("MYSHELL_PATHCACHE", shell_opts.path_cache);
+    shell_opts.monitor_ms    = env_int("MYSHELL_MONITOR", shell_opts.monitor_ms);
+
+    const char *profile = getenv("MYSHELL_PROFILE");
+    if (profile != NULL) {
+        if (strcmp(profile, "folded") == 0) shell_opts.profile = PROFILE_FOLDED;
+        else shell_opts.profile = env_flag("MYSHELL_PROFILE", 0) ? PROFILE_REPORT : PROFILE_OFF;
+    }
+
+    const char *pc_file = getenv("MYSHELL_PATHCACHE_FILE");
+    if (pc_file != NULL && pc_file[0] != '\0') shell_opts.path_cache_file = pc_file;
+
+    const char *memo_dir = getenv("MYSHELL_MEMO_DIR");
+    if (memo_dir != NULL && memo_dir[0] != '\0') shell_opts.memo_dir = memo_dir;
+    shell_opts.memo_max_mb = env_int("MYSHELL_MEMO_MAX_MB", shell_opts.memo_max_mb);
+    const char *evict = getenv("MYSHELL_MEMO_EVICT");
+    if (evict != NULL) {
+        if (strcmp(evict, "lru") == 0)       shell_opts.memo_evict = MEMO_EVICT_LRU;
+        else if (strcmp(evict, "fifo") == 0) shell_opts.memo_evict = MEMO_EVICT_FIFO;
+    }
+    const char *memo_env = getenv("MYSHELL_MEMO_ENV");
+    if (memo_env != NULL) shell_opts.memo_env = memo_env;
+
+    const char *queue_dir = getenv("MYSHELL_QUEUE_DIR");
+    if (queue_dir != NULL && queue_dir[0] != '\0') shell_opts.queue_dir = queue_dir;
+    shell_opts.queue_max = env_int("MYSHELL_QUEUE_MAX", shell_opts.queue_max);
+    shell_opts.queue_limits = getenv("MYSHELL_QUEUE_LIMITS");
+
+    const char *trace = getenv("MYSHELL_TRACE");
+    if (trace != NULL && trace[0] != '\0') shell_opts.trace_path = trace;
+}
+
+
+/* Creates path and its missing parents (mode 0700); path is restored after */
+int mkdir_p(char *path)
+{
+    for (char *p = path + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        int rc = mkdir(path, 0700);
+        *p = '/';
+        if (rc < 0 && errno != EEXIST) return -1;
+    }
+    return (mkdir(path, 0700) < 0 && errno != EEXIST) ? -1 : 0;
+}
+
+
+/* The directory named by option dir, else $xdg_var/myshell/name (if absolute),
+ * else $HOME/home_dir/myshell/name.  -1 (buf "") if none is set or fits. */
+int options_user_dir(char *buf, size_t sz, const char *dir, const char *xdg_var,
+                     const char *home_dir, const char *name)
+{
+    const char *xdg = getenv(xdg_var);
+    const char *home = getenv("HOME");
+
+    buf[0] = '\0';
+    if (dir != NULL)                       snprintf(buf, sz, "%s", dir);
+    else if (xdg != NULL && xdg[0] == '/') snprintf(buf, sz, "%s/myshell/%s", xdg, name);
+    else if (home != NULL)                 snprintf(buf, sz, "%s/%s/myshell/%s", home, home_dir, name);
+    if (buf[0] == '\0' || strlen(buf) + 1 >= sz) {
+        buf[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
@@ -1,9 +1,16 @@
 // src/parser.c
+#define _GNU_SOURCE     // memfd_create, F_ADD_SEALS
 #include <stdlib.h>     // malloc, free, NULL
 #include <ctype.h>    // isspace, isdigit
 #include <string.h>   // memcpy, strlen
 #include <stdio.h>    // snprintf
+#include <errno.h>    // errno, EINTR
+#include <fcntl.h>    // fcntl, F_ADD_SEALS
+#include <unistd.h>   // write, close
+#include <sys/mman.h> // memfd_create
 #include "parser.h"
+#include "hash.h"   // hash_name
+#include "probes.h" // PROBE_PARSE_START, PROBE_PARSE_DONE
 
 // ================ Parsing memory cleanup ================
 
@@ -28,16 +35,27 @@ void free_pipeline(Pipeline *p) {
             free(c->argv);
         }
 
-        // Free redirection file strings
-        free(c->in_file);
-        free(c->out_file);
-        free(c->err_file);
+        // Free process substitutions (inner pipelines are heap allocated)
+        for (int j = 0; j < c->n_psubs; j++) {
+            free_pipeline(c->psubs[j].inner);
+            free(c->psubs[j].inner);
+        }
+        free(c->psubs);
+
+        // Free redirection file strings, then the action array
+        for (int j = 0; j < c->n_redirs; j++) {
+            free(c->redirs[j].path);
+            free(c->redirs[j].body);
+            if (c->redirs[j].body_fd >= 0) close(c->redirs[j].body_fd);
+        }
+        free(c->redirs);
 
         // Reset pointers to avoid accidental reuse
         c->argv = NULL;
-        c->in_file = NULL;
-        c->out_file = NULL;
-        c->err_file = NULL;
+        c->redirs = NULL;
+        c->n_redirs = 0;
+        c->psubs = NULL;
+        c->n_psubs = 0;
     }
 
     free(p->cmds);
@@ -85,11 +103,38 @@ static int push_token(char ***tokens, int *ntok, int *cap,
     return 0;
 }
 
+// Returns the length of the redirection operator starting at p, or 0.
+// Forms: [n]<  [n]>  [n]>>  [n]<&  [n]>&  &>  &>>  [n]<<  [n]<<-  [n]<<<
+// (n = decimal fd number)
+static int redir_op_len(const char *p) {
+    if (p[0] == '&' && p[1] == '>') {
+        return (p[2] == '>') ? 3 : 2;
+    }
+
+    int n = 0;
+    while (isdigit((unsigned char)p[n])) n++;
+
+    if (p[n] == '<') {
+        if (p[n + 1] == '<') {
+            return (p[n + 2] == '<' || p[n + 2] == '-') ? n + 3 : n + 2;
+        }
+        return (p[n + 1] == '&') ? n + 2 : n + 1;
+    }
+    if (p[n] == '>') {
+        return (p[n + 1] == '>' || p[n + 1] == '&') ? n + 2 : n + 1;
+    }
+    return 0;
+}
+
 // Tokenize the input line into an array of tokens, recognizing operators and words.
 // Rules:
 // 1) Split on whitespace
-// 2) Recognize operator "2>" as a single token
-// 3) Treat <, >, | as separate tokens even without spaces
+// 2) Recognize redirection operators ("<", ">", ">>", "2>", "2>&", "&>", ...)
+//    as single tokens; a leading fd number belongs to the operator
+// 3) Treat <, >, |, ; as separate tokens even without spaces
+// 4) Recognize list operators "&&" and "||" as single tokens
+// 5) After "<&" / ">&", a directly following fd number or '-' is its own token
+// 6) "<(...)" and ">(...)" are one word token up to the matching ')'
 
 static int tokenize(const char *line, char ***tokens_out, int *ntok_out,
                     char *err, size_t err_sz) {
@@ -110,27 +155,67 @@ static int tokenize(const char *line, char ***tokens_out, int *ntok_out,
         while (*p && isspace((unsigned char)*p)) p++;
         if (!*p) break;
 
-        // 2) Recognize operator: 2>
-        if (*p == '2' && *(p + 1) == '>') {
+        // 2) Recognize process substitution: <(...) >(...) up to the matching ')'
+        if ((*p == '<' || *p == '>') && *(p + 1) == '(') {
+            int depth = 0;
+            const char *q = p + 1;
+            do {
+                if (*q == '(') depth++;
+                else if (*q == ')') depth--;
+                q++;
+            } while (*q && depth > 0);
+
+            if (depth > 0) {
+                if (err && err_sz > 0) snprintf(err, err_sz, "Unterminated process substitution.");
+                free_tokens(tokens, ntok);
+                return 1;
+            }
+            if (push_token(&tokens, &ntok, &cap, p, (int)(q - p)) != 0) goto oom;
+            p = q;
+            continue;
+        }
+
+        // 3) Recognize redirection operators: < > >> 2> 2>&1 &> ...
+        int rlen = redir_op_len(p);
+        if (rlen > 0) {
+            if (push_token(&tokens, &ntok, &cap, p, rlen) != 0) goto oom;
+            p += rlen;
+
+            // n>&m / n>&- : split the target off so "2>&1>f" stays unambiguous
+            if (p[-1] == '&' && p[-2] != '&') {
+                int tlen = 0;
+                if (*p == '-') tlen = 1;
+                else while (isdigit((unsigned char)p[tlen])) tlen++;
+                if (tlen > 0) {
+                    if (push_token(&tokens, &ntok, &cap, p, tlen) != 0) goto oom;
+                    p += tlen;
+                }
+            }
+            continue;
+        }
+
+        // 4) Recognize list operators: && ||
+        if ((*p == '&' && *(p + 1) == '&') || (*p == '|' && *(p + 1) == '|')) {
             if (push_token(&tokens, &ntok, &cap, p, 2) != 0) goto oom;
             p += 2;
             continue;
         }
 
-        // 3) Recognize single-char operators: < > |
-        if (*p == '<' || *p == '>' || *p == '|') {
+        // 5) Recognize single-char operators: | ;
+        if (*p == '|' || *p == ';') {
             if (push_token(&tokens, &ntok, &cap, p, 1) != 0) goto oom;
             p += 1;
             continue;
         }
 
-        // 4) Otherwise: read a "word" token until whitespace or operator
+        // 6) Otherwise: read a "word" token until whitespace or operator
         const char *start = p;
         while (*p &&
                !isspace((unsigned char)*p) &&
-               *p != '<' && *p != '>' && *p != '|' ) {
-            // stop at "2>" if we see it starting
+               *p != '<' && *p != '>' && *p != '|' && *p != ';') {
+            // stop at "2>", "&&" or "&>" if we see it starting
             if (*p == '2' && *(p + 1) == '>') break;
+            if (*p == '&' && (*(p + 1) == '&' || *(p + 1) == '>')) break;
             p++;
         }
 
@@ -153,11 +238,196 @@ oom:
 
 // Helper function to check if a token is an operator.
 
+static int is_list_op(const char *t) {
+    return (strcmp(t, ";") == 0 ||
+            strcmp(t, "&&") == 0 ||
+            strcmp(t, "||") == 0);
+}
+
+#define STDOUT_FD 1
+#define STDERR_FD 2
+
+// Redirection operator as parsed from a token such as "2>>" or "&>".
+typedef struct {
+    int  fd;            // target fd (explicit prefix or the operator's default)
+    int  explicit_fd;   // 1 if the token carried a number prefix
+    char op[4];         // operator without the prefix: "<", ">", ">>", "<&", ">&", "&>", "&>>",
+                        //                              "<<", "<<-", "<<<"
+} RedirOp;
+
+// If t is a redirection operator token, fill *r and return 1; else return 0.
+static int parse_redir_op(const char *t, RedirOp *r) {
+    int len = (int)strlen(t);
+    if (len == 0 || redir_op_len(t) != len) return 0;
+
+    if (t[0] == '&') {
+        r->fd = 1;
+        r->explicit_fd = 0;
+        strcpy(r->op, t);
+        return 1;
+    }
+
+    // An oversized prefix still makes an operator token, with fd -1, so the
+    // caller reports it instead of redirecting a truncated fd
+    int n = 0;
+    long fd = 0;
+    while (isdigit((unsigned char)t[n])) {
+        if (fd >= 0) fd = (fd > 100000) ? -1 : fd * 10 + (t[n] - '0');
+        n++;
+    }
+
+    r->explicit_fd = (n > 0);
+    r->fd = r->explicit_fd ? (int)fd : (t[n] == '<' ? 0 : 1);
+    strcpy(r->op, t + n);
+    return 1;
+}
+
 static int is_op(const char *t) {
-    return (strcmp(t, "<") == 0 ||
-            strcmp(t, ">") == 0 ||
-            strcmp(t, "2>") == 0 ||
-            strcmp(t, "|") == 0);
+    RedirOp r;
+    return (strcmp(t, "|") == 0 ||
+            is_list_op(t) ||
+            parse_redir_op(t, &r));
+}
+
+// Redirections of the command being parsed.  c->redirs grows by doubling.
+// From REDIR_INDEX_MIN actions on, push_output_redir() finds earlier opens
+// through two open-addressed tables of indexes into c->redirs instead of
+// rescanning it: the last open of each (mode, path) and the last action on
+// each fd.  Both tables are kept at most half full.
+#define REDIR_INDEX_MIN 8
+
+typedef struct {
+    Command *c;
+    int      cap;       // allocated length of c->redirs
+    int     *opens;     // 1 + index of the last open of a (mode, path); 0 = empty
+    int     *fds;       // 1 + index of the last action on an fd; 0 = empty
+    int      slots;     // length of both tables (a power of two), 0 until built
+} RedirBuilder;
+
+static void redir_builder_free(RedirBuilder *b) {
+    free(b->opens);
+    free(b->fds);
+    b->opens = NULL;
+    b->fds = NULL;
+    b->slots = 0;
+}
+
+// Slot holding the last open of (kind, path), or the empty slot for it.
+static int *open_slot(const RedirBuilder *b, RedirKind kind, const char *path) {
+    for (unsigned long i = hash_name(path) ^ (unsigned long)kind; ; i++) {
+        int *s = &b->opens[i & (unsigned long)(b->slots - 1)];
+        if (*s == 0) return s;
+        const Redir *r = &b->c->redirs[*s - 1];
+        if (r->kind == kind && strcmp(r->path, path) == 0) return s;
+    }
+}
+
+// Slot holding the last action on fd, or the empty slot for it.
+static int *fd_slot(const RedirBuilder *b, int fd) {
+    for (unsigned long i = (unsigned long)fd * 2654435761UL; ; i++) {
+        int *s = &b->fds[i & (unsigned long)(b->slots - 1)];
+        if (*s == 0 || b->c->redirs[*s - 1].fd == fd) return s;
+    }
+}
+
+static void index_redir(RedirBuilder *b, int i) {
+    const Redir *r = &b->c->redirs[i];
+    *fd_slot(b, r->fd) = i + 1;
+    if (r->kind == REDIR_OUT || r->kind == REDIR_APPEND) *open_slot(b, r->kind, r->path) = i + 1;
+}
+
+// Rebuilds both tables at twice the size (later actions overwrite earlier ones).
+static int index_rebuild(RedirBuilder *b) {
+    int slots = b->slots ? b->slots * 2 : 4 * REDIR_INDEX_MIN;
+    int *opens = calloc((size_t)slots, sizeof(int));
+    int *fds = calloc((size_t)slots, sizeof(int));
+    if (!opens || !fds) {
+        free(opens);
+        free(fds);
+        return -1;
+    }
+
+    redir_builder_free(b);
+    b->opens = opens;
+    b->fds = fds;
+    b->slots = slots;
+    for (int i = 0; i < b->c->n_redirs; i++) index_redir(b, i);
+    return 0;
+}
+
+// Helper function to append one redirection action to a command (takes ownership of path).
+static int push_redir(RedirBuilder *b, RedirKind kind, int fd, int src_fd, char *path) {
+    Command *c = b->c;
+
+    if (c->n_redirs == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 1;
+        Redir *tmp = realloc(c->redirs, (size_t)cap * sizeof(Redir));
+        if (!tmp) {
+            free(path);
+            return -1;
+        }
+        c->redirs = tmp;
+        b->cap = cap;
+    }
+
+    Redir *r = &c->redirs[c->n_redirs++];
+    r->kind = kind;
+    r->fd = fd;
+    r->src_fd = src_fd;
+    r->path = path;
+    r->body = NULL;
+    r->body_len = 0;
+    r->strip_tabs = 0;
+    r->body_fd = -1;
+
+    if (b->slots == 0 && c->n_redirs < REDIR_INDEX_MIN) return 0;
+    if (2 * c->n_redirs > b->slots) return index_rebuild(b);
+    index_redir(b, c->n_redirs - 1);
+    return 0;
+}
+
+// Append an open-for-writing action for path onto fd.
+// If the same path was already opened in the same mode by this command and
+// that descriptor has not been redirected since (e.g.  > log 2> log), emit a
+// dup of it instead, so the file is opened once and both fds share one offset.
+static int push_output_redir(RedirBuilder *b, RedirKind kind, int fd, const char *path) {
+    Command *c = b->c;
+    int prev = -1;      // index of that open, if its fd still refers to the file
+
+    if (b->slots > 0) {
+        int s = *open_slot(b, kind, path);
+        if (s > 0 && *fd_slot(b, c->redirs[s - 1].fd) == s) prev = s - 1;
+    } else {
+        for (int i = c->n_redirs - 1; i >= 0; i--) {
+            if (c->redirs[i].kind != kind || strcmp(c->redirs[i].path, path) != 0) continue;
+
+            prev = i;
+            for (int k = i + 1; k < c->n_redirs; k++) {
+                if (c->redirs[k].fd == c->redirs[i].fd) { prev = -1; break; }
+            }
+            break;
+        }
+    }
+
+    if (prev >= 0 && c->redirs[prev].fd != fd) {
+        return push_redir(b, REDIR_DUP, fd, c->redirs[prev].fd, NULL);
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return -1;
+    return push_redir(b, kind, fd, -1, copy);
+}
+
+// Parse a dup target word: decimal fd or '-'.  Returns fd, -2 for '-', -1 if neither.
+static int parse_dup_target(const char *t) {
+    if (strcmp(t, "-") == 0) return -2;
+
+    long fd = 0;
+    for (int i = 0; t[i]; i++) {
+        if (!isdigit((unsigned char)t[i]) || fd > 100000) return -1;
+        fd = fd * 10 + (t[i] - '0');
+    }
+    return (t[0] != '\0') ? (int)fd : -1;
 }
 
 // Build argv array from tokens[start..end-1], skipping redirection operators + filenames.
@@ -165,11 +435,12 @@ static int is_op(const char *t) {
 // On success: *argv_out is NULL-terminated.
 static int build_argv(char **tokens, int start, int end, char ***argv_out) {
     *argv_out = NULL;
+    RedirOp r;
 
     // First count how many argv words we will include
     int count = 0;
     for (int i = start; i < end; i++) {
-        if (strcmp(tokens[i], "<") == 0 || strcmp(tokens[i], ">") == 0 || strcmp(tokens[i], "2>") == 0) {
+        if (parse_redir_op(tokens[i], &r)) {
             i++; // skip the filename token (if it exists; syntax checked elsewhere)
             continue;
         }
@@ -183,7 +454,7 @@ static int build_argv(char **tokens, int start, int end, char ***argv_out) {
 
     int k = 0;
     for (int i = start; i < end; i++) {
-        if (strcmp(tokens[i], "<") == 0 || strcmp(tokens[i], ">") == 0 || strcmp(tokens[i], "2>") == 0) {
+        if (parse_redir_op(tokens[i], &r)) {
             i++; // skip filename
             continue;
         }
@@ -204,41 +475,87 @@ static int build_argv(char **tokens, int start, int end, char ***argv_out) {
     return 0;
 }
 
-// ================ Main parse_line function ================
-
-int parse_line(const char *line, Pipeline *out, char *err, size_t err_sz) {
-    pipeline_init(out);
-    if (err && err_sz > 0) err[0] = '\0';
+// Helper function to check if an argv word is a process substitution.
+static int is_procsub(const char *t) {
+    return (t[0] == '<' || t[0] == '>') && t[1] == '(';
+}
 
-    char **tokens = NULL;
-    int ntok = 0;
+// Parse every "<(...)" / ">(...)" word of c->argv into c->psubs.
+// The inner text is parsed as a single pipeline with parse_line().
+// Returns 0 on success, 1 on error with err filled.
+static int parse_procsubs(Command *c, char *err, size_t err_sz) {
+    int n = 0;
+    for (int k = 0; c->argv[k] != NULL; k++) {
+        if (is_procsub(c->argv[k])) n++;
+    }
+    if (n == 0) return 0;
 
-    if (tokenize(line, &tokens, &ntok, err, err_sz) != 0) {
-        // tokenizer already filled err
-        goto fail;
+    c->psubs = (ProcSub*)calloc((size_t)n, sizeof(ProcSub));
+    if (!c->psubs) {
+        if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory.");
+        return 1;
     }
 
-    // Blank line => do nothing, but not an error
-    if (ntok == 0) {
-        free_tokens(tokens, ntok);
-        return 1; // main should just reprompt when err is empty
+    for (int k = 0; c->argv[k] != NULL; k++) {
+        const char *w = c->argv[k];
+        if (!is_procsub(w)) continue;
+
+        // Strip the leading "<(" / ">(" and the trailing ')'
+        size_t len = strlen(w);
+        char *text = malloc(len);
+        Pipeline *inner = malloc(sizeof(Pipeline));
+        if (!text || !inner) {
+            free(text);
+            free(inner);
+            if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory.");
+            return 1;
+        }
+        memcpy(text, w + 2, len - 3);
+        text[len - 3] = '\0';
+
+        int rc = parse_line(text, inner, err, err_sz);
+        free(text);
+        if (rc != 0) {
+            free(inner);
+            if (err && err_sz > 0 && err[0] == '\0') {
+                snprintf(err, err_sz, "Command missing in process substitution.");
+            }
+            return 1;
+        }
+
+        ProcSub *ps = &c->psubs[c->n_psubs++];
+        ps->argi = k;
+        ps->is_output = (w[0] == '>');
+        ps->inner = inner;
     }
+    return 0;
+}
+
+// ================ Pipeline parsing over a token range ================
+
+// Parse tokens[start..end-1] (which contain no list operators) into *out.
+// Returns 0 on success, 1 on error with err filled; *out is freed on error.
+static int parse_pipeline_tokens(char **tokens, int start, int end, Pipeline *out,
+                                 char *err, size_t err_sz) {
+    RedirBuilder rb = { NULL, 0, NULL, NULL, 0 };
+
+    pipeline_init(out);
 
     // ----------------------------
     // A) Pipe syntax validation
     // ----------------------------
     // Cannot start with '|'
-    if (strcmp(tokens[0], "|") == 0) {
+    if (strcmp(tokens[start], "|") == 0) {
         if (err && err_sz > 0) snprintf(err, err_sz, "Command missing after pipe.");
         goto fail;
     }
     // Cannot end with '|'
-    if (strcmp(tokens[ntok - 1], "|") == 0) {
+    if (strcmp(tokens[end - 1], "|") == 0) {
         if (err && err_sz > 0) snprintf(err, err_sz, "Command missing after pipe.");
         goto fail;
     }
     // Cannot have '| |' (with nothing between)
-    for (int i = 0; i < ntok - 1; i++) {
+    for (int i = start; i < end - 1; i++) {
         if (strcmp(tokens[i], "|") == 0 && strcmp(tokens[i + 1], "|") == 0) {
             if (err && err_sz > 0) snprintf(err, err_sz, "Empty command between pipes.");
             goto fail;
@@ -247,7 +564,7 @@ int parse_line(const char *line, Pipeline *out, char *err, size_t err_sz) {
 
     // Count commands = number of pipes + 1
     int n_cmds = 1;
-    for (int i = 0; i < ntok; i++) {
+    for (int i = start; i < end; i++) {
         if (strcmp(tokens[i], "|") == 0) n_cmds++;
     }
 
@@ -262,53 +579,102 @@ int parse_line(const char *line, Pipeline *out, char *err, size_t err_sz) {
     // B) Parse each command segment
     // ----------------------------
     int cmd_index = 0;
-    int seg_start = 0;
+    int seg_start = start;
 
-    for (int i = 0; i <= ntok; i++) {
-        int is_end = (i == ntok) || (strcmp(tokens[i], "|") == 0);
+    for (int i = start; i <= end; i++) {
+        int is_end = (i == end) || (strcmp(tokens[i], "|") == 0);
         if (!is_end) continue;
 
         int seg_end = i; // tokens[seg_start .. seg_end-1] is this command segment
 
-        // 1) Validate redirections in this segment and collect filenames
+        // 1) Validate redirections in this segment and collect them in order
         Command *c = &out->cmds[cmd_index];
+        rb.c = c;
+        rb.cap = 0;
 
         for (int j = seg_start; j < seg_end; j++) {
-            if (strcmp(tokens[j], "<") == 0) {
-                if (j + 1 >= seg_end || is_op(tokens[j + 1])) {
-                    if (err && err_sz > 0) snprintf(err, err_sz, "Input file not specified.");
-                    goto fail;
-                }
-                // last one wins if multiple appear
-                free(c->in_file);
-                c->in_file = strdup(tokens[j + 1]);
-                if (!c->in_file) { if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory."); goto fail; }
-                j++; // skip filename
-            } else if (strcmp(tokens[j], ">") == 0) {
-                if (j + 1 >= seg_end || is_op(tokens[j + 1])) {
+            RedirOp r;
+            if (!parse_redir_op(tokens[j], &r)) continue;
+            if (r.fd < 0) {
+                if (err && err_sz > 0) snprintf(err, err_sz, "Invalid file descriptor.");
+                goto fail;
+            }
+
+            int is_dup = (strcmp(r.op, "<&") == 0 || strcmp(r.op, ">&") == 0);
+            int is_here = (strncmp(r.op, "<<", 2) == 0);
+
+            // Every redirection operator needs a file name (or fd) after it
+            if (j + 1 >= seg_end || is_op(tokens[j + 1])) {
+                if (err && err_sz > 0) {
+                    if (strcmp(r.op, "<<<") == 0) snprintf(err, err_sz, "Here-string not specified.");
+                    else if (is_here) snprintf(err, err_sz, "Here-document delimiter not specified.");
+                    else if (is_dup) snprintf(err, err_sz, "Redirection target not specified.");
+                    else if (r.op[0] == '<') snprintf(err, err_sz, "Input file not specified.");
+                    else if (r.fd == 2 && r.explicit_fd) snprintf(err, err_sz, "Error output file not specified.");
                     // Special message when '>' appears at end of a later segment in pipeline
                     // Spec example: "< input.txt | command1 >" => "Output file not specified after redirection."
-                    if (err && err_sz > 0) {
-                        if (n_cmds > 1 && seg_end == ntok) snprintf(err, err_sz, "Output file not specified after redirection.");
-                        else snprintf(err, err_sz, "Output file not specified.");
-                    }
-                    goto fail;
+                    else if (n_cmds > 1 && seg_end == end) snprintf(err, err_sz, "Output file not specified after redirection.");
+                    else snprintf(err, err_sz, "Output file not specified.");
                 }
-                free(c->out_file);
-                c->out_file = strdup(tokens[j + 1]);
-                if (!c->out_file) { if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory."); goto fail; }
-                j++;
-            } else if (strcmp(tokens[j], "2>") == 0) {
-                if (j + 1 >= seg_end || is_op(tokens[j + 1])) {
-                    if (err && err_sz > 0) snprintf(err, err_sz, "Error output file not specified.");
+                goto fail;
+            }
+
+            const char *word = tokens[j + 1];
+            int rc = 0;
+
+            if (is_procsub(word)) {
+                if (err && err_sz > 0) snprintf(err, err_sz, "Process substitution is only supported as an argument.");
+                goto fail;
+            }
+
+            if (strcmp(r.op, "<") == 0) {
+                char *path = strdup(word);
+                rc = path ? push_redir(&rb, REDIR_IN, r.fd, -1, path) : -1;
+            } else if (strcmp(r.op, "<<<") == 0) {
+                // <<< word : the body is the word plus a newline, known right now
+                size_t len = strlen(word);
+                char *body = malloc(len + 2);
+                rc = body ? push_redir(&rb, REDIR_HEREDOC, r.fd, -1, NULL) : -1;
+                if (rc == 0) {
+                    memcpy(body, word, len);
+                    body[len] = '\n';
+                    body[len + 1] = '\0';
+                    c->redirs[c->n_redirs - 1].body = body;
+                    c->redirs[c->n_redirs - 1].body_len = len + 1;
+                } else {
+                    free(body);
+                }
+            } else if (is_here) {
+                // << DELIM : the body follows on the next input lines (read_heredocs)
+                char *delim = strdup(word);
+                rc = delim ? push_redir(&rb, REDIR_HEREDOC, r.fd, -1, delim) : -1;
+                if (rc == 0) c->redirs[c->n_redirs - 1].strip_tabs = (strcmp(r.op, "<<-") == 0);
+            } else if (strcmp(r.op, ">") == 0) {
+                rc = push_output_redir(&rb, REDIR_OUT, r.fd, word);
+            } else if (strcmp(r.op, ">>") == 0) {
+                rc = push_output_redir(&rb, REDIR_APPEND, r.fd, word);
+            } else {
+                int src = is_dup ? parse_dup_target(word) : -1;
+
+                if (src == -2) {
+                    rc = push_redir(&rb, REDIR_CLOSE, r.fd, -1, NULL);
+                } else if (src >= 0) {
+                    rc = push_redir(&rb, REDIR_DUP, r.fd, src, NULL);
+                } else if (r.op[0] == '&' || (strcmp(r.op, ">&") == 0 && !r.explicit_fd)) {
+                    // &> file, &>> file, >& file : open once onto stdout, then dup onto stderr
+                    RedirKind kind = (strcmp(r.op, "&>>") == 0) ? REDIR_APPEND : REDIR_OUT;
+                    rc = push_output_redir(&rb, kind, STDOUT_FD, word);
+                    if (rc == 0) rc = push_redir(&rb, REDIR_DUP, STDERR_FD, STDOUT_FD, NULL);
+                } else {
+                    if (err && err_sz > 0) snprintf(err, err_sz, "Invalid redirection target.");
                     goto fail;
                 }
-                free(c->err_file);
-                c->err_file = strdup(tokens[j + 1]);
-                if (!c->err_file) { if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory."); goto fail; }
-                j++;
             }
+
+            if (rc != 0) { if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory."); goto fail; }
+            j++; // skip filename
         }
+        redir_builder_free(&rb);
 
         // 2) Build argv for this segment (skip redirection tokens)
         if (build_argv(tokens, seg_start, seg_end, &c->argv) != 0) {
@@ -323,15 +689,285 @@ int parse_line(const char *line, Pipeline *out, char *err, size_t err_sz) {
             goto fail;
         }
 
+        // 4) Parse any <(...) / >(...) arguments into inner pipelines
+        if (parse_procsubs(c, err, err_sz) != 0) {
+            goto fail;
+        }
+
         cmd_index++;
         seg_start = i + 1; // next segment starts after '|'
     }
 
+    return 0;
+
+fail:
+    redir_builder_free(&rb);
+    free_pipeline(out);
+    return 1;
+}
+
+// ================ Main parse_line function ================
+
+int parse_line(const char *line, Pipeline *out, char *err, size_t err_sz) {
+    PROBE_PARSE_START(line);
+    pipeline_init(out);
+    if (err && err_sz > 0) err[0] = '\0';
+
+    char **tokens = NULL;
+    int ntok = 0;
+
+    if (tokenize(line, &tokens, &ntok, err, err_sz) != 0) {
+        // tokenizer already filled err
+        PROBE_PARSE_DONE(0, 1, err);
+        return 1;
+    }
+
+    // Blank line => do nothing, but not an error
+    if (ntok == 0) {
+        free_tokens(tokens, ntok);
+        PROBE_PARSE_DONE(0, 1, err);
+        return 1; // main should just reprompt when err is empty
+    }
+
+    // A single pipeline cannot contain ';', '&&' or '||' (use parse_list)
+    for (int i = 0; i < ntok; i++) {
+        if (is_list_op(tokens[i])) {
+            if (err && err_sz > 0) snprintf(err, err_sz, "Unexpected '%s'.", tokens[i]);
+            free_tokens(tokens, ntok);
+            PROBE_PARSE_DONE(ntok, 1, err);
+            return 1;
+        }
+    }
+
+    int rc = parse_pipeline_tokens(tokens, 0, ntok, out, err, err_sz);
+    free_tokens(tokens, ntok);
+    PROBE_PARSE_DONE(ntok, rc, err);
+    return rc;
+}
+
+// ================ Here-document bodies ================
+
+// Append len bytes of text plus a newline to a growing body buffer.
+static int body_append(char **body, size_t *len, size_t *cap, const char *text, size_t n) {
+    if (*len + n + 2 > *cap) {
+        size_t newcap = (*cap == 0) ? 256 : *cap;
+        while (*len + n + 2 > newcap) newcap *= 2;
+        char *tmp = realloc(*body, newcap);
+        if (!tmp) return -1;
+        *body = tmp;
+        *cap = newcap;
+    }
+    memcpy(*body + *len, text, n);
+    *len += n;
+    (*body)[(*len)++] = '\n';
+    (*body)[*len] = '\0';
+    return 0;
+}
+
+// Read the body of the '<<' here-document r from the lines that follow the
+// command, up to a line equal to its delimiter (after tab stripping for '<<-')
+// or end of input.  Returns 0 on success, 1 on OOM with err filled.
+static int read_body(Redir *r, LineReader next_line, void *ctx, char *err, size_t err_sz) {
+    char *body = NULL;
+    size_t len = 0, cap = 0;
+    const char *line;
+
+    while ((line = next_line(ctx)) != NULL) {
+        if (r->strip_tabs) {
+            while (*line == '\t') line++;
+        }
+        if (strcmp(line, r->path) == 0) break;
+
+        if (body_append(&body, &len, &cap, line, strlen(line)) != 0) {
+            free(body);
+            if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory.");
+            return 1;
+        }
+    }
+
+    // An empty body still needs a buffer so the redirection is not pending
+    if (body == NULL) {
+        body = calloc(1, 1);
+        if (!body) {
+            if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory.");
+            return 1;
+        }
+    }
+    r->body = body;
+    r->body_len = len;
+    return 0;
+}
+
+// Copy a body too large for a pipe once into a sealed memfd; each command
+// using the redirection reads it through its own open of it (redir.c), so
+// pmap copies, cached server templates and rerun loops share the one copy.
+// Returns the CLOEXEC fd, or -1 to leave the copy to each command.
+static int stage_body(const char *body, size_t len) {
+    int fd = memfd_create("myshell-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) return -1;
+
+    for (size_t off = 0; off < len; ) {
+        ssize_t n = write(fd, body + off, len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            close(fd);
+            return -1;
+        }
+        off += (size_t)n;
+    }
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Read the body of every pending '<<' here-document of p, in the order they
+// appear on the line, from the lines that follow the command.  Here-documents
+// inside a command's <(...) / >(...) arguments are read before those of the
+// command itself.  Bodies (here-strings too) over HEREDOC_PIPE_MAX are then
+// staged in a memfd.  Returns 0 on success, 1 on OOM with err filled.
+int read_heredocs(Pipeline *p, LineReader next_line, void *ctx,
+                  char *err, size_t err_sz) {
+    for (int i = 0; i < p->n_cmds; i++) {
+        Command *c = &p->cmds[i];
+
+        for (int k = 0; k < c->n_psubs; k++) {
+            if (read_heredocs(c->psubs[k].inner, next_line, ctx, err, err_sz) != 0) return 1;
+        }
+
+        for (int j = 0; j < c->n_redirs; j++) {
+            Redir *r = &c->redirs[j];
+            if (r->kind != REDIR_HEREDOC) continue;
+
+            if (r->body == NULL && read_body(r, next_line, ctx, err, err_sz) != 0) return 1;
+            if (r->body_len > HEREDOC_PIPE_MAX && r->body_fd < 0) {
+                r->body_fd = stage_body(r->body, r->body_len);
+            }
+        }
+    }
+    return 0;
+}
+
+// LineReader over a TextLines: copies the next line of the text into t->buf.
+const char *text_next_line(void *ctx) {
+    TextLines *t = ctx;
+    if (t->next == NULL) return NULL;
+
+    const char *nl = strchr(t->next, '\n');
+    size_t len = nl ? (size_t)(nl - t->next) : strlen(t->next);
+
+    if (len + 1 > t->cap) {
+        char *tmp = realloc(t->buf, len + 1);
+        if (tmp == NULL) return NULL;
+        t->buf = tmp;
+        t->cap = len + 1;
+    }
+    memcpy(t->buf, t->next, len);
+    t->buf[len] = '\0';
+    t->next = (nl && nl[1] != '\0') ? nl + 1 : NULL;
+    return t->buf;
+}
+
+// ================ Command lists: ; && || ================
+
+// Function for freeing all memory allocated inside a CommandList by parse_list().
+void free_list(CommandList *l) {
+    if (l == NULL) return;
+
+    if (l->nodes != NULL) {
+        for (int i = 0; i < l->n_nodes; i++) {
+            free_pipeline(&l->nodes[i].pl);
+        }
+        free(l->nodes);
+    }
+
+    l->nodes = NULL;
+    l->n_nodes = 0;
+}
+
+// Parse a full command line into a list of pipelines joined by ';', '&&', '||'.
+// The line is tokenized once; each pipeline is built from its token range.
+// A trailing ';' is allowed, a trailing '&&' or '||' is not.
+// Returns 0 on success, 1 on error or blank line (err empty for blank).
+int parse_list(const char *line, CommandList *out, char *err, size_t err_sz) {
+    PROBE_PARSE_START(line);
+    out->nodes = NULL;
+    out->n_nodes = 0;
+    if (err && err_sz > 0) err[0] = '\0';
+
+    char **tokens = NULL;
+    int ntok = 0;
+
+    if (tokenize(line, &tokens, &ntok, err, err_sz) != 0) {
+        PROBE_PARSE_DONE(0, 1, err);
+        return 1;
+    }
+
+    if (ntok == 0) {
+        free_tokens(tokens, ntok);
+        PROBE_PARSE_DONE(0, 1, err);
+        return 1;
+    }
+
+    // ----------------------------
+    // A) List syntax validation
+    // ----------------------------
+    // Every list operator needs a command before it, and '&&'/'||' after it
+    int n_nodes = 0;
+    for (int i = 0; i < ntok; i++) {
+        if (!is_list_op(tokens[i])) continue;
+
+        if (i == 0 || is_list_op(tokens[i - 1])) {
+            if (err && err_sz > 0) snprintf(err, err_sz, "Command missing before '%s'.", tokens[i]);
+            goto fail;
+        }
+        if (i == ntok - 1 && strcmp(tokens[i], ";") != 0) {
+            if (err && err_sz > 0) snprintf(err, err_sz, "Command missing after '%s'.", tokens[i]);
+            goto fail;
+        }
+        n_nodes++;
+    }
+    if (!is_list_op(tokens[ntok - 1])) n_nodes++;
+
+    out->nodes = (ListNode*)calloc((size_t)n_nodes, sizeof(ListNode));
+    if (!out->nodes) {
+        if (err && err_sz > 0) snprintf(err, err_sz, "Out of memory.");
+        goto fail;
+    }
+
+    // ----------------------------
+    // B) Parse each pipeline between list operators
+    // ----------------------------
+    ListOp op = LIST_SEQ;
+    int seg_start = 0;
+
+    for (int i = 0; i <= ntok; i++) {
+        if (i < ntok && !is_list_op(tokens[i])) continue;
+        if (i == seg_start) break; // trailing ';'
+
+        ListNode *n = &out->nodes[out->n_nodes];
+        n->op = op;
+        if (parse_pipeline_tokens(tokens, seg_start, i, &n->pl, err, err_sz) != 0) {
+            goto fail;
+        }
+        out->n_nodes++;
+
+        if (i < ntok) {
+            if (strcmp(tokens[i], "&&") == 0)      op = LIST_AND;
+            else if (strcmp(tokens[i], "||") == 0) op = LIST_OR;
+            else                                   op = LIST_SEQ;
+        }
+        seg_start = i + 1;
+    }
+
     free_tokens(tokens, ntok);
+    PROBE_PARSE_DONE(ntok, 0, err);
     return 0;
 
 fail:
     free_tokens(tokens, ntok);
-    free_pipeline(out);
+    free_list(out);
+    PROBE_PARSE_DONE(ntok, 1, err);
     return 1;
 }
@@ -0,0 +1,354 @@
+/* =============================================================================
+ * src/pathcache.c  –  Remembered command lookups (MYSHELL_PATHCACHE, 'hash')
+ *
+ * execvp() walks PATH on every spawn: one failed execve() per directory
+ * before the right one.  start_pipeline() asks pathcache_lookup() in the
+ * parent instead, and the child execv()s the remembered full path, falling
+ * back to execvp() if that fails (so a command that moved is found again,
+ * and scripts without '#!' still run through /bin/sh).
+ *
+ * The table is open-addressed, keyed by command name, and only valid for
+ * the PATH value it was filled under.  Only hits in absolute PATH entries
+ * are remembered; misses are not, so a newly installed command is found
+ * at once.  In the long-lived --server process the table stays warm for
+ * every submission.
+ *
+ * Shared file (MYSHELL_PATHCACHE_FILE=path, off by default):
+ *   A second, fixed-size table mmap()ed MAP_SHARED from a file, so every
+ *   shell on the host starts warm.  It is consulted on a miss in the
+ *   process table above and filled after a PATH search.  Each DiskEntry
+ *   is keyed by (hash of the PATH value, command name) and holds the
+ *   resolved path with the inode / mtime of the file and of its directory.
+ *
+ *   - Validation: one stat() of the directory.  If its mtime is unchanged
+ *     nothing in it was added, removed or renamed, so the entry stands
+ *     without touching the file; otherwise the file is stat()ed and must
+ *     still have the same inode.  (A command newly installed in an earlier
+ *     PATH directory is not noticed, as with the process table; hash -r
+ *     only clears the latter.)
+ *   - Readers never lock: each entry is a seqlock.  The sequence number is
+ *     odd while a writer is inside; a reader copies the entry and retries
+ *     if the sequence was odd or moved meanwhile.
+ *   - Writers take an entry by a compare-and-swap of its even sequence to
+ *     odd, and give up (it is only a cache) if another writer holds it.
+ *     The final even store publishes the whole entry at once.
+ * ============================================================================= */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>      /* printf(), fprintf(), snprintf() */
+#include <stdlib.h>     /* getenv(), free() */
+#include <string.h>     /* strchr(), strcmp(), strdup() */
+#include <stddef.h>     /* offsetof() */
+#include <stdint.h>     /* uint32_t, uint64_t */
+#include <unistd.h>     /* access(), ftruncate(), close() */
+#include <fcntl.h>      /* open() */
+#include <limits.h>     /* PATH_MAX */
+#include <sys/mman.h>   /* mmap() */
+#include <sys/stat.h>   /* stat(), fstat(), S_ISREG */
+#include "pathcache.h"
+#include "hash.h"       /* hash_name() */
+
+#define PATHCACHE_SLOTS 256     /* power of two */
+#define PATHCACHE_PROBE 8       /* slots tried before the home slot is evicted */
+
+/* Search path used by execvp() when PATH is unset */
+#define DEFAULT_PATH "/bin:/usr/bin"
+
+typedef struct {
+    char *name;
+    char *path;
+    unsigned long hits;
+} PathEntry;
+
+static PathEntry table[PATHCACHE_SLOTS];
+static char *table_path_env;    /* PATH the entries were found under */
+
+/* ---- Shared file layout ---- */
+
+#define DISK_MAGIC   0x4d534850u    /* "MSHP" */
+#define DISK_VERSION 1
+#define DISK_SLOTS   1024           /* power of two */
+#define DISK_NAME    64
+#define DISK_PATH    256
+#define DISK_RETRIES 16             /* seqlock read attempts before a miss */
+
+typedef struct {
+    uint32_t seq;                   /* seqlock: odd while being written, 0 = empty */
+    uint32_t pad;
+    uint64_t path_env_hash;         /* hash of the PATH value */
+    uint64_t ino;                   /* of the command file */
+    int64_t  mtime_ns;
+    uint64_t dir_ino;               /* of the directory it was found in */
+    int64_t  dir_mtime_ns;
+    char     name[DISK_NAME];
+    char     path[DISK_PATH];
+} DiskEntry;
+
+typedef struct {
+    uint32_t  magic;
+    uint32_t  version;
+    uint32_t  n_slots;
+    uint32_t  pad;
+    DiskEntry slots[DISK_SLOTS];
+} DiskTable;
+
+static DiskTable *disk;         /* NULL unless pathcache_open() succeeded */
+
+
+static uint64_t hash64(const char *s)
+{
+    uint64_t h = 14695981039346656037ULL;   /* FNV-1a, 64-bit */
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+    return h;
+}
+
+static int64_t mtime_ns(const struct stat *st)
+{
+    return (int64_t)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+
+void pathcache_open(const char *file)
+{
+    struct stat st;
+
+    int fd = open(file, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+
+    /* Growing to full size with zeros yields a valid, empty table */
+    if (fstat(fd, &st) < 0 ||
+        (st.st_size < (off_t)sizeof(DiskTable) && ftruncate(fd, sizeof(DiskTable)) < 0)) {
+        close(fd);
+        return;
+    }
+
+    DiskTable *t = mmap(NULL, sizeof(DiskTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (t == MAP_FAILED) return;
+
+    /* A fresh file gets the header; anything else that does not match is left alone */
+    uint32_t zero = 0;
+    __atomic_compare_exchange_n(&t->magic, &zero, DISK_MAGIC, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    if (t->magic != DISK_MAGIC || (t->version != 0 && t->version != DISK_VERSION)) {
+        munmap(t, sizeof(DiskTable));
+        return;
+    }
+    t->version = DISK_VERSION;
+    t->n_slots = DISK_SLOTS;
+    disk = t;
+}
+
+/* Consistent copy of slot into out; 0 if it is empty or kept changing */
+static int disk_read(const DiskEntry *slot, DiskEntry *out)
+{
+    for (int i = 0; i < DISK_RETRIES; i++) {
+        uint32_t s1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (s1 == 0) return 0;
+        if (s1 & 1) continue;
+
+        memcpy(out, slot, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == s1) return 1;
+    }
+    return 0;
+}
+
+/* Publishes e into slot unless another writer is in it */
+static void disk_write(DiskEntry *slot, const DiskEntry *e)
+{
+    uint32_t s = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+
+    if ((s & 1) || !__atomic_compare_exchange_n(&slot->seq, &s, s + 1, 0,
+                                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy((char *)slot + offsetof(DiskEntry, pad), (const char *)e + offsetof(DiskEntry, pad),
+           sizeof(DiskEntry) - offsetof(DiskEntry, pad));
+    __atomic_store_n(&slot->seq, s + 2, __ATOMIC_RELEASE);
+}
+
+/* Length of the directory part of path ("/usr/bin/ls" -> 8) */
+static size_t dir_len(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash > path ? (size_t)(slash - path) : 1;
+}
+
+/* Looks name up in the shared table; the valid path is copied into out */
+static int disk_lookup(uint64_t env_hash, const char *name, char *out, size_t sz)
+{
+    unsigned long home = (unsigned long)(env_hash ^ hash_name(name)) & (DISK_SLOTS - 1);
+    DiskEntry e;
+    struct stat st;
+    char dir[DISK_PATH];
+
+    for (int i = 0; i < PATHCACHE_PROBE; i++) {
+        DiskEntry *slot = &disk->slots[(home + (unsigned long)i) & (DISK_SLOTS - 1)];
+
+        if (!disk_read(slot, &e)) continue;
+        if (e.path_env_hash != env_hash || strncmp(e.name, name, DISK_NAME) != 0) continue;
+
+        size_t dl = dir_len(e.path);
+        memcpy(dir, e.path, dl);
+        dir[dl] = '\0';
+        if (stat(dir, &st) < 0 || st.st_ino != e.dir_ino) return 0;
+
+        if (mtime_ns(&st) != e.dir_mtime_ns) {
+            /* The directory changed: is this file still the same one? */
+            int64_t dir_mtime = mtime_ns(&st);
+            if (stat(e.path, &st) < 0 || st.st_ino != e.ino || !S_ISREG(st.st_mode)) return 0;
+            e.mtime_ns = mtime_ns(&st);
+            e.dir_mtime_ns = dir_mtime;
+            disk_write(slot, &e);
+        }
+        snprintf(out, sz, "%s", e.path);
+        return 1;
+    }
+    return 0;
+}
+
+static void disk_store(uint64_t env_hash, const char *name, const char *path)
+{
+    unsigned long home = (unsigned long)(env_hash ^ hash_name(name)) & (DISK_SLOTS - 1);
+    DiskEntry e, cur;
+    struct stat st, dst;
+    char dir[DISK_PATH];
+
+    if (strlen(name) >= DISK_NAME || strlen(path) >= DISK_PATH) return;
+
+    size_t dl = dir_len(path);
+    memcpy(dir, path, dl);
+    dir[dl] = '\0';
+    if (stat(path, &st) < 0 || stat(dir, &dst) < 0) return;
+
+    memset(&e, 0, sizeof(e));
+    e.path_env_hash = env_hash;
+    e.ino = st.st_ino;
+    e.mtime_ns = mtime_ns(&st);
+    e.dir_ino = dst.st_ino;
+    e.dir_mtime_ns = mtime_ns(&dst);
+    strcpy(e.name, name);
+    strcpy(e.path, path);
+
+    /* Same key or an empty slot in the probe window, else the home slot */
+    DiskEntry *target = &disk->slots[home];
+    for (int i = 0; i < PATHCACHE_PROBE; i++) {
+        DiskEntry *slot = &disk->slots[(home + (unsigned long)i) & (DISK_SLOTS - 1)];
+        if (!disk_read(slot, &cur) ||
+            (cur.path_env_hash == env_hash && strncmp(cur.name, name, DISK_NAME) == 0)) {
+            target = slot;
+            break;
+        }
+    }
+    disk_write(target, &e);
+}
+
+
+void pathcache_clear(void)
+{
+    for (int i = 0; i < PATHCACHE_SLOTS; i++) {
+        free(table[i].name);
+        free(table[i].path);
+        table[i].name = table[i].path = NULL;
+        table[i].hits = 0;
+    }
+    free(table_path_env);
+    table_path_env = NULL;
+}
+
+
+/* Walks path_env for an executable regular file called name.  Returns 1
+ * (found, cacheable), 2 (found in a relative entry) or 0, with the file
+ * in out. */
+static int search_path(const char *path_env, const char *name, char *out, size_t sz)
+{
+    const char *dir = path_env;
+
+    for (;;) {
+        const char *end = strchr(dir, ':');
+        int len = end ? (int)(end - dir) : (int)strlen(dir);
+        struct stat st;
+
+        /* An empty entry means the current directory */
+        if (len == 0) snprintf(out, sz, "%s", name);
+        else          snprintf(out, sz, "%.*s/%s", len, dir, name);
+
+        if (access(out, X_OK) == 0 && stat(out, &st) == 0 && S_ISREG(st.st_mode)) {
+            return (len > 0 && dir[0] == '/') ? 1 : 2;
+        }
+        if (end == NULL) return 0;
+        dir = end + 1;
+    }
+}
+
+
+const char *pathcache_lookup(const char *name)
+{
+    const char *path_env = getenv("PATH");
+    char found[PATH_MAX];
+
+    if (name == NULL || name[0] == '\0' || strchr(name, '/') != NULL) return NULL;
+    if (path_env == NULL) path_env = DEFAULT_PATH;
+
+    if (table_path_env == NULL || strcmp(table_path_env, path_env) != 0) {
+        pathcache_clear();
+        table_path_env = strdup(path_env);
+        if (table_path_env == NULL) return NULL;
+    }
+
+    unsigned long home = hash_name(name) & (PATHCACHE_SLOTS - 1);
+    PathEntry *free_slot = NULL;
+
+    for (int i = 0; i < PATHCACHE_PROBE; i++) {
+        PathEntry *e = &table[(home + (unsigned long)i) & (PATHCACHE_SLOTS - 1)];
+        if (e->name == NULL) {
+            if (free_slot == NULL) free_slot = e;
+            continue;
+        }
+        if (strcmp(e->name, name) == 0) {
+            e->hits++;
+            return e->path;
+        }
+    }
+
+    uint64_t env_hash = disk ? hash64(path_env) : 0;
+    if (disk == NULL || !disk_lookup(env_hash, name, found, sizeof(found))) {
+        if (search_path(path_env, name, found, sizeof(found)) != 1) return NULL;
+        if (disk != NULL) disk_store(env_hash, name, found);
+    }
+
+    PathEntry *e = free_slot ? free_slot : &table[home];
+    char *n = strdup(name);
+    char *p = strdup(found);
+    if (n == NULL || p == NULL) {
+        free(n);
+        free(p);
+        return NULL;
+    }
+    free(e->name);
+    free(e->path);
+    e->name = n;
+    e->path = p;
+    e->hits = 0;
+    return e->path;
+}
+
+
+int pathcache_builtin(char **argv)
+{
+    if (argv[1] != NULL && strcmp(argv[1], "-r") == 0 && argv[2] == NULL) {
+        pathcache_clear();
+        return 0;
+    }
+    if (argv[1] != NULL) {
+        fprintf(stderr, "usage: hash [-r]\n");
+        return 2;
+    }
+
+    for (int i = 0; i < PATHCACHE_SLOTS; i++) {
+        if (table[i].name != NULL) printf("%6lu  %s\n", table[i].hits, table[i].path);
+    }
+    return 0;
+}
@@ -0,0 +1,404 @@
+/* =============================================================================
+ * src/pmap.c  –  'pmap': one pipeline, N cores, over slices of one input
+ *
+ *   pmap grep -c ERROR < huge.log
+ *   pmap -j 8 awk -f extract.awk < huge.csv > out.csv
+ *   pmap -m sort -m -- sort < huge.txt > sorted.txt
+ *
+ * 'grep < huge.log' reads a 50 GB file on one core.  'pmap' splits the
+ * '<' file of the first command (a regular file) into N byte ranges and
+ * runs N copies of the pipeline at once, each reading only its range:
+ *
+ *   - Boundaries: range i starts just after the first '\n' at or after
+ *     size * i / N, so every line goes to exactly one copy, whole.  Ranges
+ *     that come out empty (short files, very long lines) are dropped.
+ *   - Feeding: each copy's stdin is a pipe that the shell fills with
+ *     splice() straight from the file at the range's own offset; one
+ *     poll() loop keeps all N pipes full, so no copy waits on another.
+ *   - Output: copy 0 writes straight to the final stdout; copies 1..N-1
+ *     write into memfds that are appended to it in order once copy 0 (and
+ *     each earlier one) has finished.  The output is byte-for-byte the
+ *     concatenation of the N outputs in input order.
+ *   - Merge: with  -m WORD... --  every copy writes into a memfd and the
+ *     merge command is run once with /dev/fd/K for each of them appended
+ *     to its arguments, in order (sort -m, paste, awk summing counts...).
+ *
+ * A '>' / '>>' on the stdout of the last command is the destination of
+ * the combined output, not of each copy.  N defaults to the number of
+ * online CPUs (-j N, at most PMAP_MAX_JOBS).
+ *
+ * Status: a copy status above 1 (an error) wins; otherwise 0 if any copy
+ * returned 0, so  pmap grep  is 0 when some slice matched.  With -m the
+ * merge command's status is returned when no copy failed.
+ *
+ * Pipelines without a regular '<' file on the first command run normally.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // pipe2(), splice(), memfd_create(), F_SETPIPE_SZ
+
+#include <stdio.h>      // fprintf(), perror(), snprintf()
+#include <stdlib.h>     // malloc(), calloc(), free(), atoi()
+#include <string.h>     // strcmp(), memchr(), memcpy()
+#include <errno.h>      // errno
+#include <fcntl.h>      // open(), fcntl(), splice(), O_* flags
+#include <unistd.h>     // pread(), write(), close(), lseek(), sysconf()
+#include <signal.h>     // signal(), SIGPIPE
+#include <poll.h>       // poll()
+#include <sys/mman.h>   // memfd_create(), MFD_CLOEXEC
+#include <sys/stat.h>   // fstat(), S_ISREG
+#include "pmap.h"
+#include "exec.h"       // start_pipeline(), wait_job(), execute_pipeline(), copy_fd()
+
+#define FEED_CHUNK   (1 << 20)  /* bytes per splice() into a copy's pipe */
+#define SCAN_CHUNK   65536      /* bytes per pread() looking for '\n' */
+
+/* One copy of the pipeline and its slice of the input */
+typedef struct {
+    off_t off;          /* next byte to feed */
+    off_t end;          /* end of the range */
+    int   in_w;         /* write end of its stdin pipe (-1 once fed) */
+    int   out;          /* memfd with its output (-1: writes to the final fd) */
+    Job   job;
+    int   started;
+} Worker;
+
+
+/* Start of range i: the byte after the first '\n' at or after pos */
+static off_t line_start(int fd, off_t pos, off_t size)
+{
+    char buf[SCAN_CHUNK];
+
+    if (pos <= 0) return 0;
+    for (off_t at = pos - 1; at < size; ) {
+        ssize_t n = pread(fd, buf, sizeof(buf), at);
+        if (n <= 0) break;
+        char *nl = memchr(buf, '\n', (size_t)n);
+        if (nl != NULL) return at + (nl - buf) + 1;
+        at += n;
+    }
+    return size;
+}
+
+
+/* Copies cmd's redirections except those of kind(s) on fd */
+static Redir *drop_redirs(const Command *cmd, int fd, RedirKind k1, RedirKind k2, int *n_out)
+{
+    Redir *r = malloc((size_t)(cmd->n_redirs + 1) * sizeof(Redir));
+    int n = 0;
+
+    if (r == NULL) return NULL;
+    for (int j = 0; j < cmd->n_redirs; j++) {
+        const Redir *s = &cmd->redirs[j];
+        if (s->fd == fd && (s->kind == k1 || s->kind == k2)) continue;
+        r[n++] = *s;
+    }
+    *n_out = n;
+    return r;
+}
+
+
+/* Fills the copies' pipes from in_fd until every range is fed */
+static void feed(Worker *w, int n, int in_fd)
+{
+    struct pollfd *pfd = malloc((size_t)n * sizeof(struct pollfd));
+    int *idx = malloc((size_t)n * sizeof(int));
+    int use_splice = 1;
+    char *buf = NULL;
+
+    if (pfd == NULL || idx == NULL) {
+        perror("malloc (pmap)");
+        goto out;
+    }
+
+    for (;;) {
+        int np = 0;
+        for (int i = 0; i < n; i++) {
+            if (w[i].in_w < 0) continue;
+            pfd[np].fd = w[i].in_w;
+            pfd[np].events = POLLOUT;
+            idx[np++] = i;
+        }
+        if (np == 0) break;
+
+        if (poll(pfd, (nfds_t)np, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("pmap: poll");
+            break;
+        }
+
+        for (int k = 0; k < np; k++) {
+            Worker *c = &w[idx[k]];
+            if (pfd[k].revents == 0) continue;
+
+            size_t want = (size_t)(c->end - c->off) < FEED_CHUNK ? (size_t)(c->end - c->off) : FEED_CHUNK;
+            ssize_t put;
+
+            if (use_splice) {
+                loff_t off = c->off;
+                put = splice(in_fd, &off, c->in_w, NULL, want, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (put < 0 && errno == EINVAL) {
+                    use_splice = 0;     /* filesystem without splice_read */
+                    continue;
+                }
+            } else {
+                if (buf == NULL && (buf = malloc(FEED_CHUNK)) == NULL) {
+                    perror("malloc (pmap)");
+                    goto out;
+                }
+                put = pread(in_fd, buf, want, c->off);
+                if (put > 0) put = write(c->in_w, buf, (size_t)put);  /* short write: re-read the rest */
+            }
+
+            if (put < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            if (put > 0) c->off += put;
+            /* done, input shrank (put == 0) or the copy stopped reading (EPIPE) */
+            if (put <= 0 || c->off >= c->end) {
+                if (put < 0 && errno != EPIPE) perror("pmap: feed");
+                close(c->in_w);
+                c->in_w = -1;
+            }
+        }
+    }
+
+out:
+    for (int i = 0; i < n; i++) {
+        if (w[i].in_w >= 0) close(w[i].in_w);
+        w[i].in_w = -1;
+    }
+    free(buf);
+    free(idx);
+    free(pfd);
+}
+
+
+/* Appends memfd in to out; returns -1 on a write error */
+static int append_output(int in, int out, int append)
+{
+    struct stat in_st, out_st;
+    int read_failed;
+
+    if (lseek(in, 0, SEEK_SET) < 0 || fstat(in, &in_st) < 0 || fstat(out, &out_st) < 0) return -1;
+    if (in_st.st_size == 0) return 0;
+    return copy_fd(in, out, &in_st, &out_st, append, &read_failed);
+}
+
+
+static int combine_status(int acc, int st)
+{
+    if (acc > 1 || st > 1) return acc > st ? acc : st;
+    return acc < st ? acc : st;
+}
+
+
+int pmap_prefixed(const Pipeline *p)
+{
+    return p != NULL && p->n_cmds > 0 && strcmp(p->cmds[0].argv[0], "pmap") == 0;
+}
+
+
+int pmap_execute(const Pipeline *p)
+{
+    char **argv = p->cmds[0].argv;
+    char **merge = NULL;
+    int n_merge = 0;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int k = 1;
+
+    for (; argv[k] != NULL && argv[k][0] == '-'; k++) {
+        if (strcmp(argv[k], "-j") == 0 && argv[k + 1] != NULL) {
+            jobs = atoi(argv[++k]);
+        } else if (strcmp(argv[k], "-m") == 0) {
+            merge = argv + k + 1;
+            while (argv[k + 1] != NULL && strcmp(argv[k + 1], "--") != 0) k++, n_merge++;
+            if (argv[k + 1] == NULL) break;
+            k++;                /* the "--" */
+        } else {
+            break;
+        }
+    }
+    if (argv[k] == NULL || argv[k][0] == '-' || jobs < 1 || (merge != NULL && n_merge == 0)) {
+        fprintf(stderr, "usage: pmap [-j N] [-m merge-command... --] command [args...] < file [| command ...]\n");
+        return 2;
+    }
+    if (jobs > PMAP_MAX_JOBS) jobs = PMAP_MAX_JOBS;
+
+    int n_cmds = p->n_cmds;
+    Command *cmds = malloc((size_t)n_cmds * sizeof(Command));
+    if (cmds == NULL) {
+        perror("malloc (pmap)");
+        return -1;
+    }
+    memcpy(cmds, p->cmds, (size_t)n_cmds * sizeof(Command));
+    cmds[0].argv = argv + k;
+    Pipeline stripped = { cmds, n_cmds };
+
+    /* The input: the last '<' on fd 0 of the first command */
+    const char *in_path = NULL;
+    for (int j = 0; j < cmds[0].n_redirs; j++) {
+        if (cmds[0].redirs[j].kind == REDIR_IN && cmds[0].redirs[j].fd == 0) in_path = cmds[0].redirs[j].path;
+    }
+
+    struct stat st;
+    int in_fd = in_path != NULL ? open(in_path, O_RDONLY | O_CLOEXEC) : -1;
+    if (in_fd < 0 || fstat(in_fd, &st) < 0 || !S_ISREG(st.st_mode) || cmds[0].n_psubs > 0) {
+        if (in_fd >= 0) close(in_fd);
+        int status = execute_pipeline(&stripped);
+        free(cmds);
+        return status;
+    }
+
+    /* The destination: the last '>' / '>>' on fd 1 of the last command */
+    const Command *last = &p->cmds[n_cmds - 1];
+    const Redir *dest = NULL;
+    for (int j = 0; j < last->n_redirs; j++) {
+        const Redir *r = &last->redirs[j];
+        if (r->fd == 1 && (r->kind == REDIR_OUT || r->kind == REDIR_APPEND)) dest = r;
+    }
+
+    /* Ranges */
+    off_t *bound = malloc((size_t)(jobs + 1) * sizeof(off_t));
+    Worker *w = calloc((size_t)jobs, sizeof(Worker));
+    Redir *first_redirs = NULL, *last_redirs = NULL;
+    int status = 0, n = 0, out_fd = STDOUT_FILENO;
+    void (*old_pipe)(int) = SIG_ERR;
+
+    if (bound == NULL || w == NULL) {
+        perror("malloc (pmap)");
+        status = -1;
+        goto out;
+    }
+    bound[0] = 0;
+    for (long i = 1; i <= jobs; i++) {
+        off_t b = i == jobs ? st.st_size : line_start(in_fd, (off_t)(st.st_size / jobs * i + st.st_size % jobs * i / jobs), st.st_size);
+        if (b <= bound[n]) continue;
+        bound[++n] = b;
+    }
+    if (n == 0) bound[++n] = 0;     /* empty file: one copy with empty input */
+
+    /* The copies read their stdin from the pipes and write to out_fd / memfds */
+    first_redirs = drop_redirs(&cmds[0], 0, REDIR_IN, REDIR_IN, &cmds[0].n_redirs);
+    if (first_redirs == NULL) {
+        status = -1;
+        goto out;
+    }
+    cmds[0].redirs = first_redirs;
+    if (dest != NULL) {
+        last_redirs = drop_redirs(&cmds[n_cmds - 1], 1, REDIR_OUT, REDIR_APPEND, &cmds[n_cmds - 1].n_redirs);
+        if (last_redirs == NULL) {
+            status = -1;
+            goto out;
+        }
+        cmds[n_cmds - 1].redirs = last_redirs;
+
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (dest->kind == REDIR_APPEND ? O_APPEND : O_TRUNC);
+        out_fd = open(dest->path, flags, 0666);
+        if (out_fd < 0) {
+            perror(dest->path);
+            status = 1;
+            goto out;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        int pfd[2];
+        w[i].off = bound[i];
+        w[i].end = bound[i + 1];
+        w[i].in_w = -1;
+        w[i].out = -1;
+
+        if ((i > 0 || merge != NULL) && (w[i].out = memfd_create("pmap", MFD_CLOEXEC)) < 0) {
+            perror("memfd_create (pmap)");
+            status = -1;
+            goto reap;
+        }
+        if (pipe2(pfd, O_CLOEXEC) < 0) {
+            perror("pipe (pmap)");
+            status = -1;
+            goto reap;
+        }
+        fcntl(pfd[1], F_SETFL, O_NONBLOCK);     /* the copy's end stays blocking */
+        fcntl(pfd[1], F_SETPIPE_SZ, FEED_CHUNK);
+
+        int started = start_pipeline(&stripped, pfd[0], w[i].out >= 0 ? w[i].out : out_fd, &w[i].job);
+        close(pfd[0]);
+        if (started < 0) {
+            close(pfd[1]);
+            status = -1;
+            goto reap;
+        }
+        w[i].started = 1;
+        if (w[i].off < w[i].end) w[i].in_w = pfd[1];
+        else close(pfd[1]);
+    }
+
+    /* All copies exist: neither a copy that stops reading nor a reader of
+     * the output that goes away may kill the shell (until the relay is done) */
+    old_pipe = signal(SIGPIPE, SIG_IGN);
+    feed(w, n, in_fd);
+
+reap:
+    for (int i = 0; i < n; i++) {
+        if (w[i].in_w >= 0) close(w[i].in_w);
+        w[i].in_w = -1;
+        if (!w[i].started) continue;
+
+        int st_i = wait_job(&w[i].job);
+        if (status >= 0) status = i == 0 ? st_i : combine_status(status, st_i);
+        /* Ordered relay: copy i's output follows everything before it */
+        if (merge == NULL && w[i].out >= 0 && status >= 0 &&
+            append_output(w[i].out, out_fd, dest != NULL && dest->kind == REDIR_APPEND) < 0) {
+            if (errno == EPIPE) {
+                status = 128 + SIGPIPE;     /* as a copy writing there itself would end */
+            } else {
+                perror("pmap: output");
+                status = 1;
+            }
+        }
+    }
+    if (old_pipe != SIG_ERR) signal(SIGPIPE, old_pipe);     /* before the merge command starts */
+
+    if (merge != NULL && status >= 0 && status <= 1) {
+        char **margv = malloc((size_t)(n_merge + n + 1) * sizeof(char *));
+        char (*paths)[32] = malloc((size_t)n * sizeof(*paths));
+        Job mjob;
+
+        if (margv == NULL || paths == NULL) {
+            perror("malloc (pmap)");
+            status = -1;
+        } else {
+            memcpy(margv, merge, (size_t)n_merge * sizeof(char *));
+            for (int i = 0; i < n; i++) {
+                lseek(w[i].out, 0, SEEK_SET);
+                fcntl(w[i].out, F_SETFD, 0);        /* the merge command opens them */
+                snprintf(paths[i], sizeof(paths[i]), "/dev/fd/%d", w[i].out);
+                margv[n_merge + i] = paths[i];
+            }
+            margv[n_merge + n] = NULL;
+
+            Command mcmd = { margv, NULL, 0, NULL, 0 };
+            Pipeline mp = { &mcmd, 1 };
+            if (start_pipeline(&mp, -1, out_fd, &mjob) < 0) {
+                status = -1;
+            } else {
+                status = wait_job(&mjob);
+            }
+        }
+        free(paths);
+        free(margv);
+    }
+
+out:
+    if (w != NULL) {
+        for (int i = 0; i < n; i++) {
+            if (w[i].out >= 0) close(w[i].out);
+        }
+    }
+    if (out_fd != STDOUT_FILENO && out_fd >= 0) close(out_fd);
+    close(in_fd);
+    free(last_redirs);
+    free(first_redirs);
+    free(w);
+    free(bound);
+    free(cmds);
+    return status;
+}
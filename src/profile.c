@@ -0,0 +1,189 @@
+/* =============================================================================
+ * src/profile.c  –  Per-line script profiler (-p / MYSHELL_PROFILE)
+ *
+ * Every command line is charged, by input line number, with:
+ *
+ *   wall       time from the start of parsing to the return of execute_list()
+ *   child usr  user / system CPU of the children reaped meanwhile
+ *   child sys  (getrusage(RUSAGE_CHILDREN) deltas)
+ *   spawns     children started (shell_stats.spawns delta)
+ *   parse      parse_list() time                        } the shell's own
+ *   shell cpu  the shell's own user+system CPU (fork,   } overhead, kept
+ *              pipes, waiting, builtins)                } apart
+ *
+ * Lines run more than once accumulate.  At exit either a table sorted by
+ * wall time (-p, MYSHELL_PROFILE=1) or folded stacks for flamegraph.pl
+ * (MYSHELL_PROFILE=folded) go to stderr; in the folded form each line is
+ * split into a "children" frame (child CPU) and a "shell" frame (shell
+ * CPU, which already covers parsing), in microseconds.
+ * ============================================================================= */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>      /* fprintf() */
+#include <stdlib.h>     /* realloc(), qsort(), free() */
+#include <string.h>     /* memset(), strncpy() */
+#include <sys/resource.h> /* getrusage() */
+#include "profile.h"
+#include "stats.h"      /* stats_now(), shell_stats.spawns */
+
+#define PROFILE_TEXT_LEN 48     /* command text kept per line */
+
+typedef struct {
+    int       lineno;
+    long      runs;
+    long long wall_ns;
+    long long child_usr_ns;
+    long long child_sys_ns;
+    long long spawns;
+    long long parse_ns;
+    long long shell_cpu_ns;
+    char      text[PROFILE_TEXT_LEN];
+} LineProfile;
+
+static LineProfile *lines;      /* indexed by line number */
+static int cap_lines;
+
+/* Snapshot taken by profile_line_begin() */
+static LineProfile *cur;
+static long long    t_begin;
+static struct rusage ru_self, ru_children;
+static unsigned long long spawns_begin;
+
+
+static long long tv_ns(const struct timeval *tv)
+{
+    return (long long)tv->tv_sec * 1000000000LL + (long long)tv->tv_usec * 1000LL;
+}
+
+
+void profile_line_begin(int lineno, const char *line)
+{
+    cur = NULL;
+    if (lineno < 0) return;
+
+    if (lineno >= cap_lines) {
+        int cap = cap_lines ? cap_lines : 256;
+        while (cap <= lineno) cap *= 2;
+        LineProfile *tmp = realloc(lines, (size_t)cap * sizeof(LineProfile));
+        if (tmp == NULL) return;
+        memset(tmp + cap_lines, 0, (size_t)(cap - cap_lines) * sizeof(LineProfile));
+        lines = tmp;
+        cap_lines = cap;
+    }
+
+    cur = &lines[lineno];
+    if (cur->runs == 0) {
+        cur->lineno = lineno;
+        strncpy(cur->text, line, PROFILE_TEXT_LEN - 1);
+    }
+    cur->runs++;
+
+    getrusage(RUSAGE_SELF, &ru_self);
+    getrusage(RUSAGE_CHILDREN, &ru_children);
+    spawns_begin = shell_stats.spawns;
+    t_begin = stats_now();
+}
+
+
+void profile_parse(long long ns)
+{
+    if (cur != NULL) cur->parse_ns += ns;
+}
+
+
+void profile_line_end(void)
+{
+    if (cur == NULL) return;
+
+    struct rusage self, children;
+    long long now = stats_now();
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+
+    cur->wall_ns      += now - t_begin;
+    cur->child_usr_ns += tv_ns(&children.ru_utime) - tv_ns(&ru_children.ru_utime);
+    cur->child_sys_ns += tv_ns(&children.ru_stime) - tv_ns(&ru_children.ru_stime);
+    cur->shell_cpu_ns += tv_ns(&self.ru_utime) + tv_ns(&self.ru_stime)
+                       - tv_ns(&ru_self.ru_utime) - tv_ns(&ru_self.ru_stime);
+    if (shell_stats.spawns >= spawns_begin) {           /* 'stats reset' may intervene */
+        cur->spawns += (long long)(shell_stats.spawns - spawns_begin);
+    }
+    cur = NULL;
+}
+
+
+static int by_wall_desc(const void *a, const void *b)
+{
+    const LineProfile *x = *(const LineProfile * const *)a;
+    const LineProfile *y = *(const LineProfile * const *)b;
+    return (y->wall_ns > x->wall_ns) - (y->wall_ns < x->wall_ns);
+}
+
+/* flamegraph.pl splits frames on ';' */
+static void print_frame_text(const char *s)
+{
+    for (; *s; s++) fputc(*s == ';' ? ',' : *s, stderr);
+}
+
+
+void profile_report(int mode)
+{
+    LineProfile **order = NULL;
+    int n = 0;
+
+    if (mode == PROFILE_OFF) return;
+
+    if (cap_lines > 0) order = malloc((size_t)cap_lines * sizeof(LineProfile *));
+    for (int i = 0; order != NULL && i < cap_lines; i++) {
+        if (lines[i].runs > 0) order[n++] = &lines[i];
+    }
+
+    if (mode == PROFILE_FOLDED) {
+        for (int i = 0; i < n; i++) {
+            const LineProfile *l = order[i];
+            long long child_us = (l->child_usr_ns + l->child_sys_ns) / 1000;
+            /* Not + parse_ns: that is wall time, and the shell's CPU
+             * spent parsing is already in shell_cpu_ns */
+            long long shell_us = l->shell_cpu_ns / 1000;
+
+            fprintf(stderr, "myshell;%d: ", l->lineno);
+            print_frame_text(l->text);
+            fprintf(stderr, ";children %lld\n", child_us);
+            fprintf(stderr, "myshell;%d: ", l->lineno);
+            print_frame_text(l->text);
+            fprintf(stderr, ";shell %lld\n", shell_us);
+        }
+    } else {
+        LineProfile total;
+        memset(&total, 0, sizeof(total));
+
+        qsort(order, (size_t)n, sizeof(LineProfile *), by_wall_desc);
+        fprintf(stderr, "%6s %5s %10s %12s %12s %7s | %9s %12s  %s\n",
+                "line", "runs", "wall ms", "child usr ms", "child sys ms", "spawns",
+                "parse us", "shell cpu ms", "command");
+        for (int i = 0; i < n; i++) {
+            const LineProfile *l = order[i];
+            fprintf(stderr, "%6d %5ld %10.3f %12.3f %12.3f %7lld | %9.1f %12.3f  %s\n",
+                    l->lineno, l->runs, l->wall_ns / 1e6, l->child_usr_ns / 1e6,
+                    l->child_sys_ns / 1e6, l->spawns, l->parse_ns / 1e3,
+                    l->shell_cpu_ns / 1e6, l->text);
+            total.runs         += l->runs;
+            total.wall_ns      += l->wall_ns;
+            total.child_usr_ns += l->child_usr_ns;
+            total.child_sys_ns += l->child_sys_ns;
+            total.spawns       += l->spawns;
+            total.parse_ns     += l->parse_ns;
+            total.shell_cpu_ns += l->shell_cpu_ns;
+        }
+        fprintf(stderr, "%6s %5ld %10.3f %12.3f %12.3f %7lld | %9.1f %12.3f\n",
+                "total", total.runs, total.wall_ns / 1e6, total.child_usr_ns / 1e6,
+                total.child_sys_ns / 1e6, total.spawns, total.parse_ns / 1e3,
+                total.shell_cpu_ns / 1e6);
+    }
+
+    free(order);
+    free(lines);
+    lines = NULL;
+    cap_lines = 0;
+}
@@ -0,0 +1,724 @@
+/* =============================================================================
+ * src/queue.c  –  qsub / qstat / qwait: a persistent job queue
+ *
+ *   qsub make -C proj1 > build1.log
+ *   qsub -q net -p 10 rsync -a src/ host:dst/
+ *   qstat
+ *   qwait 2 3
+ *
+ * 'qsub' appends the pipeline to an on-disk spool and returns at once; a
+ * scheduler process, detached from the terminal (setsid()), runs the jobs
+ * and keeps going after the interactive shell has exited.
+ *
+ * Spool (MYSHELL_QUEUE_DIR, else $XDG_STATE_HOME/myshell/queue, else
+ * ~/.local/state/myshell/queue):
+ *
+ *   spool          append-only log, one tab-separated record per line:
+ *                    S  id prio queue submit_ns cwd command   submitted
+ *                    R  id start_ns                           started
+ *                    D  id status wall_ns user_us sys_us maxrss_kb  done
+ *                  (times are CLOCK_REALTIME ns, status -1 = lost)
+ *   seq            last job id; ids are handed out under flock() on it
+ *   sched.lock     flock()ed by the running scheduler for its lifetime
+ *   sched.log      the scheduler's own stderr
+ *   out/<id>.out   stdout of each job
+ *   out/<id>.err   its stderr
+ *
+ * Every record is one write() on an O_APPEND descriptor, so concurrent
+ * shells and the scheduler never interleave.  The state of a job is the
+ * replay of its records; nothing is ever rewritten.
+ *
+ * Scheduling: at most MYSHELL_QUEUE_MAX jobs (default: online CPUs) run at
+ * once, and at most K of queue NAME with MYSHELL_QUEUE_LIMITS=NAME=K,...
+ * The next job is the pending one with the highest -p priority (default 0)
+ * whose queue is below its limit, oldest first among equals.  Each job
+ * runs in a forked runner (own process group, the submitting directory)
+ * through parse_line() and execute_pipeline(); its status, wall time and
+ * rusage (wait4()) go into the D record.
+ *
+ * The scheduler sleeps in poll() on an inotify watch of the spool and the
+ * runners' pidfds.  After QUEUE_LINGER_MS with nothing to do it drops the
+ * lock, re-reads the spool once more (a 'qsub' that saw the lock held
+ * appended before that) and exits.  Jobs still marked running when a new
+ * scheduler starts belonged to one that died: they are recorded as lost.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // O_CLOEXEC
+
+#include <stdio.h>      // printf(), fprintf(), snprintf(), perror()
+#include <stdlib.h>     // malloc(), realloc(), free(), atol()
+#include <string.h>     // strcmp(), strncmp(), strlen(), memchr(), strdup(), strpbrk()
+#include <errno.h>      // errno
+#include <fcntl.h>      // open(), O_* flags
+#include <unistd.h>     // fork(), setsid(), chdir(), dup2(), pread()
+#include <limits.h>     // PATH_MAX, INT_MAX
+#include <signal.h>     // signal(), sigprocmask()
+#include <poll.h>       // poll()
+#include <time.h>       // clock_gettime()
+#include <sys/file.h>   // flock()
+#include <sys/inotify.h> // inotify_init1(), inotify_add_watch()
+#include <sys/resource.h> // struct rusage
+#include <sys/wait.h>   // wait4(), waitpid()
+#include "queue.h"
+#include "exec.h"       // execute_pipeline(), fork_runner()
+#include "options.h"    // shell_opts.queue_*, options_user_dir(), mkdir_p()
+#include "stats.h"      // stats_now()
+
+#define QJOB_PENDING 0
+#define QJOB_RUNNING 1
+#define QJOB_DONE    2
+
+#define STATUS_LOST  (-1)       /* D record of a job whose scheduler died */
+#define RETRY_MS     1000       /* scheduler: retry a failed fork(); qwait: check the scheduler */
+
+typedef struct {
+    long      id;
+    int       prio;
+    int       state;            /* QJOB_* */
+    char      queue[QUEUE_NAME_MAX];
+    long long submit_ns;
+    long long start_ns;
+    long long wall_ns;
+    int       status;
+    long      user_us, sys_us, maxrss_kb;
+    char     *cwd;
+    char     *cmd;
+    pid_t     pid;              /* scheduler: runner of a job it started */
+    int       pidfd;
+    long long t_start;          /* scheduler: stats_now() at start */
+} QJob;
+
+typedef struct {
+    QJob  *jobs;                /* in id order */
+    int    n_jobs;
+    int    cap;
+    off_t  off;                 /* bytes of the spool applied so far */
+} Spool;
+
+static char qdir[PATH_MAX / 2]; /* spool directory, "" until queue_init() */
+static int sched_lock = -1;     /* scheduler: its flock()ed sched.lock */
+
+
+static long long real_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int queue_init(void)
+{
+    char path[PATH_MAX];
+
+    if (qdir[0] != '\0') return 0;
+
+    if (options_user_dir(qdir, sizeof(qdir), shell_opts.queue_dir, "XDG_STATE_HOME", ".local/state", "queue") < 0) {
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/out", qdir);
+    if (mkdir_p(path) < 0) {
+        fprintf(stderr, "qsub: %s: %s\n", path, strerror(errno));
+        qdir[0] = '\0';
+        return -1;
+    }
+    return 0;
+}
+
+/* Opens qdir/name with flags (plus O_CREAT, O_CLOEXEC) */
+static int qdir_open(const char *name, int flags)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", qdir, name);
+    return open(path, flags | O_CREAT | O_CLOEXEC, 0600);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Spool records
+ * ----------------------------------------------------------------------------- */
+
+static int spool_append(int fd, const char *rec, int len)
+{
+    return (len > 0 && write(fd, rec, (size_t)len) == len) ? 0 : -1;
+}
+
+static QJob *find_job(Spool *s, long id)
+{
+    int lo = 0, hi = s->n_jobs - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (s->jobs[mid].id == id) return &s->jobs[mid];
+        if (s->jobs[mid].id < id) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return NULL;
+}
+
+static void apply_record(Spool *s, char *line)
+{
+    char *f[7];
+    int nf = 1;
+
+    f[0] = line;
+    for (char *p = line; *p != '\0' && nf < 7; p++) {
+        if (*p == '\t') {
+            *p = '\0';
+            f[nf++] = p + 1;
+        }
+    }
+    if (nf < 3) return;
+
+    long id = atol(f[1]);
+    QJob *j = find_job(s, id);
+
+    if (strcmp(f[0], "S") == 0 && nf == 7 && j == NULL) {
+        if (s->n_jobs > 0 && id < s->jobs[s->n_jobs - 1].id) return;    /* not from qsub */
+        if (s->n_jobs == s->cap) {
+            int cap = s->cap ? s->cap * 2 : 64;
+            QJob *tmp = realloc(s->jobs, (size_t)cap * sizeof(QJob));
+            if (tmp == NULL) return;
+            s->jobs = tmp;
+            s->cap = cap;
+        }
+        j = &s->jobs[s->n_jobs];
+        memset(j, 0, sizeof(*j));
+        j->id = id;
+        j->prio = atoi(f[2]);
+        snprintf(j->queue, sizeof(j->queue), "%s", f[3]);
+        j->submit_ns = atoll(f[4]);
+        j->cwd = strdup(f[5]);
+        j->cmd = strdup(f[6]);
+        j->pidfd = -1;
+        if (j->cwd == NULL || j->cmd == NULL) {
+            free(j->cwd);
+            free(j->cmd);
+            return;
+        }
+        s->n_jobs++;
+    } else if (strcmp(f[0], "R") == 0 && j != NULL && j->state == QJOB_PENDING) {
+        j->state = QJOB_RUNNING;
+        j->start_ns = atoll(f[2]);
+    } else if (strcmp(f[0], "D") == 0 && j != NULL && nf == 7) {
+        j->state = QJOB_DONE;
+        j->status = atoi(f[2]);
+        j->wall_ns = atoll(f[3]);
+        j->user_us = atol(f[4]);
+        j->sys_us = atol(f[5]);
+        j->maxrss_kb = atol(f[6]);
+    }
+}
+
+/* Applies the records appended since the last call; a partial last record
+ * (still being written) is left for the next one */
+static void spool_load(Spool *s, int fd)
+{
+    static char buf[65536];
+
+    for (;;) {
+        ssize_t n = pread(fd, buf, sizeof(buf), s->off);
+        if (n <= 0) break;
+
+        char *p = buf, *end = buf + n, *nl;
+        while ((nl = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+            *nl = '\0';
+            apply_record(s, p);
+            s->off += nl + 1 - p;
+            p = nl + 1;
+        }
+        if (p == buf) break;
+    }
+}
+
+static void spool_free(Spool *s)
+{
+    for (int i = 0; i < s->n_jobs; i++) {
+        if (s->jobs[i].pidfd >= 0) close(s->jobs[i].pidfd);
+        free(s->jobs[i].cwd);
+        free(s->jobs[i].cmd);
+    }
+    free(s->jobs);
+}
+
+static int record_done(int fd, QJob *j, int status, const struct rusage *ru)
+{
+    char rec[160];
+
+    j->state = QJOB_DONE;
+    j->status = status;
+    j->wall_ns = status == STATUS_LOST ? 0 : stats_now() - j->t_start;
+    if (ru != NULL) {
+        j->user_us = ru->ru_utime.tv_sec * 1000000L + ru->ru_utime.tv_usec;
+        j->sys_us = ru->ru_stime.tv_sec * 1000000L + ru->ru_stime.tv_usec;
+        j->maxrss_kb = ru->ru_maxrss;
+    }
+    int len = snprintf(rec, sizeof(rec), "D\t%ld\t%d\t%lld\t%ld\t%ld\t%ld\n",
+                       j->id, status, j->wall_ns, j->user_us, j->sys_us, j->maxrss_kb);
+    return spool_append(fd, rec, len);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * Scheduler
+ * ----------------------------------------------------------------------------- */
+
+/* MYSHELL_QUEUE_LIMITS entry for queue q, or INT_MAX */
+static int queue_limit(const char *q)
+{
+    const char *p = shell_opts.queue_limits;
+    size_t qn = strlen(q);
+
+    while (p != NULL && *p != '\0') {
+        p += strspn(p, " ,");
+        if (strncmp(p, q, qn) == 0 && p[qn] == '=') return atoi(p + qn + 1);
+        p += strcspn(p, " ,");
+    }
+    return INT_MAX;
+}
+
+/* Body of a job's runner (fork_runner(), own process group) */
+static int run_job(void *ctx)
+{
+    const QJob *j = ctx;
+    char path[PATH_MAX], err[256];
+    Pipeline p;
+
+    close(sched_lock);          /* a runner must not keep a dead scheduler's lock */
+    snprintf(path, sizeof(path), "%s/out/%ld.out", qdir, j->id);
+    int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    snprintf(path, sizeof(path), "%s/out/%ld.err", qdir, j->id);
+    int errfd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (out < 0 || errfd < 0 || dup2(out, STDOUT_FILENO) < 0 || dup2(errfd, STDERR_FILENO) < 0) return 126;
+    close(out);
+    close(errfd);
+
+    if (chdir(j->cwd) < 0) {
+        fprintf(stderr, "myshell: %s: %s\n", j->cwd, strerror(errno));
+        return 1;
+    }
+    if (parse_line(j->cmd, &p, err, sizeof(err)) != 0) {
+        fprintf(stderr, "myshell: %s\n", err);
+        return 2;
+    }
+    return execute_pipeline(&p);
+}
+
+static int start_job(QJob *j, int spool_fd)
+{
+    char rec[64];
+
+    pid_t pid = fork_runner(run_job, j, 1, &j->pidfd, "qsub: fork");
+    if (pid < 0) return -1;
+
+    j->pid = pid;
+    j->state = QJOB_RUNNING;
+    j->t_start = stats_now();
+    j->start_ns = real_now();
+    int len = snprintf(rec, sizeof(rec), "R\t%ld\t%lld\n", j->id, j->start_ns);
+    return spool_append(spool_fd, rec, len);
+}
+
+/* Starts pending jobs while the limits allow; returns the number running */
+static int dispatch(Spool *s, int spool_fd, int max_jobs)
+{
+    for (;;) {
+        int running = 0;
+        QJob *best = NULL;
+
+        for (int i = 0; i < s->n_jobs; i++) running += s->jobs[i].state == QJOB_RUNNING;
+        if (running >= max_jobs) return running;
+
+        for (int i = 0; i < s->n_jobs; i++) {
+            QJob *j = &s->jobs[i];
+            if (j->state != QJOB_PENDING || (best != NULL && j->prio <= best->prio)) continue;
+
+            int in_queue = 0;
+            for (int k = 0; k < s->n_jobs; k++) {
+                in_queue += s->jobs[k].state == QJOB_RUNNING && strcmp(s->jobs[k].queue, j->queue) == 0;
+            }
+            if (in_queue < queue_limit(j->queue)) best = j;
+        }
+        if (best == NULL || start_job(best, spool_fd) < 0) return running;
+    }
+}
+
+/* Reaps the finished runners */
+static void reap(Spool *s, int spool_fd)
+{
+    for (int i = 0; i < s->n_jobs; i++) {
+        QJob *j = &s->jobs[i];
+        struct rusage ru;
+        int ws;
+
+        if (j->state != QJOB_RUNNING || j->pid <= 0 || wait4(j->pid, &ws, WNOHANG, &ru) != j->pid) continue;
+        if (j->pidfd >= 0) close(j->pidfd);
+        j->pidfd = -1;
+        j->pid = 0;
+        record_done(spool_fd, j, WIFEXITED(ws) ? WEXITSTATUS(ws) : 128 + WTERMSIG(ws), &ru);
+    }
+}
+
+static int schedule(void)
+{
+    Spool s = { NULL, 0, 0, 0 };
+    char path[PATH_MAX];
+    long long idle_since = 0;
+
+    sched_lock = qdir_open("sched.lock", O_RDWR);
+    if (sched_lock < 0 || flock(sched_lock, LOCK_EX | LOCK_NB) < 0) return 0;  /* one is running */
+
+    int spool_fd = qdir_open("spool", O_RDWR | O_APPEND);
+    int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    snprintf(path, sizeof(path), "%s/spool", qdir);
+    if (spool_fd < 0 || ifd < 0 || inotify_add_watch(ifd, path, IN_MODIFY) < 0) {
+        perror("qsub: scheduler");
+        return 1;
+    }
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_jobs = shell_opts.queue_max > 0 ? shell_opts.queue_max : (ncpu > 0 ? (int)ncpu : 1);
+
+    spool_load(&s, spool_fd);
+    for (int i = 0; i < s.n_jobs; i++) {
+        if (s.jobs[i].state == QJOB_RUNNING) record_done(spool_fd, &s.jobs[i], STATUS_LOST, NULL);
+    }
+
+    struct pollfd *pfd = NULL;
+    for (;;) {
+        int running = dispatch(&s, spool_fd, max_jobs);
+        int pending = 0, timeout = -1;
+
+        for (int i = 0; i < s.n_jobs; i++) pending += s.jobs[i].state == QJOB_PENDING;
+
+        if (running == 0 && pending == 0) {
+            long long now = stats_now();
+            if (idle_since == 0) idle_since = now;
+            long long left = QUEUE_LINGER_MS - (now - idle_since) / 1000000;
+            if (left <= 0) {
+                /* A qsub that found the lock held has already appended */
+                flock(sched_lock, LOCK_UN);
+                spool_load(&s, spool_fd);
+                pending = 0;
+                for (int i = 0; i < s.n_jobs; i++) pending += s.jobs[i].state == QJOB_PENDING;
+                if (pending == 0 || flock(sched_lock, LOCK_EX | LOCK_NB) < 0) break;
+                idle_since = 0;
+                continue;
+            }
+            timeout = (int)left;
+        } else {
+            idle_since = 0;
+            if (running == 0) timeout = RETRY_MS;
+        }
+
+        /* The inotify fd, then one pidfd per running job */
+        struct pollfd *tmp = realloc(pfd, (size_t)(running + 1) * sizeof(struct pollfd));
+        if (tmp == NULL) break;
+        pfd = tmp;
+        int np = 0;
+        pfd[np++] = (struct pollfd){ ifd, POLLIN, 0 };
+        for (int i = 0; i < s.n_jobs && np <= running; i++) {
+            if (s.jobs[i].state != QJOB_RUNNING) continue;
+            if (s.jobs[i].pidfd >= 0) pfd[np++] = (struct pollfd){ s.jobs[i].pidfd, POLLIN, 0 };
+            else timeout = RETRY_MS / 10;   /* no pidfd_open(): check now and then */
+        }
+
+        if (poll(pfd, (nfds_t)np, timeout) < 0 && errno != EINTR) {
+            perror("qsub: scheduler: poll");
+            break;
+        }
+        if (pfd[0].revents & POLLIN) {
+            char ev[4096];
+            while (read(ifd, ev, sizeof(ev)) > 0) ;
+            spool_load(&s, spool_fd);
+        }
+        reap(&s, spool_fd);
+    }
+
+    free(pfd);
+    spool_free(&s);
+    return 0;
+}
+
+/* Starts a detached scheduler unless one holds the lock */
+static void ensure_scheduler(void)
+{
+    int fd = qdir_open("sched.lock", O_RDWR);
+    if (fd < 0) return;
+    int idle = flock(fd, LOCK_EX | LOCK_NB) == 0;
+    close(fd);
+    if (!idle) return;
+
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("qsub: fork");
+        return;
+    }
+    if (pid == 0) {
+        /* Own session, reparented to init: outlives this shell and its terminal */
+        setsid();
+        if (fork() != 0) _exit(0);
+
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+
+        int null = open("/dev/null", O_RDONLY);
+        int log = qdir_open("sched.log", O_WRONLY | O_APPEND);
+        if (null >= 0) dup2(null, STDIN_FILENO);
+        if (log >= 0) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+        }
+        _exit(schedule());
+    }
+    waitpid(pid, NULL, 0);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * qsub / qstat / qwait
+ * ----------------------------------------------------------------------------- */
+
+int queue_prefixed(const Pipeline *p)
+{
+    return p != NULL && p->n_cmds > 0 && strcmp(p->cmds[0].argv[0], "qsub") == 0;
+}
+
+/* Appends word (and a separating space) to buf; -1 if it does not fit */
+static int put_word(char *buf, size_t *len, const char *word)
+{
+    int n = snprintf(buf + *len, QUEUE_MAX_COMMAND - *len, "%s%s", *len > 0 ? " " : "", word);
+    if (n < 0 || (size_t)n >= QUEUE_MAX_COMMAND - *len) return -1;
+    *len += (size_t)n;
+    return 0;
+}
+
+/* Turns p back into a command line that parse_line() reads as p.  The
+ * parser has no quoting, so every word is written as it is. */
+static int unparse(const Pipeline *p, char **argv, char *buf, const char **why)
+{
+    size_t len = 0;
+    char word[PATH_MAX + 16];
+
+    for (int i = 0; i < p->n_cmds; i++) {
+        const Command *c = &p->cmds[i];
+
+        if (c->n_psubs > 0) {
+            *why = "process substitutions cannot be queued";
+            return -1;
+        }
+        if (i > 0 && put_word(buf, &len, "|") < 0) goto too_long;
+        for (char **w = i == 0 ? argv : c->argv; *w != NULL; w++) {
+            if (put_word(buf, &len, *w) < 0) goto too_long;
+        }
+        for (int j = 0; j < c->n_redirs; j++) {
+            const Redir *r = &c->redirs[j];
+            switch (r->kind) {
+            case REDIR_IN:     snprintf(word, sizeof(word), "%.0d< %s", r->fd, r->path); break;
+            case REDIR_OUT:    snprintf(word, sizeof(word), "%.0d> %s", r->fd == 1 ? 0 : r->fd, r->path); break;
+            case REDIR_APPEND: snprintf(word, sizeof(word), "%.0d>> %s", r->fd == 1 ? 0 : r->fd, r->path); break;
+            case REDIR_DUP:    snprintf(word, sizeof(word), "%d>&%d", r->fd, r->src_fd); break;
+            case REDIR_CLOSE:  snprintf(word, sizeof(word), "%d>&-", r->fd); break;
+            default:
+                *why = "here-documents cannot be queued";
+                return -1;
+            }
+            if (put_word(buf, &len, word) < 0) goto too_long;
+        }
+    }
+    return 0;
+
+too_long:
+    *why = "command line too long";
+    return -1;
+}
+
+int queue_submit(const Pipeline *p)
+{
+    char **argv = p->cmds[0].argv;
+    const char *queue = QUEUE_DEFAULT, *why = NULL;
+    int prio = 0, k = 1;
+
+    for (; argv[k] != NULL && argv[k][0] == '-'; k++) {
+        if (strcmp(argv[k], "-q") == 0 && argv[k + 1] != NULL) queue = argv[++k];
+        else if (strcmp(argv[k], "-p") == 0 && argv[k + 1] != NULL) prio = atoi(argv[++k]);
+        else break;
+    }
+    if (argv[k] == NULL || argv[k][0] == '-' || strlen(queue) >= QUEUE_NAME_MAX) {
+        fprintf(stderr, "usage: qsub [-q queue] [-p priority] command [args...] [| command ...]\n");
+        return 2;
+    }
+
+    char cwd[PATH_MAX];
+    char *cmd = malloc(QUEUE_MAX_COMMAND);
+    char *rec = malloc(QUEUE_MAX_COMMAND + PATH_MAX + 128);
+    int status = 1;
+
+    if (cmd == NULL || rec == NULL) {
+        perror("malloc (qsub)");
+        goto out;
+    }
+    if (getcwd(cwd, sizeof(cwd)) == NULL || strpbrk(cwd, "\t\n") != NULL) {
+        fprintf(stderr, "qsub: cannot record the current directory\n");
+        goto out;
+    }
+    if (unparse(p, argv + k, cmd, &why) < 0) {
+        fprintf(stderr, "qsub: %s\n", why);
+        goto out;
+    }
+    if (queue_init() < 0) goto out;
+
+    /* Next id under the lock on seq; the S record is appended while holding it */
+    int seq_fd = qdir_open("seq", O_RDWR);
+    int spool_fd = qdir_open("spool", O_WRONLY | O_APPEND);
+    char num[32] = "";
+    long id = 0;
+
+    if (seq_fd < 0 || spool_fd < 0 || flock(seq_fd, LOCK_EX) < 0) {
+        perror("qsub: spool");
+    } else {
+        ssize_t n = pread(seq_fd, num, sizeof(num) - 1, 0);
+        id = (n > 0 ? atol(num) : 0) + 1;
+        int len = snprintf(num, sizeof(num), "%ld\n", id);
+        int rlen = snprintf(rec, QUEUE_MAX_COMMAND + PATH_MAX + 128, "S\t%ld\t%d\t%s\t%lld\t%s\t%s\n",
+                            id, prio, queue, real_now(), cwd, cmd);
+        if (pwrite(seq_fd, num, (size_t)len, 0) != len || spool_append(spool_fd, rec, rlen) < 0) {
+            perror("qsub: spool");
+            id = 0;
+        }
+        flock(seq_fd, LOCK_UN);
+    }
+    if (seq_fd >= 0) close(seq_fd);
+    if (spool_fd >= 0) close(spool_fd);
+
+    if (id > 0) {
+        printf("%ld\n", id);
+        fflush(stdout);
+        ensure_scheduler();
+        status = 0;
+    }
+
+out:
+    free(rec);
+    free(cmd);
+    return status;
+}
+
+/* Opens and reads the spool into s; -1 if there is none */
+static int load_all(Spool *s)
+{
+    if (queue_init() < 0) return -1;
+    int fd = qdir_open("spool", O_RDONLY);
+    if (fd < 0) return -1;
+    spool_load(s, fd);
+    return fd;
+}
+
+int queue_stat_builtin(char **argv)
+{
+    Spool s = { NULL, 0, 0, 0 };
+    int fd = load_all(&s);
+    long long now = real_now();
+
+    if (fd < 0) {
+        fprintf(stderr, "qstat: no spool\n");
+        return 1;
+    }
+    close(fd);
+
+    printf("%6s %-12s %4s %-8s %6s %9s %9s %9s  %s\n",
+           "ID", "QUEUE", "PRI", "STATE", "STATUS", "WALL", "CPU", "MAXRSS_KB", "COMMAND");
+    for (int i = 0; i < s.n_jobs; i++) {
+        const QJob *j = &s.jobs[i];
+        int wanted = argv[1] == NULL;
+        for (int k = 1; argv[k] != NULL && !wanted; k++) wanted = atol(argv[k]) == j->id;
+        if (!wanted) continue;
+
+        const char *state = j->state == QJOB_PENDING ? "pending" :
+                            j->state == QJOB_RUNNING ? "running" :
+                            j->status == STATUS_LOST ? "lost" : "done";
+        char st[16] = "-", wall[24] = "-", cpu[24] = "-", rss[24] = "-";
+        if (j->state == QJOB_RUNNING) {
+            snprintf(wall, sizeof(wall), "%.2fs", (now - j->start_ns) / 1e9);
+        } else if (j->state == QJOB_DONE && j->status != STATUS_LOST) {
+            snprintf(st, sizeof(st), "%d", j->status);
+            snprintf(wall, sizeof(wall), "%.2fs", j->wall_ns / 1e9);
+            snprintf(cpu, sizeof(cpu), "%.2fs", (j->user_us + j->sys_us) / 1e6);
+            snprintf(rss, sizeof(rss), "%ld", j->maxrss_kb);
+        }
+        printf("%6ld %-12s %4d %-8s %6s %9s %9s %9s  %s\n",
+               j->id, j->queue, j->prio, state, st, wall, cpu, rss, j->cmd);
+    }
+    spool_free(&s);
+    return 0;
+}
+
+/* Is job id one that qwait argv waits for?  (no ids: every job up to last) */
+static int waited_for(long id, char **argv, long last)
+{
+    if (argv[1] == NULL) return id <= last;
+    for (int k = 1; argv[k] != NULL; k++) {
+        if (atol(argv[k]) == id) return 1;
+    }
+    return 0;
+}
+
+int queue_wait_builtin(char **argv)
+{
+    Spool s = { NULL, 0, 0, 0 };
+    char path[PATH_MAX];
+    int status = 0, ifd = -1;
+
+    for (int k = 1; argv[k] != NULL; k++) {
+        if (atol(argv[k]) <= 0) {
+            fprintf(stderr, "usage: qwait [id...]\n");
+            return 2;
+        }
+    }
+
+    int fd = load_all(&s);
+    if (fd < 0) return argv[1] == NULL ? 0 : 1;
+    long last = s.n_jobs > 0 ? s.jobs[s.n_jobs - 1].id : 0;
+
+    for (int k = 1; argv[k] != NULL; k++) {
+        if (find_job(&s, atol(argv[k])) == NULL) {
+            fprintf(stderr, "qwait: no job %s\n", argv[k]);
+            status = 1;
+            goto out;
+        }
+    }
+
+    ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    snprintf(path, sizeof(path), "%s/spool", qdir);
+    if (ifd >= 0) inotify_add_watch(ifd, path, IN_MODIFY);
+
+    for (;;) {
+        int done = 1;
+
+        status = 0;
+        for (int i = 0; i < s.n_jobs; i++) {
+            const QJob *j = &s.jobs[i];
+            if (!waited_for(j->id, argv, last)) continue;
+            if (j->state != QJOB_DONE) done = 0;
+            else if (status == 0 && j->status != 0) status = j->status == STATUS_LOST ? 255 : j->status;
+        }
+        if (done) break;
+
+        /* Woken by the scheduler's records; on a quiet second make sure it still runs */
+        struct pollfd pfd = { ifd, POLLIN, 0 };
+        if (poll(&pfd, ifd >= 0 ? 1 : 0, RETRY_MS) == 0) ensure_scheduler();
+        char ev[4096];
+        while (ifd >= 0 && read(ifd, ev, sizeof(ev)) > 0) ;
+        spool_load(&s, fd);
+    }
+
+out:
+    if (ifd >= 0) close(ifd);
+    close(fd);
+    spool_free(&s);
+    return status;
+}
@@ -3,131 +3,449 @@
  *
  * Responsibility:
  *   Implements apply_redirections(), which is called inside each child
- *   process after fork() but before execvp().  It translates the in_file,
- *   out_file, and err_file fields of a Command struct into actual file-
- *   descriptor operations using open(2) and dup2(2).
+ *   process after fork() but before execvp().  It executes the ordered list
+ *   of Redir actions of a Command (open, dup, close) using open(2), dup2(2)
+ *   and close(2).
  *
  * Design notes:
- *   - Only fields that are non-NULL trigger a redirection; NULL means
- *     "use the inherited descriptor", i.e. no change.
- *   - dup2() atomically replaces the target descriptor (STDIN_FILENO,
- *     STDOUT_FILENO, STDERR_FILENO) with a duplicate of the opened fd.
- *     The original fd from open() is closed immediately after dup2()
- *     so it does not leak into the exec'd program.
- *   - Output files are created if they do not exist and truncated to zero
- *     length if they do (matching standard shell '>' semantics).
+ *   - Actions run strictly in command-line order, so  > f 2>&1  sends both
+ *     streams to f while  2>&1 > f  sends stderr to the old stdout.
+ *   - A file is opened exactly once per action; "&> f" and "> f 2> f" are
+ *     compiled by the parser into one open plus a REDIR_DUP, so both fds
+ *     share one file description (and one offset) instead of clobbering
+ *     each other.
+ *   - dup2() atomically replaces the target descriptor with a duplicate of
+ *     the opened fd.  The original fd from open() is closed immediately
+ *     after dup2() so it does not leak into the exec'd program.
+ *   - '>' creates and truncates, '>>' creates and opens with O_APPEND.
+ *   - Regular '<' files get posix_fadvise(SEQUENTIAL) and WILLNEED on the
+ *     first window before exec, so the disk is already busy with a large
+ *     input while the program loads (MYSHELL_READAHEAD=0 disables).
+ *   - Here-documents and here-strings never touch the filesystem: a body
+ *     that fits in the pipe buffer is written into a pipe, a larger one was
+ *     staged by the parser in a sealed memfd that is reopened here (see
+ *     install_heredoc()).
  *   - All error messages go to stderr and use the exact phrasing required
- *     by the project specification.
+ *     by the project specification.  They are written with a single
+ *     write(2) (child_error()), never through stdio: this code runs between
+ *     fork() and exec, in libmyshell possibly in a threaded process, where
+ *     another thread may have held stdio's lock at the time of fork().
  * ============================================================================= */
 
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE     /* memfd_create(), F_GETPIPE_SZ, F_ADD_SEALS */
 
-#include <fcntl.h>      /* open(), O_RDONLY, O_WRONLY, O_CREAT, O_TRUNC */
-#include <unistd.h>     /* dup2(), close(), STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO */
-#include <stdio.h>      /* fprintf(), perror() */
+#include <fcntl.h>      /* open(), posix_fadvise(), O_RDONLY, O_WRONLY, O_CREAT, O_TRUNC, O_APPEND */
+#include <unistd.h>     /* dup2(), close(), write(), lseek() */
+#include <sys/mman.h>   /* memfd_create(), MFD_CLOEXEC, MFD_ALLOW_SEALING */
+#include <sys/stat.h>   /* fstat(), S_ISREG */
+#include <string.h>     /* strlen(), memcpy(), strerrordesc_np() */
+#include <errno.h>      /* errno */
+#include <limits.h>     /* PATH_MAX */
 
 #include "exec.h"       /* apply_redirections() declaration + Command typedef */
+#include "probes.h"     /* PROBE_REDIR */
+
+/* How much of a '<' file is queued for reading before exec (the kernel's
+ * sequential readahead takes over from there once the command reads) */
+#define READAHEAD_WINDOW (8L * 1024 * 1024)
 
 
 /* -----------------------------------------------------------------------------
- * apply_redirections()
- *
- * Sets up the three possible file-descriptor redirections for one command:
+ * Child-side messages
  *
- *   Input  redirection  (<)  : cmd->in_file  → STDIN_FILENO
- *   Output redirection  (>)  : cmd->out_file → STDOUT_FILENO
- *   Error  redirection  (2>) : cmd->err_file → STDERR_FILENO
- *
- * Called in the child process; a failure causes the child to exit(1) so
- * the parent detects a non-zero exit status.
+ * put_str() / put_int() append to a message buffer without stdio (they
+ * truncate instead of overflowing); child_error() writes
+ * "<what>: <description of err>" the way perror() would.  strerrordesc_np()
+ * is a table lookup: no locale, no allocation.
+ * ----------------------------------------------------------------------------- */
+typedef struct {
+    char   buf[PATH_MAX + 128];
+    size_t len;
+} Msg;
+
+static void put_str(Msg *m, const char *s)
+{
+    size_t n = strlen(s);
+    if (n > sizeof(m->buf) - m->len) n = sizeof(m->buf) - m->len;
+    memcpy(m->buf + m->len, s, n);
+    m->len += n;
+}
+
+static void put_int(Msg *m, int v)
+{
+    char digits[12];
+    int n = 0;
+    unsigned u = v < 0 ? 0U - (unsigned)v : (unsigned)v;
+
+    do {
+        digits[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    if (v < 0) digits[n++] = '-';
+
+    char s[13];
+    for (int i = 0; i < n; i++) s[i] = digits[n - 1 - i];
+    s[n] = '\0';
+    put_str(m, s);
+}
+
+static void put_errno(Msg *m, int err)
+{
+    const char *desc = strerrordesc_np(err);
+
+    put_str(m, ": ");
+    if (desc != NULL) {
+        put_str(m, desc);
+    } else {
+        put_str(m, "Unknown error ");
+        put_int(m, err);
+    }
+    put_str(m, "\n");
+}
+
+static void msg_write(const Msg *m)
+{
+    if (write(STDERR_FILENO, m->buf, m->len) < 0) { /* nothing left to report to */ }
+}
+
+/* perror(what), with errno saved by the caller */
+static void child_error(const char *what, int err)
+{
+    Msg m = { .len = 0 };
+
+    put_str(&m, what);
+    put_errno(&m, err);
+    msg_write(&m);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * open_onto()
  *
- * Parameters:
- *   cmd  – pointer to the Command whose redirection fields are inspected
+ * Opens path with the given flags and installs it on target_fd.  If open()
+ * happens to return target_fd itself (because it was closed), no dup2() is
+ * needed.
  *
- * Returns:
- *    0  on success (all requested redirections applied)
- *   -1  on any failure (error already printed to stderr)
+ * Returns 0 on success, -1 on failure with errno set (nothing printed).
  * ----------------------------------------------------------------------------- */
-int apply_redirections(const Command *cmd)
+static int open_onto(const char *path, int flags, int target_fd)
 {
-    /* ------------------------------------------------------------------
-     * Input redirection:  command < file
-     *
-     * Open the file read-only.  If it does not exist, report the
-     * spec-required "File not found." message and abort.
-     * ------------------------------------------------------------------ */
-    if (cmd->in_file != NULL) {
-        /* O_RDONLY: open for reading only; file must already exist */
-        int fd = open(cmd->in_file, O_RDONLY);
-        if (fd < 0) {
-            /* The spec requires this exact phrasing for a missing input file */
-            fprintf(stderr, "File not found.\n");
-            return -1;
-        }
+    int fd = open(path, flags, 0644);
+    if (fd < 0) return -1;
 
-        /* Replace the child's stdin with this file descriptor.
-         * After dup2() the child will read from the file instead of the
-         * terminal (or the previous pipe end). */
-        if (dup2(fd, STDIN_FILENO) < 0) {
-            perror("dup2: stdin redirection");
+    if (fd != target_fd) {
+        if (dup2(fd, target_fd) < 0) {
+            int saved = errno;
             close(fd);
+            errno = saved;
             return -1;
         }
+        /* Close the original fd; we only need target_fd from now on */
+        close(fd);
+    }
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * advise_sequential()
+ *
+ * Hints the kernel that fd (a freshly opened '<' file) will be read once,
+ * front to back: doubles the readahead window with POSIX_FADV_SEQUENTIAL and
+ * queues reads of the first READAHEAD_WINDOW bytes with POSIX_FADV_WILLNEED.
+ * Unlike readahead(2), which returns only once those pages are read, WILLNEED
+ * returns after submitting them, so exec is not delayed by the disk.
+ * Non-regular files (pipes, ttys, devices) are left alone.  Hints are best
+ * effort; failures are ignored.
+ * ----------------------------------------------------------------------------- */
+static void advise_sequential(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) return;
+
+    (void)posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    off_t window = st.st_size < READAHEAD_WINDOW ? st.st_size : READAHEAD_WINDOW;
+    if (window > 0) (void)posix_fadvise(fd, 0, window, POSIX_FADV_WILLNEED);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * release_output_cache()
+ *
+ * Called by the parent after a pipeline finished (MYSHELL_DONTNEED=1): every
+ * regular file written through '>' / '>>' / '&>' by cmd is flushed with
+ * fdatasync() and dropped from the page cache with POSIX_FADV_DONTNEED, so
+ * one-shot output does not evict the hot working set.  Dirty pages cannot
+ * be dropped, hence the flush first.
+ *
+ * Returns the number of files it opened (for the shell's fd counter).
+ * ----------------------------------------------------------------------------- */
+int release_output_cache(const Command *cmd)
+{
+    int opened = 0;
+
+    for (int i = 0; i < cmd->n_redirs; i++) {
+        const Redir *r = &cmd->redirs[i];
+        if (r->kind != REDIR_OUT && r->kind != REDIR_APPEND) continue;
 
-        /* Close the original fd; we only need STDIN_FILENO from now on */
+        /* O_NONBLOCK so a FIFO target cannot stall the shell */
+        int fd = open(r->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) continue;
+        opened++;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            (void)fdatasync(fd);
+            (void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
         close(fd);
     }
+    return opened;
+}
+
 
-    /* ------------------------------------------------------------------
-     * Output redirection:  command > file
-     *
-     * Open (or create) the file for writing, truncating any existing
-     * content – matching standard shell '>' behaviour.
-     * ------------------------------------------------------------------ */
-    if (cmd->out_file != NULL) {
-        /* O_WRONLY  : write-only access
-         * O_CREAT   : create the file if it does not exist
-         * O_TRUNC   : truncate to zero length if it already exists
-         * 0644      : rw-r--r-- permissions for newly created files     */
-        int fd = open(cmd->out_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (fd < 0) {
-            perror(cmd->out_file);
+/* -----------------------------------------------------------------------------
+ * write_all()
+ *
+ * Writes len bytes from buf to fd, retrying on short writes and EINTR.
+ * Returns 0 on success, -1 on failure with errno set.
+ * ----------------------------------------------------------------------------- */
+static int write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
             return -1;
         }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
 
-        /* Replace the child's stdout with this file descriptor.
-         * Subsequent writes (printf, puts, write to fd 1) land in the file. */
-        if (dup2(fd, STDOUT_FILENO) < 0) {
-            perror("dup2: stdout redirection");
-            close(fd);
+
+/* -----------------------------------------------------------------------------
+ * reopen_staged()
+ *
+ * Opens the memfd staged by read_heredocs() anew through /proc/self/fd onto
+ * target_fd: a file description of its own, so commands running at the same
+ * time (pmap copies, server requests of one template) each read from offset
+ * 0 without any copy of the body.  The fd must still hold the sealed body –
+ * an earlier action of the command may have put something else there.
+ *
+ * Returns 0, or -1 (nothing printed) to fall back to copying the body.
+ * ----------------------------------------------------------------------------- */
+static int reopen_staged(int staged_fd, size_t len, int target_fd)
+{
+    Msg path = { .len = 0 };
+    struct stat st;
+    int seals = fcntl(staged_fd, F_GET_SEALS);
+
+    if (seals < 0 || !(seals & F_SEAL_WRITE) || fstat(staged_fd, &st) < 0 || (size_t)st.st_size != len) {
+        return -1;
+    }
+
+    put_str(&path, "/proc/self/fd/");
+    put_int(&path, staged_fd);
+    path.buf[path.len] = '\0';
+    return open_onto(path.buf, O_RDONLY, target_fd);
+}
+
+
+/* -----------------------------------------------------------------------------
+ * install_heredoc()
+ *
+ * Installs the here-document / here-string body of r on r->fd without any
+ * disk I/O or cleanup:
+ *
+ *   - A body over HEREDOC_PIPE_MAX was staged once by read_heredocs() in a
+ *     memfd sealed against writes and size changes; it is reopened here
+ *     and the command reads it like a regular (seekable) file.
+ *   - If the body fits in the pipe buffer (F_GETPIPE_SZ, 64 KiB by default),
+ *     it is written into a fresh pipe whose write end is then closed, so
+ *     the reader sees the body followed by EOF.  The write cannot block.
+ *   - Otherwise (staging failed) it is copied into a sealed memfd here.
+ *
+ * Returns 0 on success, -1 on failure (error already printed).
+ * ----------------------------------------------------------------------------- */
+static int install_heredoc(const Redir *r)
+{
+    /* A body that was never read (no read_heredocs() call) is empty */
+    const char *body = r->body ? r->body : "";
+    size_t len = r->body_len;
+    int target_fd = r->fd;
+    int fds[2];
+
+    if (r->body_fd >= 0 && reopen_staged(r->body_fd, len, target_fd) == 0) return 0;
+
+    if (pipe(fds) < 0) {
+        child_error("pipe: here-document", errno);
+        return -1;
+    }
+
+    int pipe_cap = fcntl(fds[1], F_GETPIPE_SZ);
+    if (pipe_cap > 0 && len <= (size_t)pipe_cap) {
+        if (write_all(fds[1], body, len) < 0) {
+            child_error("write: here-document", errno);
+            close(fds[0]);
+            close(fds[1]);
             return -1;
         }
+        close(fds[1]);
 
-        close(fd);
+        if (fds[0] != target_fd) {
+            if (dup2(fds[0], target_fd) < 0) {
+                child_error("dup2: here-document", errno);
+                close(fds[0]);
+                return -1;
+            }
+            close(fds[0]);
+        }
+        return 0;
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    /* Too large for the pipe buffer: stage it in a sealed memfd */
+    int mfd = memfd_create("myshell-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mfd < 0) {
+        child_error("memfd_create: here-document", errno);
+        return -1;
+    }
+
+    if (write_all(mfd, body, len) < 0) {
+        child_error("write: here-document", errno);
+        close(mfd);
+        return -1;
+    }
+
+    /* Seals are best effort: the body is complete either way */
+    (void)fcntl(mfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+
+    if (lseek(mfd, 0, SEEK_SET) < 0) {
+        child_error("lseek: here-document", errno);
+        close(mfd);
+        return -1;
+    }
+
+    /* pipe() above freed fds, so the memfd may already be target_fd */
+    if (mfd == target_fd) {
+        fcntl(mfd, F_SETFD, 0);
+        return 0;
     }
+    if (dup2(mfd, target_fd) < 0) {
+        child_error("dup2: here-document", errno);
+        close(mfd);
+        return -1;
+    }
+    close(mfd);
+    return 0;
+}
+
+
+/* "<fd>: <description of err>" for a bad n>&m source */
+static void dup_error(int fd, int err)
+{
+    Msg m = { .len = 0 };
 
-    /* ------------------------------------------------------------------
-     * Error redirection:  command 2> file
-     *
-     * Same open/truncate semantics as output redirection, but the target
-     * descriptor is STDERR_FILENO (fd 2) instead of STDOUT_FILENO (fd 1).
-     * ------------------------------------------------------------------ */
-    if (cmd->err_file != NULL) {
-        int fd = open(cmd->err_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-        if (fd < 0) {
-            perror(cmd->err_file);
+    put_int(&m, fd);
+    put_errno(&m, err);
+    msg_write(&m);
+}
+
+
+/* Executes one redirection action; returns 0 or -1 (error printed) */
+static int apply_redir(const Redir *r, int readahead)
+{
+    switch (r->kind) {
+    case REDIR_IN:
+        /* O_RDONLY: open for reading only; file must already exist */
+        if (open_onto(r->path, O_RDONLY, r->fd) < 0) {
+            /* The spec requires this exact phrasing for a missing input file */
+            static const char msg[] = "File not found.\n";
+            if (write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0) { /* nothing left to report to */ }
             return -1;
         }
+        if (readahead) advise_sequential(r->fd);
+        break;
 
-        /* Replace the child's stderr; future fprintf(stderr, ...) calls
-         * write to this file rather than the terminal. */
-        if (dup2(fd, STDERR_FILENO) < 0) {
-            perror("dup2: stderr redirection");
-            close(fd);
+    case REDIR_OUT:
+        /* O_TRUNC: truncate to zero length if it already exists */
+        if (open_onto(r->path, O_WRONLY | O_CREAT | O_TRUNC, r->fd) < 0) {
+            child_error(r->path, errno);
             return -1;
         }
+        break;
 
-        close(fd);
+    case REDIR_APPEND:
+        /* O_APPEND: every write lands at the current end of file */
+        if (open_onto(r->path, O_WRONLY | O_CREAT | O_APPEND, r->fd) < 0) {
+            child_error(r->path, errno);
+            return -1;
+        }
+        break;
+
+    case REDIR_DUP:
+        /* n>&n is a no-op, but must still name an open descriptor */
+        if (r->src_fd == r->fd) {
+            if (fcntl(r->fd, F_GETFD) < 0) {
+                dup_error(r->src_fd, errno);
+                return -1;
+            }
+            break;
+        }
+        if (dup2(r->src_fd, r->fd) < 0) {
+            dup_error(r->src_fd, errno);
+            return -1;
+        }
+        break;
+
+    case REDIR_CLOSE:
+        close(r->fd);
+        break;
+
+    case REDIR_HEREDOC:
+        if (install_heredoc(r) < 0) return -1;
+        break;
+    }
+    return 0;
+}
+
+
+/* -----------------------------------------------------------------------------
+ * apply_redirections()
+ *
+ * Executes the redirection actions of one command in order:
+ *
+ *   REDIR_IN     (n<  file) : open O_RDONLY                     → fd
+ *   REDIR_OUT    (n>  file) : open O_WRONLY | O_CREAT | O_TRUNC  → fd
+ *   REDIR_APPEND (n>> file) : open O_WRONLY | O_CREAT | O_APPEND → fd
+ *   REDIR_DUP    (n>&m)     : dup2(m, n)
+ *   REDIR_CLOSE  (n>&-)     : close(n)
+ *   REDIR_HEREDOC (n<<, n<<<): body → n   (pipe or reopened sealed memfd)
+ *
+ * Called in the child process; a failure causes the child to _exit(1) so
+ * the parent detects a non-zero exit status.
+ *
+ * Parameters:
+ *   cmd        – pointer to the Command whose redirection list is executed
+ *   readahead  – non-zero: advise_sequential() on every '<' file
+ *                (the shell passes shell_opts.readahead)
+ *
+ * Returns:
+ *    0  on success (all requested redirections applied)
+ *   -1  on any failure (error already printed to stderr)
+ * ----------------------------------------------------------------------------- */
+int apply_redirections(const Command *cmd, int readahead)
+{
+    for (int i = 0; i < cmd->n_redirs; i++) {
+        const Redir *r = &cmd->redirs[i];
+        int rc = apply_redir(r, readahead);
+
+        PROBE_REDIR((int)r->kind, r->fd, r->path, rc);
+        if (rc < 0) return -1;
     }
 
     /* All requested redirections succeeded */
@@ -0,0 +1,297 @@
+/* =============================================================================
+ * src/rerun.c  –  'rerun': re-execute a pipeline when its inputs change
+ *
+ *   rerun [-c] [-d MS] PIPELINE
+ *
+ *   rerun grep -c ERROR app.log
+ *   rerun -c -d 500 sort < data.csv > sorted.csv
+ *
+ * Instead of  while sleep 1; do ...; done  respawning the pipeline every
+ * second, 'rerun' runs it once and then sleeps in poll() on an inotify
+ * descriptor until one of its inputs is modified:
+ *
+ *   - Watched files are the '<' redirection paths and the argv words that
+ *     name existing regular files, minus the pipeline's own '>' / '>>'
+ *     outputs.  Their directories are watched (IN_CLOSE_WRITE, IN_MOVED_TO,
+ *     IN_CREATE, IN_DELETE, IN_ATTRIB) and events filtered by name, so an
+ *     editor that saves by writing a new file and rename()ing it over the
+ *     old one is seen too.
+ *   - Debounce: a burst of events starts one run, RERUN_DEBOUNCE_MS (or
+ *     -d MS) after the last of them.
+ *   - Each run is a forked runner calling execute_pipeline(), in its own
+ *     process group; its pidfd is in the same poll().  A change during a
+ *     run queues another run after it, or with -c cancels it (SIGTERM to
+ *     the group) and starts over.
+ *   - Ctrl-C ends the loop (a self-pipe written by the SIGINT handler)
+ *     and returns to the prompt with the status of the last completed run.
+ *
+ * After every run a line goes to stderr:  [rerun] status 0, 12.3 ms
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // pipe2(), O_CLOEXEC
+
+#include <stdio.h>      // fprintf(), perror()
+#include <stdlib.h>     // malloc(), free(), atoi()
+#include <string.h>     // strcmp(), strrchr(), strdup()
+#include <errno.h>      // errno
+#include <fcntl.h>      // O_CLOEXEC, O_NONBLOCK
+#include <unistd.h>     // pipe2(), read(), write(), close()
+#include <signal.h>     // sigaction(), signal(), kill()
+#include <poll.h>       // poll()
+#include <limits.h>     // PATH_MAX
+#include <sys/inotify.h> // inotify_init1(), inotify_add_watch()
+#include <sys/stat.h>   // stat(), S_ISREG
+#include <sys/wait.h>   // waitpid(), WIFEXITED
+#include "rerun.h"
+#include "exec.h"       // execute_pipeline(), fork_runner()
+#include "stats.h"      // stats_now()
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB)
+#define POLL_TICK_MS 50     /* runner check interval without pidfd_open() */
+
+/* One watched file: the directory watch it belongs to and its name there */
+typedef struct {
+    int   wd;
+    char *name;
+} Watched;
+
+typedef struct {
+    int      ifd;           /* inotify */
+    Watched *files;
+    int      n_files;
+} WatchSet;
+
+static int sigint_pipe[2] = { -1, -1 };
+
+
+static void on_sigint(int sig)
+{
+    (void)sig;
+    int saved = errno;
+    if (write(sigint_pipe[1], "x", 1) < 0) { /* pipe full: already pending */ }
+    errno = saved;
+}
+
+
+/* Is path one of p's output files? */
+static int is_output(const Pipeline *p, const char *path)
+{
+    for (int i = 0; i < p->n_cmds; i++) {
+        for (int j = 0; j < p->cmds[i].n_redirs; j++) {
+            const Redir *r = &p->cmds[i].redirs[j];
+            if ((r->kind == REDIR_OUT || r->kind == REDIR_APPEND) && strcmp(r->path, path) == 0) return 1;
+        }
+    }
+    return 0;
+}
+
+static int watch_file(WatchSet *ws, const Pipeline *p, const char *path)
+{
+    char dir[PATH_MAX];
+    const char *slash = strrchr(path, '/');
+
+    if (is_output(p, path)) return 0;
+
+    if (slash == NULL)      snprintf(dir, sizeof(dir), ".");
+    else if (slash == path) snprintf(dir, sizeof(dir), "/");
+    else                    snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+
+    int wd = inotify_add_watch(ws->ifd, dir, WATCH_EVENTS);
+    if (wd < 0) {
+        fprintf(stderr, "rerun: %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    Watched *tmp = realloc(ws->files, (size_t)(ws->n_files + 1) * sizeof(Watched));
+    if (tmp == NULL) return -1;
+    ws->files = tmp;
+    ws->files[ws->n_files].wd = wd;
+    ws->files[ws->n_files].name = strdup(slash ? slash + 1 : path);
+    if (ws->files[ws->n_files].name == NULL) return -1;
+    ws->n_files++;
+    return 0;
+}
+
+/* Watches the '<' files and argv words naming regular files */
+static int watch_inputs(WatchSet *ws, const Pipeline *p)
+{
+    struct stat st;
+
+    for (int i = 0; i < p->n_cmds; i++) {
+        const Command *c = &p->cmds[i];
+
+        for (int k = 1; c->argv[k] != NULL; k++) {
+            if (stat(c->argv[k], &st) == 0 && S_ISREG(st.st_mode) &&
+                watch_file(ws, p, c->argv[k]) < 0) return -1;
+        }
+        for (int j = 0; j < c->n_redirs; j++) {
+            if (c->redirs[j].kind == REDIR_IN && watch_file(ws, p, c->redirs[j].path) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+/* Drains the inotify queue; returns 1 if a watched file changed */
+static int read_changes(const WatchSet *ws)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t n;
+
+    while ((n = read(ws->ifd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            for (int i = 0; ev->len > 0 && i < ws->n_files; i++) {
+                if (ws->files[i].wd == ev->wd && strcmp(ws->files[i].name, ev->name) == 0) changed = 1;
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return changed;
+}
+
+
+/* Body of the runner (fork_runner(), own process group): one run of the pipeline */
+static int run_once(void *ctx)
+{
+    signal(SIGINT, SIG_DFL);
+    return execute_pipeline(ctx);
+}
+
+/* Reaps the runner; returns 1 with *status once it has exited, else 0 */
+static int finish_run(pid_t pid, int *pidfd, int options, int *status)
+{
+    int ws;
+    pid_t r;
+
+    while ((r = waitpid(pid, &ws, options)) < 0 && errno == EINTR) ;
+    if (r == 0) return 0;
+    if (*pidfd >= 0) close(*pidfd);
+    *pidfd = -1;
+    if (r < 0) *status = 1;
+    else *status = WIFEXITED(ws) ? WEXITSTATUS(ws) : 128 + WTERMSIG(ws);
+    return 1;
+}
+
+
+int rerun_prefixed(const Pipeline *p)
+{
+    return p != NULL && p->n_cmds > 0 && strcmp(p->cmds[0].argv[0], "rerun") == 0;
+}
+
+
+int rerun_execute(const Pipeline *p)
+{
+    char **argv = p->cmds[0].argv;
+    int cancel = 0, debounce_ms = RERUN_DEBOUNCE_MS;
+    int k = 1;
+
+    for (; argv[k] != NULL && argv[k][0] == '-'; k++) {
+        if (strcmp(argv[k], "-c") == 0) cancel = 1;
+        else if (strcmp(argv[k], "-d") == 0 && argv[k + 1] != NULL) debounce_ms = atoi(argv[++k]);
+        else break;
+    }
+    if (argv[k] == NULL || argv[k][0] == '-' || debounce_ms < 0) {
+        fprintf(stderr, "usage: rerun [-c] [-d MS] command [args...] [| command ...]\n");
+        return 2;
+    }
+
+    /* The same pipeline without the prefix */
+    Pipeline run = { malloc((size_t)p->n_cmds * sizeof(Command)), p->n_cmds };
+    if (run.cmds == NULL) {
+        perror("malloc (rerun)");
+        return -1;
+    }
+    memcpy(run.cmds, p->cmds, (size_t)p->n_cmds * sizeof(Command));
+    run.cmds[0].argv = argv + k;
+
+    WatchSet ws = { inotify_init1(IN_NONBLOCK | IN_CLOEXEC), NULL, 0 };
+    struct sigaction sa, old_sa;
+    int status = 0;
+
+    if (ws.ifd < 0 || pipe2(sigint_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        perror("rerun");
+        goto out;
+    }
+    if (watch_inputs(&ws, &run) < 0) goto out;
+    if (ws.n_files == 0) {
+        fprintf(stderr, "rerun: no input files to watch\n");
+        status = 2;
+        goto out;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &old_sa);
+
+    pid_t pid = -1;
+    int pidfd = -1;
+    int pending = 1;                /* the first run starts at once */
+    long long deadline = stats_now();
+    long long t_run = 0;
+
+    for (;;) {
+        long long now = stats_now();
+
+        if (pending && pid < 0 && now >= deadline) {
+            pending = 0;
+            t_run = now;
+            pid = fork_runner(run_once, &run, 1, &pidfd, "rerun: fork");
+        }
+
+        struct pollfd pfd[3] = {
+            { sigint_pipe[0], POLLIN, 0 },
+            { ws.ifd, POLLIN, 0 },
+            { pidfd, POLLIN, 0 },
+        };
+        int timeout = -1;
+        if (pending && pid < 0) timeout = (int)((deadline - now + 999999) / 1000000);
+        if (pid > 0 && pidfd < 0) timeout = POLL_TICK_MS;
+
+        if (poll(pfd, pidfd >= 0 ? 3 : 2, timeout) < 0 && errno != EINTR) {
+            perror("rerun: poll");
+            break;
+        }
+
+        if (pfd[0].revents & POLLIN) {
+            if (pid > 0) {
+                kill(-pid, SIGTERM);
+                (void)finish_run(pid, &pidfd, 0, &status);
+            }
+            break;
+        }
+
+        if ((pfd[1].revents & POLLIN) && read_changes(&ws)) {
+            pending = 1;
+            deadline = stats_now() + (long long)debounce_ms * 1000000LL;
+            if (pid > 0 && cancel) kill(-pid, SIGTERM);
+        }
+
+        if (pid > 0) {
+            int st;
+            if (finish_run(pid, &pidfd, WNOHANG, &st)) {
+                pid = -1;
+                if (pending && cancel && st == 128 + SIGTERM) {
+                    fprintf(stderr, "[rerun] cancelled\n");
+                } else {
+                    status = st;
+                    fprintf(stderr, "[rerun] status %d, %.1f ms\n", st, (stats_now() - t_run) / 1e6);
+                }
+            }
+        }
+    }
+
+    sigaction(SIGINT, &old_sa, NULL);
+
+out:
+    if (ws.ifd >= 0) close(ws.ifd);
+    for (int i = 0; i < ws.n_files; i++) free(ws.files[i].name);
+    free(ws.files);
+    for (int i = 0; i < 2; i++) {
+        if (sigint_pipe[i] >= 0) close(sigint_pipe[i]);
+        sigint_pipe[i] = -1;
+    }
+    free(run.cmds);
+    return status;
+}
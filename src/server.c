@@ -0,0 +1,565 @@
+/* =============================================================================
+ * src/server.c  –  Persistent shell server (--server SOCKET, --client SOCKET)
+ *
+ * A job runner that starts myshell for every command pays for exec, the
+ * dynamic loader and a cold PATH search each time.  With
+ *
+ *   myshell --server /run/myshell.sock &
+ *   myshell --client /run/myshell.sock 'sort -u < in.txt | head -5'
+ *
+ * one long-lived shell accepts command lines on a UNIX SOCK_SEQPACKET
+ * socket instead.  The client sends its cwd and the command line as one
+ * packet with its stdin, stdout and stderr attached (SCM_RIGHTS), and gets
+ * back a ServerReply: exit status plus the server-side timing.
+ *
+ * The server is a single epoll loop over the listening socket, a signalfd
+ * (SIGINT / SIGTERM end it), every client socket and the pidfd of every
+ * running request:
+ *
+ *   request   parse (or reuse the cached parse of the same text), warm the
+ *             PATH cache for its commands, then fork a runner
+ *   runner    own process group; takes the client's fds as 0/1/2, chdir()s
+ *             to its cwd and runs execute_list() like the prompt loop does
+ *   pidfd     runner exited: reply to the client and close its socket
+ *   hangup    the client went away (e.g. Ctrl-C): SIGTERM the runner's group
+ *
+ * Runners are forks of the server, so parsed templates, the PATH cache and
+ * everything else already in memory come for free; the server never blocks
+ * on a request, so slow commands do not hold up others.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     // accept4(), MSG_CMSG_CLOEXEC, pipe2()
+
+#include <stdio.h>      // fprintf(), perror(), dprintf()
+#include <stdlib.h>     // calloc(), free()
+#include <string.h>     // memcpy(), strlen(), strcmp(), strchr()
+#include <unistd.h>     // close(), dup2(), chdir(), getcwd(), unlink()
+#include <fcntl.h>      // open(), O_RDWR
+#include <errno.h>      // errno
+#include <limits.h>     // PATH_MAX
+#include <signal.h>     // sigprocmask(), kill(), signal()
+#include <sys/epoll.h>  // epoll_create1(), epoll_ctl(), epoll_wait()
+#include <sys/signalfd.h> // signalfd()
+#include <sys/socket.h> // socket(), bind(), listen(), sendmsg(), recvmsg()
+#include <sys/stat.h>   // lstat(), S_ISSOCK
+#include <sys/un.h>     // struct sockaddr_un
+#include <sys/wait.h>   // waitid(), waitpid()
+#include <sys/syscall.h> // SYS_pidfd_open
+#include "server.h"
+#include "parser.h"
+#include "exec.h"       // execute_list(), fork_runner()
+#include "builtin.h"    // find_builtin()
+#include "pathcache.h"  // pathcache_lookup()
+#include "hash.h"       // hash_name()
+#include "options.h"    // shell_opts.path_cache
+#include "stats.h"      // stats_now(), shell_stats
+
+#ifndef P_PIDFD
+#define P_PIDFD 3       // waitid() on a pidfd (Linux 5.4)
+#endif
+
+#define TEMPLATE_SLOTS 64       /* parsed command lines kept, direct-mapped */
+#define MAX_EVENTS     64
+
+/* ---------------------------------------------------------------------------
+ * Parsed command lines, keyed by their full text (here-documents included)
+ * ------------------------------------------------------------------------- */
+
+typedef struct {
+    char       *text;
+    CommandList cl;
+} Template;
+
+static Template templates[TEMPLATE_SLOTS];
+
+
+/* Parses text (first line + here-document lines) into cl */
+static int parse_request(char *text, CommandList *cl, char *err, size_t err_sz)
+{
+    char *nl = strchr(text, '\n');
+    TextLines lines = { NULL, NULL, 0 };
+    int rc;
+
+    if (nl != NULL) *nl = '\0';
+    rc = parse_list(text, cl, err, err_sz);
+    if (nl != NULL) *nl = '\n';
+    if (rc != 0) {
+        free_list(cl);
+        return -1;
+    }
+
+    lines.next = (nl && nl[1] != '\0') ? nl + 1 : NULL;
+    for (int i = 0; rc == 0 && i < cl->n_nodes; i++) {
+        rc = read_heredocs(&cl->nodes[i].pl, text_next_line, &lines, err, err_sz);
+    }
+    free(lines.buf);
+    if (rc != 0) {
+        free_list(cl);
+        return -1;
+    }
+    return 0;
+}
+
+/* Returns the cached parse of text, parsing it on a miss (*parse_ns > 0) */
+static const CommandList *template_get(char *text, long long *parse_ns,
+                                       char *err, size_t err_sz)
+{
+    Template *t = &templates[hash_name(text) & (TEMPLATE_SLOTS - 1)];
+    CommandList cl;
+
+    *parse_ns = 0;
+    if (t->text != NULL && strcmp(t->text, text) == 0) return &t->cl;
+
+    long long t0 = stats_now();
+    int rc = parse_request(text, &cl, err, err_sz);
+    *parse_ns = stats_now() - t0;
+    shell_stats.parses++;
+    hist_record(&shell_stats.parse_ns, *parse_ns);
+    if (rc != 0) return NULL;
+
+    char *copy = strdup(text);
+    if (copy == NULL) {
+        free_list(&cl);
+        snprintf(err, err_sz, "Out of memory.");
+        return NULL;
+    }
+    if (t->text != NULL) {
+        free(t->text);
+        free_list(&t->cl);
+    }
+    t->text = copy;
+    t->cl = cl;
+    return &t->cl;
+}
+
+/* Resolve every command now, in the server, so all later runners inherit it */
+static void warm_path_cache(const CommandList *cl)
+{
+    if (!shell_opts.path_cache) return;
+
+    for (int i = 0; i < cl->n_nodes; i++) {
+        const Pipeline *p = &cl->nodes[i].pl;
+        for (int j = 0; j < p->n_cmds; j++) {
+            if (find_builtin(p->cmds[j].argv[0]) == NULL) (void)pathcache_lookup(p->cmds[j].argv[0]);
+        }
+    }
+}
+
+
+/* ---------------------------------------------------------------------------
+ * Connections
+ * ------------------------------------------------------------------------- */
+
+enum { W_LISTEN, W_SIGNAL, W_CONN, W_RUNNER };
+
+struct Conn;
+
+typedef struct {
+    int          kind;
+    struct Conn *conn;
+} Watch;
+
+typedef struct Conn {
+    int       fd;           /* client socket */
+    pid_t     pid;          /* runner (0 until the request arrived) */
+    int       pidfd;
+    int       gone;         /* client hung up while its request ran */
+    unsigned  flags;        /* SERVER_REPLY_* */
+    long long t_start;
+    long long parse_ns;
+    Watch     w_conn, w_runner;
+    int       closed;       /* close_conn() done; freed after the event batch */
+    struct Conn *next_closed;
+} Conn;
+
+/* Server descriptors (a runner must not keep them) and closed connections */
+typedef struct {
+    int ep;
+    int listen_fd;
+    int sig_fd;
+    Conn *closed;           /* still referenced by the current epoll_wait() batch */
+} Server;
+
+
+static void close_conn(Server *s, Conn *c)
+{
+    epoll_ctl(s->ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    if (c->pidfd >= 0) {
+        epoll_ctl(s->ep, EPOLL_CTL_DEL, c->pidfd, NULL);
+        close(c->pidfd);
+    }
+    /* Another event of this batch may still point at c: free it afterwards */
+    c->closed = 1;
+    c->next_closed = s->closed;
+    s->closed = c;
+}
+
+static void send_reply(Conn *c, int status)
+{
+    ServerReply r;
+
+    r.status   = status;
+    r.flags    = c->flags;
+    r.wall_ns  = stats_now() - c->t_start;
+    r.parse_ns = c->parse_ns;
+    if (send(c->fd, &r, sizeof(r), MSG_NOSIGNAL) < 0 && errno != EPIPE) perror("server: send");
+}
+
+/* One request as its runner gets it */
+typedef struct {
+    Server            *s;
+    const CommandList *cl;
+    const char        *cwd;
+    const int         *fds;     /* the client's stdin, stdout, stderr */
+} Request;
+
+/* Body of a request's runner (fork_runner(), own process group) */
+static int run_request(void *ctx)
+{
+    const Request *rq = ctx;
+    sigset_t none;
+
+    for (int i = 0; i < 3; i++) dup2(rq->fds[i], i);
+    for (int i = 0; i < 3; i++) close(rq->fds[i]);
+    close(rq->s->ep);
+    close(rq->s->listen_fd);
+    close(rq->s->sig_fd);
+
+    signal(SIGPIPE, SIG_DFL);
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+
+    if (chdir(rq->cwd) < 0) {
+        fprintf(stderr, "myshell: %s: %s\n", rq->cwd, strerror(errno));
+        return 1;
+    }
+    return execute_list(rq->cl);
+}
+
+/* Reads one request from c and starts its runner.  Returns -1 if c is done. */
+static int start_request(Server *s, Conn *c)
+{
+    static char buf[SERVER_MAX_REQUEST + 1];
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = { buf, SERVER_MAX_REQUEST };
+    struct msghdr msg;
+    int fds[3];
+    int n_fds = 0;
+    char err[256];
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    ssize_t n = recvmsg(c->fd, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return 0;
+    c->t_start = stats_now();
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+        int k = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (int i = 0; i < k; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cm) + (size_t)i * sizeof(int), sizeof(int));
+            if (n_fds < 3) fds[n_fds++] = fd;
+            else close(fd);
+        }
+    }
+
+    /* Malformed: no data, truncated, no cwd, or not exactly three fds */
+    size_t cwd_len = n > 0 ? strnlen(buf, (size_t)n) : 0;
+    if (n <= 0 || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) || n_fds != 3 || cwd_len >= (size_t)n) {
+        for (int i = 0; i < n_fds; i++) close(fds[i]);
+        return -1;
+    }
+    buf[n] = '\0';
+    char *text = buf + cwd_len + 1;
+
+    const CommandList *cl = template_get(text, &c->parse_ns, err, sizeof(err));
+    c->flags = c->parse_ns == 0 ? SERVER_REPLY_CACHED : 0;
+    if (cl == NULL) {
+        if (err[0] != '\0') dprintf(fds[2], "%s\n", err);
+        for (int i = 0; i < 3; i++) close(fds[i]);
+        send_reply(c, 2);
+        return -1;
+    }
+    warm_path_cache(cl);
+
+    Request rq = { s, cl, buf, fds };
+    c->pid = fork_runner(run_request, &rq, 1, &c->pidfd, "server: fork");
+    for (int i = 0; i < 3; i++) close(fds[i]);
+    if (c->pid < 0) {
+        send_reply(c, 126);
+        return -1;
+    }
+    shell_stats.spawns++;
+
+    if (c->pidfd < 0) {
+        perror("server: pidfd_open");
+        kill(-c->pid, SIGKILL);
+        while (waitpid(c->pid, NULL, 0) < 0 && errno == EINTR) ;
+        send_reply(c, 126);
+        return -1;
+    }
+
+    /* While it runs, only a hangup of the client matters */
+    struct epoll_event ev = { .events = EPOLLRDHUP, .data.ptr = &c->w_conn };
+    epoll_ctl(s->ep, EPOLL_CTL_MOD, c->fd, &ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &c->w_runner;
+    epoll_ctl(s->ep, EPOLL_CTL_ADD, c->pidfd, &ev);
+    return 0;
+}
+
+static void finish_request(Server *s, Conn *c)
+{
+    siginfo_t si;
+    int rc;
+
+    do {
+        si.si_pid = 0;
+        rc = waitid((idtype_t)P_PIDFD, (id_t)c->pidfd, &si, WEXITED | WNOHANG);
+    } while (rc < 0 && errno == EINTR);
+    if (rc < 0 || si.si_pid == 0) return;
+
+    if (!c->gone) send_reply(c, si.si_code == CLD_EXITED ? si.si_status : 128 + si.si_status);
+    close_conn(s, c);
+}
+
+static void accept_clients(Server *s)
+{
+    for (;;) {
+        int fd = accept4(s->listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR) perror("server: accept");
+            return;
+        }
+
+        Conn *c = calloc(1, sizeof(Conn));
+        if (c == NULL) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->pidfd = -1;
+        c->w_conn = (Watch){ W_CONN, c };
+        c->w_runner = (Watch){ W_RUNNER, c };
+
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = &c->w_conn };
+        if (epoll_ctl(s->ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "myshell: socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("server: socket");
+        return -1;
+    }
+
+    /* A socket left behind by a server that is gone is replaced */
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) < 0 &&
+            errno == ECONNREFUSED) {
+            unlink(path);
+        }
+        if (probe >= 0) close(probe);
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        fprintf(stderr, "myshell: %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+int server_main(const char *sock_path)
+{
+    Server s = { -1, -1, -1, NULL };
+    Watch w_listen = { W_LISTEN, NULL };
+    Watch w_signal = { W_SIGNAL, NULL };
+    struct epoll_event ev;
+    sigset_t stop;
+    int fd;
+
+#ifndef SYS_pidfd_open
+    fprintf(stderr, "myshell: --server needs pidfd_open()\n");
+    return 1;
+#endif
+
+    /* Received fds must not land on 0..2, which the runner dup2()s over */
+    while ((fd = open("/dev/null", O_RDWR)) >= 0 && fd < 3) ;
+    if (fd >= 0) close(fd);
+
+    signal(SIGPIPE, SIG_IGN);
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    sigprocmask(SIG_BLOCK, &stop, NULL);
+
+    s.listen_fd = listen_on(sock_path);
+    if (s.listen_fd < 0) return 1;
+    s.sig_fd = signalfd(-1, &stop, SFD_CLOEXEC | SFD_NONBLOCK);
+    s.ep = epoll_create1(EPOLL_CLOEXEC);
+    if (s.sig_fd < 0 || s.ep < 0) {
+        perror("server");
+        unlink(sock_path);
+        return 1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = &w_listen;
+    epoll_ctl(s.ep, EPOLL_CTL_ADD, s.listen_fd, &ev);
+    ev.data.ptr = &w_signal;
+    epoll_ctl(s.ep, EPOLL_CTL_ADD, s.sig_fd, &ev);
+
+    for (int running = 1; running; ) {
+        struct epoll_event evs[MAX_EVENTS];
+        int n = epoll_wait(s.ep, evs, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("server: epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            Watch *w = evs[i].data.ptr;
+            Conn *c = w->conn;
+
+            if (c != NULL && c->closed) continue;
+            switch (w->kind) {
+            case W_LISTEN:
+                accept_clients(&s);
+                break;
+            case W_SIGNAL:
+                running = 0;
+                break;
+            case W_CONN:
+                if (c->pid == 0) {
+                    if (start_request(&s, c) < 0) close_conn(&s, c);
+                } else if (!c->gone) {
+                    /* Client gone mid-run: stop its commands, reap as usual */
+                    c->gone = 1;
+                    kill(-c->pid, SIGTERM);
+                    epoll_ctl(s.ep, EPOLL_CTL_DEL, c->fd, NULL);
+                }
+                break;
+            case W_RUNNER:
+                finish_request(&s, c);
+                break;
+            }
+        }
+
+        while (s.closed != NULL) {
+            Conn *c = s.closed;
+            s.closed = c->next_closed;
+            free(c);
+        }
+    }
+
+    unlink(sock_path);
+    return 0;
+}
+
+
+/* ---------------------------------------------------------------------------
+ * Client
+ * ------------------------------------------------------------------------- */
+
+int client_main(const char *sock_path, int timing, char **words)
+{
+    static char buf[SERVER_MAX_REQUEST];
+    int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    char cbuf[CMSG_SPACE(sizeof(fds))];
+    struct sockaddr_un addr;
+    struct msghdr msg;
+    struct iovec iov;
+    ServerReply r;
+    size_t len;
+
+    /* cwd '\0' words joined by spaces */
+    if (getcwd(buf, PATH_MAX) == NULL) {
+        perror("myshell: getcwd");
+        return 127;
+    }
+    len = strlen(buf) + 1;
+    for (int i = 0; words[i] != NULL; i++) {
+        size_t w = strlen(words[i]);
+        if (len + w + 1 >= sizeof(buf)) {
+            fprintf(stderr, "myshell: command too long\n");
+            return 127;
+        }
+        if (i > 0) buf[len++] = ' ';
+        memcpy(buf + len, words[i], w);
+        len += w;
+    }
+
+    if (strlen(sock_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "myshell: socket path too long: %s\n", sock_path);
+        return 127;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sock_path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "myshell: %s: %s\n", sock_path, strerror(errno));
+        return 127;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = buf;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+        perror("myshell: sendmsg");
+        close(fd);
+        return 127;
+    }
+
+    ssize_t n;
+    while ((n = recv(fd, &r, sizeof(r), 0)) < 0 && errno == EINTR) ;
+    close(fd);
+    if (n != (ssize_t)sizeof(r)) {
+        fprintf(stderr, "myshell: no reply from server\n");
+        return 127;
+    }
+
+    if (timing) {
+        fprintf(stderr, "[server] status %d, %.3f ms, parse %s%.1f us\n", (int)r.status,
+                r.wall_ns / 1e6, (r.flags & SERVER_REPLY_CACHED) ? "cached " : "",
+                r.parse_ns / 1e3);
+    }
+    return r.status;
+}
@@ -0,0 +1,266 @@
+/* =============================================================================
+ * src/stats.c  –  Shell self-instrumentation and the 'stats' builtin
+ *
+ *   stats            human-readable counters and latency percentiles
+ *   stats --json     the same as one JSON object
+ *   stats reset      clear every counter and histogram
+ *
+ * Design notes:
+ *   - Counters are plain increments at the call sites and histograms are
+ *     recorded by the inline hist_record() in stats.h, so an event costs a
+ *     few nanoseconds plus one vDSO clock read where a duration is timed.
+ *   - Spawn latency ends in the child (just before execvp()), so each child
+ *     gets a slot of a small MAP_SHARED anonymous mapping: the parent stamps
+ *     the fork time, the child its start / exec (or failed-exec) time, and
+ *     stats_reaped() turns the slot into histogram samples after waitpid().
+ *   - A slot is owned (its owner field, claimed with a compare-and-swap)
+ *     from stats_slot() to stats_reaped(): forked runners (rerun, dag,
+ *     qsub, process substitutions) share the mapping and claim slots for
+ *     their own children.  When all STATS_SLOTS are in flight the child
+ *     gets no slot and 'slot overflows' is counted instead of two children
+ *     stamping the same slot; the prompt loop then frees the slots of
+ *     owners that died without reaping (a cancelled runner), so the
+ *     kill(owner, 0) scan never runs on the fork path.
+ *   - The owner pid is cached: getpid() once per process, refreshed by
+ *     stats_forked() in every runner fork_runner() starts.
+ *   - "Bytes allocated" is the heap in use as reported by mallinfo2() when
+ *     stats runs; counting every malloc() would cost more than the events
+ *     being measured.
+ * ============================================================================= */
+
+#define _GNU_SOURCE     /* mallinfo2() */
+
+#include <stdio.h>      /* printf(), fprintf() */
+#include <string.h>     /* memset(), strcmp() */
+#include <errno.h>      /* errno, ESRCH */
+#include <signal.h>     /* kill() */
+#include <unistd.h>     /* getpid() */
+#include <malloc.h>     /* mallinfo2() */
+#include <sys/mman.h>   /* mmap() */
+#include "stats.h"
+
+#define STATS_SLOTS 1024
+
+ShellStats shell_stats;
+
+typedef struct {
+    long long mark[STATS_MARKS];
+    pid_t     owner;        /* process that will reap the child, 0 if free */
+} Slot;
+
+static Slot *slots;                        /* shared with the children */
+static int  slots_failed;
+static int  next_slot;
+static pid_t self_pid;                     /* owner id of this process's slots */
+static int  reclaim_due;                   /* a child found every slot in flight */
+static long long line_read_ns;             /* 0 once the line's first exec was seen */
+
+
+/* === Child slots =========================================================== */
+
+int stats_slot(void)
+{
+    if (slots == NULL) {
+        if (slots_failed) return -1;
+        void *m = mmap(NULL, STATS_SLOTS * sizeof(*slots), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (m == MAP_FAILED) {
+            slots_failed = 1;
+            return -1;
+        }
+        slots = m;
+    }
+
+    if (self_pid == 0) self_pid = getpid();
+    int s = -1;
+
+    for (int n = 0; n < STATS_SLOTS && s < 0; n++) {
+        int i = (next_slot + n) % STATS_SLOTS;
+        if (slots[i].owner == 0 && __sync_bool_compare_and_swap(&slots[i].owner, 0, self_pid)) s = i;
+    }
+    if (s < 0) {
+        shell_stats.slot_overflows++;
+        reclaim_due = 1;
+        return -1;
+    }
+
+    next_slot = (s + 1) % STATS_SLOTS;
+    slots[s].mark[STATS_MARK_START] = 0;
+    slots[s].mark[STATS_MARK_EXEC]  = 0;
+    slots[s].mark[STATS_MARK_FAIL]  = 0;
+    slots[s].mark[STATS_MARK_FORK]  = stats_now();
+    return s;
+}
+
+
+void stats_mark(int slot, int what)
+{
+    if (slot >= 0) slots[slot].mark[what] = stats_now();
+}
+
+
+long long stats_slot_get(int slot, int what)
+{
+    return slot >= 0 ? slots[slot].mark[what] : 0;
+}
+
+
+void stats_reaped(int slot)
+{
+    if (slot < 0) return;
+
+    long long fork_ns = slots[slot].mark[STATS_MARK_FORK];
+    long long exec_ns = slots[slot].mark[STATS_MARK_EXEC];
+    int failed = slots[slot].mark[STATS_MARK_FAIL] != 0;
+
+    __sync_lock_release(&slots[slot].owner);   /* stores 0: free for the next child */
+
+    if (failed) {
+        shell_stats.spawn_failures++;
+        return;
+    }
+    if (exec_ns == 0) return;   /* exited before exec (e.g. a redirection failed) */
+
+    hist_record(&shell_stats.spawn_ns, exec_ns - fork_ns);
+    if (line_read_ns != 0) {
+        hist_record(&shell_stats.prompt_exec_ns, exec_ns - line_read_ns);
+        line_read_ns = 0;
+    }
+}
+
+
+void stats_forked(void)
+{
+    self_pid = getpid();
+}
+
+
+/* Frees the slots of owners that exited without stats_reaped() */
+static void reclaim_slots(void)
+{
+    for (int i = 0; i < STATS_SLOTS; i++) {
+        pid_t o = slots[i].owner;
+        if (o != 0 && o != self_pid && kill(o, 0) < 0 && errno == ESRCH) {
+            __sync_bool_compare_and_swap(&slots[i].owner, o, 0);
+        }
+    }
+    reclaim_due = 0;
+}
+
+
+void stats_line_read(long long t)
+{
+    if (reclaim_due) reclaim_slots();
+    shell_stats.lines_read++;
+    line_read_ns = t;
+}
+
+
+/* === Reporting ============================================================= */
+
+/* Highest value that falls into bucket i */
+static unsigned long long bucket_high(int i)
+{
+    if (i < STATS_SUB) return (unsigned long long)i;
+    int e   = i / STATS_SUB + STATS_SUB_BITS - 1;
+    int sub = i % STATS_SUB;
+    return ((unsigned long long)(STATS_SUB + sub + 1) << (e - STATS_SUB_BITS)) - 1;
+}
+
+/* Value at quantile q (0..1): the upper edge of the bucket holding it, capped at max */
+static unsigned long long hist_quantile(const Histogram *h, double q)
+{
+    if (h->count == 0) return 0;
+
+    unsigned long long rank = (unsigned long long)(q * (double)h->count + 0.5);
+    unsigned long long seen = 0;
+    if (rank < 1) rank = 1;
+
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= rank) {
+            unsigned long long v = bucket_high(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+static const double quantiles[] = { 0.50, 0.90, 0.99, 0.999 };
+static const char  *q_names[]   = { "p50", "p90", "p99", "p99.9" };
+#define N_QUANTILES 4
+
+static void print_hist_human(const char *name, const Histogram *h)
+{
+    printf("  %-16s n=%-8llu", name, h->count);
+    if (h->count == 0) {
+        printf("\n");
+        return;
+    }
+    printf(" mean %8.1fus", (double)h->sum / (double)h->count / 1000.0);
+    for (int i = 0; i < N_QUANTILES; i++) {
+        printf("  %s %8.1fus", q_names[i], (double)hist_quantile(h, quantiles[i]) / 1000.0);
+    }
+    printf("  max %8.1fus\n", (double)h->max / 1000.0);
+}
+
+static void print_hist_json(const char *name, const Histogram *h, int last)
+{
+    printf("  \"%s\": {\"count\": %llu, \"min_ns\": %llu, \"mean_ns\": %llu",
+           name, h->count, h->min, h->count ? h->sum / h->count : 0);
+    for (int i = 0; i < N_QUANTILES; i++) {
+        printf(", \"%s_ns\": %llu", q_names[i], hist_quantile(h, quantiles[i]));
+    }
+    printf(", \"max_ns\": %llu}%s\n", h->max, last ? "" : ",");
+}
+
+
+int stats_builtin(char **argv)
+{
+    const ShellStats *s = &shell_stats;
+
+    if (argv[1] != NULL && strcmp(argv[1], "reset") == 0 && argv[2] == NULL) {
+        memset(&shell_stats, 0, sizeof(shell_stats));
+        return 0;
+    }
+
+    int json = argv[1] != NULL && strcmp(argv[1], "--json") == 0;
+    if (argv[1] != NULL && (!json || argv[2] != NULL)) {
+        fprintf(stderr, "usage: stats [--json | reset]\n");
+        return 2;
+    }
+
+    struct mallinfo2 mi = mallinfo2();
+
+    if (json) {
+        printf("{\n");
+        printf("  \"lines_read\": %llu,\n", s->lines_read);
+        printf("  \"parses\": %llu,\n", s->parses);
+        printf("  \"pipes_created\": %llu,\n", s->pipes_created);
+        printf("  \"spawns\": %llu,\n", s->spawns);
+        printf("  \"spawn_failures\": %llu,\n", s->spawn_failures);
+        printf("  \"slot_overflows\": %llu,\n", s->slot_overflows);
+        printf("  \"fds_opened\": %llu,\n", s->fds_opened);
+        printf("  \"heap_in_use_bytes\": %zu,\n", mi.uordblks + mi.hblkhd);
+        print_hist_json("parse", &s->parse_ns, 0);
+        print_hist_json("spawn", &s->spawn_ns, 0);
+        print_hist_json("prompt_to_exec", &s->prompt_exec_ns, 1);
+        printf("}\n");
+    } else {
+        printf("counters:\n");
+        printf("  %-16s %llu\n", "lines read", s->lines_read);
+        printf("  %-16s %llu\n", "parses", s->parses);
+        printf("  %-16s %llu\n", "pipes created", s->pipes_created);
+        printf("  %-16s %llu\n", "spawns", s->spawns);
+        printf("  %-16s %llu\n", "spawn failures", s->spawn_failures);
+        printf("  %-16s %llu\n", "slot overflows", s->slot_overflows);
+        printf("  %-16s %llu\n", "fds opened", s->fds_opened);
+        printf("  %-16s %zu bytes\n", "heap in use", mi.uordblks + mi.hblkhd);
+        printf("latency:\n");
+        print_hist_human("parse", &s->parse_ns);
+        print_hist_human("spawn", &s->spawn_ns);
+        print_hist_human("prompt to exec", &s->prompt_exec_ns);
+    }
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,408 @@
+/* =============================================================================
+ * src/trace.c  –  Execution trace (MYSHELL_TRACE=path)
+ *
+ * Writes a Chrome trace-event JSON array: one "X" (complete) event per span,
+ * "i" (instant) events for exec and first-byte, and "M" metadata naming each
+ * child's track.  The shell is pid <shell pid>, tid 0; every child gets its
+ * own track with tid = its pid.  Timestamps are CLOCK_MONOTONIC microseconds.
+ *
+ * Design notes:
+ *   - Events are appended to one heap buffer and written with a single
+ *     write() per command line (trace_flush() from the prompt loop).  With
+ *     tracing disabled nothing is allocated or written.
+ *   - Children cannot append to the parent's buffer; their start and exec
+ *     times come from the shared stats slot every child stamps (stats.c),
+ *     turned into events when the parent reaps the child.
+ *   - Exit times come from pidfds polled by trace_watch(), so they are the
+ *     real exit order rather than the order wait_job() reaps in.  Without
+ *     pidfd_open() the reap time is used instead.  Another wait loop (the
+ *     pipe monitor's) adds the same fds to its own poll() through
+ *     trace_poll_fds() / trace_poll_events(), so nothing is stamped late.
+ *   - The first byte through a pipe is observed by polling a CLOEXEC
+ *     duplicate of its read end.  The duplicate is a reader reference, so it
+ *     is closed as soon as the byte is seen, the writer hangs up, or the
+ *     reading command exits – a writer must still get SIGPIPE/EPIPE once the
+ *     real reader is gone (yes | head).
+ *   - The trace fd is O_CLOEXEC, and children never write the buffer (they
+ *     exec or leave through _exit()).
+ * ============================================================================= */
+
+#define _GNU_SOURCE     /* syscall(), F_DUPFD_CLOEXEC */
+
+#include <stdio.h>      /* snprintf(), perror() */
+#include <stdlib.h>     /* realloc(), free() */
+#include <string.h>     /* memcpy(), strlen() */
+#include <errno.h>      /* errno, EINTR */
+#include <fcntl.h>      /* open(), fcntl() */
+#include <poll.h>       /* poll() */
+#include <time.h>       /* clock_gettime() */
+#include <unistd.h>     /* write(), close(), getpid() */
+#include <sys/syscall.h> /* SYS_pidfd_open */
+#include <sys/wait.h>   /* WIFEXITED, WEXITSTATUS, WTERMSIG */
+#include "trace.h"
+#include "stats.h"      /* stats_slot_get(), STATS_MARK_* */
+
+#define TRACE_NAME_LEN  64      /* argv[0] shown on a child's track */
+
+int trace_on = 0;
+
+static int    trace_fd = -1;
+static pid_t  shell_pid;
+static char  *buf;              /* events not yet written */
+static size_t buf_len, buf_cap;
+static int    n_events;         /* events written so far (comma placement) */
+
+
+/* One registered child, from trace_child() until trace_reaped() */
+typedef struct {
+    pid_t     pid;
+    int       pidfd;            /* -1 once the exit was seen (or unavailable) */
+    int       slot;
+    long long exit_ns;          /* 0 until the exit is seen (trace_poll_events()) */
+    char      name[TRACE_NAME_LEN];
+} TraceChild;
+
+/* One watched pipe read end, from trace_pipe() until first byte / hang-up */
+typedef struct {
+    int   fd;
+    pid_t writer, reader;
+} TracePipe;
+
+static TraceChild *children;
+static int n_children, cap_children;
+static TracePipe  *pipes;
+static int n_pipes, cap_pipes;
+
+
+/* === Output buffer ======================================================== */
+
+static void buf_add(const char *s, size_t n)
+{
+    if (buf_len + n > buf_cap) {
+        size_t cap = buf_cap ? buf_cap : 4096;
+        while (cap < buf_len + n) cap *= 2;
+        char *tmp = realloc(buf, cap);
+        if (tmp == NULL) return;            /* drop the event, keep the shell going */
+        buf = tmp;
+        buf_cap = cap;
+    }
+    memcpy(buf + buf_len, s, n);
+    buf_len += n;
+}
+
+/* Appends s as the body of a JSON string (quotes not included) */
+static void buf_add_json(const char *s)
+{
+    for (; *s; s++) {
+        char esc[8];
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)c;
+            buf_add(esc, 2);
+        } else if (c < 0x20) {
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            buf_add(esc, 6);
+        } else {
+            buf_add(s, 1);
+        }
+    }
+}
+
+/*
+ * Appends one event.  ph is "X", "i" or "M"; dur_ns is used for "X" only;
+ * key/val (may be NULL) become the single entry of args.
+ */
+static void add_event(const char *ph, const char *name, long long ts_ns,
+                      long long dur_ns, pid_t tid, const char *key, const char *val)
+{
+    char head[160];
+    int n;
+
+    if (n_events++ > 0) buf_add(",\n", 2);
+
+    buf_add("{\"name\":\"", 9);
+    buf_add_json(name);
+    n = snprintf(head, sizeof(head),
+                 "\",\"cat\":\"myshell\",\"ph\":\"%s\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d",
+                 ph, ts_ns / 1000, ts_ns % 1000, (int)shell_pid, (int)tid);
+    buf_add(head, (size_t)n);
+    if (ph[0] == 'X') {
+        n = snprintf(head, sizeof(head), ",\"dur\":%lld.%03lld", dur_ns / 1000, dur_ns % 1000);
+        buf_add(head, (size_t)n);
+    } else if (ph[0] == 'i') {
+        buf_add(",\"s\":\"t\"", 8);
+    }
+    if (key != NULL && val != NULL) {
+        buf_add(",\"args\":{\"", 10);
+        buf_add(key, strlen(key));
+        buf_add("\":\"", 3);
+        buf_add_json(val);
+        buf_add("\"}", 2);
+    }
+    buf_add("}", 1);
+}
+
+
+/* === Public API ============================================================ */
+
+int trace_init(const char *path)
+{
+    trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (trace_fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    shell_pid = getpid();
+    trace_on = 1;
+
+    buf_add("[\n", 2);
+    add_event("M", "process_name", 0, 0, 0, "name", "myshell");
+    add_event("M", "thread_name", 0, 0, 0, "name", "shell");
+    trace_flush();
+    return 0;
+}
+
+
+void trace_close(void)
+{
+    if (!trace_on) return;
+
+    buf_add("\n]\n", 3);
+    trace_flush();
+    close(trace_fd);
+    trace_fd = -1;
+    trace_on = 0;
+    free(buf);
+    free(children);
+    free(pipes);
+    buf = NULL;
+    children = NULL;
+    pipes = NULL;
+}
+
+
+long long trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+
+void trace_span(const char *name, long long t0, long long t1, pid_t tid,
+                const char *detail)
+{
+    if (!trace_on) return;
+    add_event("X", name, t0, t1 - t0, tid, "detail", detail);
+}
+
+
+void trace_flush(void)
+{
+    size_t off = 0;
+
+    if (!trace_on || buf_len == 0) return;
+
+    while (off < buf_len) {
+        ssize_t w = write(trace_fd, buf + off, buf_len - off);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            break;                          /* lose this batch rather than the shell */
+        }
+        off += (size_t)w;
+    }
+    buf_len = 0;
+}
+
+
+void trace_child(pid_t pid, int slot, const char *argv0, long long t0, long long t1)
+{
+    if (!trace_on) return;
+
+    if (n_children == cap_children) {
+        int cap = cap_children ? cap_children * 2 : 16;
+        TraceChild *tmp = realloc(children, (size_t)cap * sizeof(TraceChild));
+        if (tmp == NULL) return;
+        children = tmp;
+        cap_children = cap;
+    }
+
+    TraceChild *c = &children[n_children++];
+    c->pid = pid;
+    c->slot = slot;
+    c->exit_ns = 0;
+#ifdef SYS_pidfd_open
+    c->pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    c->pidfd = -1;
+#endif
+    snprintf(c->name, sizeof(c->name), "%s", argv0);
+
+    add_event("M", "thread_name", 0, 0, pid, "name", c->name);
+    add_event("X", "fork", t0, t1 - t0, 0, "detail", c->name);
+}
+
+
+/* Returns the registered child with this pid, or NULL */
+static TraceChild *find_child(pid_t pid)
+{
+    for (int i = 0; i < n_children; i++) {
+        if (children[i].pid == pid) return &children[i];
+    }
+    return NULL;
+}
+
+
+void trace_pipe(int read_fd, pid_t writer, pid_t reader)
+{
+    if (!trace_on) return;
+
+    if (n_pipes == cap_pipes) {
+        int cap = cap_pipes ? cap_pipes * 2 : 16;
+        TracePipe *tmp = realloc(pipes, (size_t)cap * sizeof(TracePipe));
+        if (tmp == NULL) return;
+        pipes = tmp;
+        cap_pipes = cap;
+    }
+
+    int fd = fcntl(read_fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) return;
+
+    pipes[n_pipes].fd = fd;
+    pipes[n_pipes].writer = writer;
+    pipes[n_pipes].reader = reader;
+    n_pipes++;
+}
+
+
+/* Closes watched pipe i and drops it from the table */
+static void drop_pipe(int i)
+{
+    close(pipes[i].fd);
+    pipes[i] = pipes[--n_pipes];
+}
+
+
+int trace_nfds(void)
+{
+    return trace_on ? n_children + n_pipes : 0;
+}
+
+
+int trace_poll_fds(struct pollfd *pfd, int max)
+{
+    int n = 0, waiting = 0;
+
+    if (!trace_on) return 0;
+    for (int i = 0; i < n_children && n < max; i++) {
+        if (children[i].pidfd < 0) continue;
+        pfd[n].fd = children[i].pidfd;
+        pfd[n].events = POLLIN;
+        pfd[n++].revents = 0;
+        waiting++;
+    }
+    if (waiting == 0) return 0;
+    for (int i = 0; i < n_pipes && n < max; i++) {
+        pfd[n].fd = pipes[i].fd;
+        pfd[n].events = POLLIN;
+        pfd[n++].revents = 0;
+    }
+    return n;
+}
+
+
+void trace_poll_events(const struct pollfd *pfd, int n, long long now)
+{
+    /* Pipes first, so a first byte is recorded before its reader's exit
+     * drops the pipe.  Entries are matched by fd: the tables are compacted
+     * as pipes are dropped, and nothing is opened in between. */
+    for (int k = 0; k < n; k++) {
+        if (pfd[k].revents == 0) continue;
+        for (int i = 0; i < n_pipes; i++) {
+            TracePipe *tp = &pipes[i];
+            if (tp->fd != pfd[k].fd) continue;
+            if (pfd[k].revents & POLLIN) {
+                TraceChild *r = find_child(tp->reader);
+                add_event("i", "first byte", now, 0, tp->writer, "to",
+                          r != NULL ? r->name : "?");
+                drop_pipe(i);
+            } else if (pfd[k].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+                drop_pipe(i);
+            }
+            break;
+        }
+    }
+
+    for (int k = 0; k < n; k++) {
+        if (!(pfd[k].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL))) continue;
+        for (int j = 0; j < n_children; j++) {
+            TraceChild *c = &children[j];
+            if (c->pidfd != pfd[k].fd) continue;
+            c->exit_ns = now;
+            close(c->pidfd);
+            c->pidfd = -1;
+            for (int i = n_pipes - 1; i >= 0; i--) {
+                if (pipes[i].reader == c->pid) drop_pipe(i);
+            }
+            break;
+        }
+    }
+}
+
+
+void trace_watch(void)
+{
+    if (!trace_on) return;
+
+    int cap = trace_nfds();
+    struct pollfd *pfd = malloc((size_t)(cap > 0 ? cap : 1) * sizeof(struct pollfd));
+
+    while (pfd != NULL) {
+        int n = trace_poll_fds(pfd, cap);
+        if (n == 0) break;
+
+        if (poll(pfd, (nfds_t)n, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        trace_poll_events(pfd, n, trace_now());
+    }
+
+    /* Never keep a reader reference past the wait */
+    while (n_pipes > 0) drop_pipe(n_pipes - 1);
+    free(pfd);
+}
+
+
+void trace_reaped(pid_t pid, int status)
+{
+    if (!trace_on) return;
+
+    TraceChild *c = find_child(pid);
+    if (c == NULL) return;
+
+    long long now = trace_now();
+    long long end = c->exit_ns ? c->exit_ns : now;
+    long long start = stats_slot_get(c->slot, STATS_MARK_START);
+    long long exec  = stats_slot_get(c->slot, STATS_MARK_EXEC);
+    char st[32];
+
+    if (c->pidfd >= 0) close(c->pidfd);
+
+    if (WIFEXITED(status)) snprintf(st, sizeof(st), "exit %d", WEXITSTATUS(status));
+    else                   snprintf(st, sizeof(st), "signal %d", WTERMSIG(status));
+
+    if (start && exec) {
+        add_event("X", "setup", start, exec - start, pid, "detail", c->name);
+        add_event("i", "exec", exec, 0, pid, "detail", c->name);
+        add_event("X", "run", exec, end - exec, pid, "status", st);
+    } else if (start) {
+        add_event("X", "child", start, end - start, pid, "status", st);
+    } else {
+        add_event("i", "exit", end, 0, pid, "status", st);
+    }
+
+    *c = children[--n_children];
+}